@@ -0,0 +1,357 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_EXAMPLE_COMPRESSED_CACHE_H_INCLUDED
+#define BEAST_EXAMPLE_COMPRESSED_CACHE_H_INCLUDED
+
+#include "file_cache.hpp"
+
+#include <beast/http/rfc7230.hpp>
+#include <beast/core/detail/ci_char_traits.hpp>
+#include <beast/zlib/deflate_stream.hpp>
+#include <boost/crc.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <future>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace beast {
+namespace http {
+
+/// A content coding the server can apply to a response body
+enum class content_coding
+{
+    identity,
+    deflate,
+    gzip
+};
+
+/// Return the value of the Content-Encoding field for a coding
+inline
+char const*
+to_string(content_coding c)
+{
+    switch(c)
+    {
+    case content_coding::deflate:   return "deflate";
+    case content_coding::gzip:      return "gzip";
+    default:
+        break;
+    }
+    return "identity";
+}
+
+/** Return the entity tag for a compressed variant.
+
+    Each representation of a resource needs its own strong
+    entity tag, so the coding is appended to the tag of the file.
+*/
+inline
+std::string
+variant_etag(std::string const& etag, content_coding c)
+{
+    if(c == content_coding::identity || etag.empty())
+        return etag;
+    auto s = etag.substr(0, etag.size() - 1);
+    s.push_back('-');
+    s.append(to_string(c));
+    s.push_back('"');
+    return s;
+}
+
+/// Returns `true` if content of this type is worth compressing
+inline
+bool
+is_compressible(boost::string_ref const& content_type)
+{
+    using beast::detail::ci_equal;
+    return
+        content_type.starts_with("text/") ||
+        ci_equal(content_type, "application/javascript") ||
+        ci_equal(content_type, "application/json") ||
+        ci_equal(content_type, "application/xml") ||
+        ci_equal(content_type, "image/svg+xml");
+}
+
+/** Choose the preferred content coding from an Accept-Encoding value.
+
+    The coding with the highest quality value is chosen, with
+    gzip preferred over deflate when they are equal. Codings with
+    a quality of zero are never chosen.
+*/
+inline
+content_coding
+select_coding(boost::string_ref const& accept_encoding)
+{
+    using beast::detail::ci_equal;
+    auto const quality =
+        [](param_list const& params)
+        {
+            for(auto const& param : params)
+                if(ci_equal(param.first, "q"))
+                    return std::strtod(
+                        param.second.to_string().c_str(), nullptr);
+            return 1.0;
+        };
+    // A wildcard applies only to codings not listed
+    double qgzip = -1;
+    double qdeflate = -1;
+    double qany = 0;
+    for(auto const& ext : ext_list{accept_encoding})
+    {
+        auto const q = quality(ext.second);
+        if(ci_equal(ext.first, "gzip") ||
+                ci_equal(ext.first, "x-gzip"))
+            qgzip = q;
+        else if(ci_equal(ext.first, "deflate"))
+            qdeflate = q;
+        else if(ext.first == "*")
+            qany = q;
+    }
+    if(qgzip < 0)
+        qgzip = qany;
+    if(qdeflate < 0)
+        qdeflate = qany;
+    if(qgzip > 0 && qgzip >= qdeflate)
+        return content_coding::gzip;
+    if(qdeflate > 0)
+        return content_coding::deflate;
+    return content_coding::identity;
+}
+
+/** A size bounded cache of compressed variants of cached files.
+
+    Variants are produced lazily on first request by compressing the
+    whole file at the highest level, and are then shared by every
+    response which selects them. A variant is keyed by the entity tag
+    of the file it was made from, so a modified file gets new variants
+    while the old ones age out. Files which do not get smaller, or
+    whose variant would not fit in the cache, are remembered, and
+    served as identity. Concurrent requests for a variant which is
+    not cached yet wait for a single compression.
+
+    Objects of this type may be used concurrently from multiple threads.
+*/
+class compressed_cache
+{
+    using value_type = std::shared_ptr<std::string const>;
+
+    struct element
+    {
+        std::string key;
+        value_type value;
+    };
+
+    using list_type = std::list<element>;
+
+    std::mutex m_;
+    std::size_t max_bytes_;
+    std::size_t bytes_ = 0;
+    list_type list_; // front is most recently used
+    std::unordered_map<std::string,
+        list_type::iterator> map_;
+    std::unordered_map<std::string,
+        std::shared_future<value_type>> pending_;
+
+public:
+    compressed_cache(compressed_cache const&) = delete;
+    compressed_cache& operator=(compressed_cache const&) = delete;
+
+    /** Construct the cache.
+
+        @param max_bytes The limit on the total size of
+        compressed variants held by the cache.
+    */
+    explicit
+    compressed_cache(std::size_t max_bytes = 64 * 1024 * 1024)
+        : max_bytes_(max_bytes)
+    {
+    }
+
+    /** Return a compressed variant of a cached file.
+
+        @param path The path used to look up the file.
+
+        @param e The cache entry for the file.
+
+        @param c The content coding to apply.
+
+        @return The compressed body, or `nullptr` if the
+        identity coding should be used instead.
+    */
+    value_type
+    get(std::string const& path,
+        file_cache::entry const& e, content_coding c)
+    {
+        if(c == content_coding::identity)
+            return nullptr;
+        auto key = path;
+        key.push_back(' ');
+        key.append(e.etag);
+        key.push_back(' ');
+        key.append(to_string(c));
+        std::promise<value_type> p;
+        std::shared_future<value_type> f;
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            auto const it = map_.find(key);
+            if(it != map_.end())
+            {
+                list_.splice(list_.begin(), list_, it->second);
+                return it->second->value;
+            }
+            // Wait for a compression already in progress
+            auto const pit = pending_.find(key);
+            if(pit != pending_.end())
+                f = pit->second;
+            else
+                pending_.emplace(key, p.get_future().share());
+        }
+        if(f.valid())
+            return f.get();
+        // Compress without holding the lock
+        value_type value;
+        try
+        {
+            value = compress(*e.file, c);
+        }
+        catch(...)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_);
+                pending_.erase(key);
+            }
+            p.set_exception(std::current_exception());
+            throw;
+        }
+        // Too big to keep, so remember it as incompressible
+        if(value && value->size() > max_bytes_)
+            value = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            pending_.erase(key);
+            insert(std::move(key), value);
+        }
+        p.set_value(value);
+        return value;
+    }
+
+private:
+    static
+    value_type
+    compress(mapped_file const& file, content_coding c)
+    {
+        auto const in = static_cast<
+            std::uint8_t const*>(file.data());
+        auto const size = file.size();
+        if(size == 0)
+            return nullptr;
+        zlib::deflate_stream zo;
+        zo.reset(zlib::Z_BEST_COMPRESSION,
+            15, 9, zlib::Strategy::normal);
+        auto const header =
+            c == content_coding::gzip ? 10 : 2;
+        auto const trailer =
+            c == content_coding::gzip ? 8 : 4;
+        std::string s;
+        s.resize(header + zo.upper_bound(size) + trailer);
+        auto const out = reinterpret_cast<
+            std::uint8_t*>(&s[0]);
+        zlib::z_params zs;
+        zs.next_in = in;
+        zs.avail_in = size;
+        zs.next_out = out + header;
+        zs.avail_out = s.size() - header - trailer;
+        error_code ec;
+        zo.write(zs, zlib::Flush::finish, ec);
+        if(ec != zlib::error::end_of_stream)
+            return nullptr;
+        auto const n = header + zs.total_out;
+        if(n + trailer >= size)
+            return nullptr;
+        auto const put32 =
+            [](std::uint8_t* p, std::uint32_t v, bool big)
+            {
+                for(int i = 0; i < 4; ++i)
+                    p[big ? 3 - i : i] =
+                        static_cast<std::uint8_t>(v >> (8 * i));
+            };
+        if(c == content_coding::gzip)
+        {
+            // rfc1952
+            static std::uint8_t const h[10] = {
+                0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 2, 3 };
+            std::copy(std::begin(h), std::end(h), out);
+            boost::crc_32_type crc;
+            crc.process_bytes(in, size);
+            put32(out + n, crc.checksum(), false);
+            put32(out + n + 4,
+                static_cast<std::uint32_t>(size), false);
+        }
+        else
+        {
+            // rfc1950
+            out[0] = 0x78;
+            out[1] = 0xda;
+            std::uint32_t a = 1;
+            std::uint32_t b = 0;
+            for(std::size_t i = 0; i < size;)
+            {
+                // 5552 is the largest block that cannot overflow
+                auto const end = (std::min)(size, i + 5552);
+                for(; i < end; ++i)
+                {
+                    a += in[i];
+                    b += a;
+                }
+                a %= 65521;
+                b %= 65521;
+            }
+            put32(out + n, (b << 16) | a, true);
+        }
+        s.resize(n + trailer);
+        s.shrink_to_fit();
+        return std::make_shared<std::string const>(std::move(s));
+    }
+
+    void
+    insert(std::string key, value_type const& value)
+    {
+        auto const size = value ? value->size() : 0;
+        auto const it = map_.find(key);
+        if(it != map_.end())
+            return;
+        list_.push_front(element{key, value});
+        map_.emplace(std::move(key), list_.begin());
+        bytes_ += size;
+        // Incompressible files cost no bytes, so the entry
+        // count is bounded too, at one per compressed kilobyte.
+        while(bytes_ > max_bytes_ ||
+            list_.size() > max_bytes_ / 1024)
+        {
+            auto const& back = list_.back();
+            if(back.value)
+                bytes_ -= back.value->size();
+            map_.erase(back.key);
+            list_.pop_back();
+        }
+    }
+};
+
+} // http
+} // beast
+
+#endif
@@ -0,0 +1,234 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_EXAMPLE_FILE_CACHE_H_INCLUDED
+#define BEAST_EXAMPLE_FILE_CACHE_H_INCLUDED
+
+#include "mime_type.hpp"
+#include "mmap_body.hpp"
+
+#include <beast/core/error.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace beast {
+namespace http {
+
+/** A bounded LRU cache of mapped files and their response metadata.
+
+    Each entry holds the read-only mapping of a file along with the
+    header values a server sends with it, computed once when the file
+    is loaded. A lookup of a fresh entry is a hash table probe with no
+    file system calls. Entries older than the time to live are checked
+    against the file system on their next lookup, and reloaded only if
+    the file changed.
+
+    Objects of this type may be used concurrently from multiple threads.
+*/
+class file_cache
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    /// A cached file
+    struct entry
+    {
+        /// The mapped file contents and status
+        std::shared_ptr<mapped_file const> file;
+
+        /// Value of the Content-Type field
+        std::string content_type;
+
+        /// Value of the Content-Length field
+        std::string content_length;
+
+        /// Value of the ETag field
+        std::string etag;
+
+        /// Value of the Last-Modified field
+        std::string last_modified;
+    };
+
+private:
+    struct element
+    {
+        std::string path;
+        std::shared_ptr<entry const> value;
+        clock_type::time_point expires;
+    };
+
+    using list_type = std::list<element>;
+
+    std::mutex m_;
+    std::size_t max_size_;
+    clock_type::duration ttl_;
+    list_type list_; // front is most recently used
+    std::unordered_map<std::string,
+        list_type::iterator> map_;
+
+public:
+    file_cache(file_cache const&) = delete;
+    file_cache& operator=(file_cache const&) = delete;
+
+    /** Construct the cache.
+
+        @param max_size The maximum number of files to keep open.
+
+        @param ttl The time after which an entry is revalidated.
+    */
+    explicit
+    file_cache(std::size_t max_size = 1024,
+            clock_type::duration ttl = std::chrono::seconds(2))
+        : max_size_(max_size)
+        , ttl_(ttl)
+    {
+    }
+
+    /** Return the entry for a path, loading it if necessary.
+
+        @param path The path to the file.
+
+        @param ec Set to the error, if any occurred.
+
+        @return The entry, or `nullptr` on error.
+    */
+    std::shared_ptr<entry const>
+    get(std::string const& path, error_code& ec)
+    {
+        auto const now = clock_type::now();
+        std::shared_ptr<entry const> stale;
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            auto const it = map_.find(path);
+            if(it != map_.end())
+            {
+                list_.splice(list_.begin(), list_, it->second);
+                if(it->second->expires > now)
+                    return it->second->value;
+                stale = it->second->value;
+            }
+        }
+        // Revalidate or load without holding the lock
+        std::shared_ptr<entry const> value;
+        if(stale && unchanged(path, *stale))
+            value = std::move(stale);
+        else
+            value = load(path, ec);
+        std::lock_guard<std::mutex> lock(m_);
+        if(! value)
+        {
+            erase(path);
+            return nullptr;
+        }
+        insert(path, value, now + ttl_);
+        return value;
+    }
+
+    /// Remove all entries from the cache
+    void
+    clear()
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        map_.clear();
+        list_.clear();
+    }
+
+private:
+    static
+    bool
+    unchanged(std::string const& path, entry const& e)
+    {
+        struct stat st;
+        if(::stat(path.c_str(), &st) == -1)
+            return false;
+        auto const& old = e.file->status();
+        return
+            st.st_ino == old.st_ino &&
+            st.st_dev == old.st_dev &&
+            st.st_size == old.st_size &&
+            st.st_mtime == old.st_mtime;
+    }
+
+    static
+    std::string
+    http_date(std::time_t t)
+    {
+        std::tm tm;
+        ::gmtime_r(&t, &tm);
+        char buf[64];
+        auto const n = std::strftime(buf, sizeof(buf),
+            "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        return std::string(buf, n);
+    }
+
+    static
+    std::shared_ptr<entry const>
+    load(std::string const& path, error_code& ec)
+    {
+        auto file = mapped_file::open(path, ec);
+        if(ec)
+            return nullptr;
+        auto const& st = file->status();
+        auto e = std::make_shared<entry>();
+        e->content_type = mime_type(path);
+        e->content_length = std::to_string(file->size());
+        {
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "\"%llx-%llx\"",
+                static_cast<unsigned long long>(st.st_mtime),
+                static_cast<unsigned long long>(st.st_size));
+            e->etag = buf;
+        }
+        e->last_modified = http_date(st.st_mtime);
+        e->file = std::move(file);
+        return e;
+    }
+
+    void
+    insert(std::string const& path,
+        std::shared_ptr<entry const> const& value,
+            clock_type::time_point expires)
+    {
+        auto const it = map_.find(path);
+        if(it != map_.end())
+        {
+            it->second->value = value;
+            it->second->expires = expires;
+            return;
+        }
+        list_.push_front(element{path, value, expires});
+        map_.emplace(path, list_.begin());
+        while(list_.size() > max_size_)
+        {
+            map_.erase(list_.back().path);
+            list_.pop_back();
+        }
+    }
+
+    void
+    erase(std::string const& path)
+    {
+        auto const it = map_.find(path);
+        if(it == map_.end())
+            return;
+        list_.erase(it->second);
+        map_.erase(it);
+    }
+};
+
+} // http
+} // beast
+
+#endif
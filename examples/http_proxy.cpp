@@ -0,0 +1,50 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "http_proxy.hpp"
+
+#include <beast/test/sig_wait.hpp>
+#include <boost/program_options.hpp>
+
+#include <iostream>
+
+int main(int ac, char const* av[])
+{
+    using namespace beast::http;
+    namespace po = boost::program_options;
+    po::options_description desc("Options");
+
+    desc.add_options()
+        ("port,p",      po::value<std::uint16_t>()->default_value(8081),
+                        "Set the port number for the proxy")
+        ("ip",          po::value<std::string>()->default_value("0.0.0.0"),
+                        "Set the IP address to bind to, \"0.0.0.0\" for all")
+        ("upstream,u",  po::value<std::string>()->default_value("127.0.0.1"),
+                        "Set the IP address of the upstream server")
+        ("upstream-port", po::value<std::uint16_t>()->default_value(8080),
+                        "Set the port number of the upstream server")
+        ;
+    po::variables_map vm;
+    po::store(po::parse_command_line(ac, av, desc), vm);
+
+    std::uint16_t port = vm["port"].as<std::uint16_t>();
+
+    std::string ip = vm["ip"].as<std::string>();
+
+    std::string upstream = vm["upstream"].as<std::string>();
+
+    std::uint16_t upstream_port = vm["upstream-port"].as<std::uint16_t>();
+
+    using endpoint_type = boost::asio::ip::tcp::endpoint;
+    using address_type = boost::asio::ip::address;
+
+    endpoint_type ep{address_type::from_string(ip), port};
+    endpoint_type up{address_type::from_string(upstream), upstream_port};
+
+    http_proxy proxy(ep, up);
+    beast::test::sig_wait();
+}
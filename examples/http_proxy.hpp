@@ -0,0 +1,295 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_EXAMPLE_HTTP_PROXY_H_INCLUDED
+#define BEAST_EXAMPLE_HTTP_PROXY_H_INCLUDED
+
+#include "splice_relay.hpp"
+
+#include <beast/http.hpp>
+#include <beast/http/header_parser_v1.hpp>
+#include <beast/core/placeholders.hpp>
+#include <beast/core/streambuf.hpp>
+#include <beast/core/detail/ci_char_traits.hpp>
+#include <boost/asio.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace beast {
+namespace http {
+
+/** A synchronous reverse proxy which forwards to a single upstream.
+
+    Only the header of each message is parsed, using a header parser
+    which pauses at the body. After the hop-by-hop fields are rewritten
+    the header is forwarded, and on Linux a body of known length is
+    spliced from one socket to the other without being copied into
+    user space. Other bodies, and every body on other platforms, are
+    relayed through a bounded buffer.
+*/
+class http_proxy
+{
+    using endpoint_type = boost::asio::ip::tcp::endpoint;
+    using socket_type = boost::asio::ip::tcp::socket;
+
+    bool log_ = true;
+    std::mutex m_;
+    boost::asio::io_service ios_;
+    socket_type sock_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    endpoint_type upstream_;
+    std::thread thread_;
+
+public:
+    http_proxy(endpoint_type const& ep,
+            endpoint_type const& upstream)
+        : sock_(ios_)
+        , acceptor_(ios_)
+        , upstream_(upstream)
+    {
+        acceptor_.open(ep.protocol());
+        acceptor_.bind(ep);
+        acceptor_.listen(
+            boost::asio::socket_base::max_connections);
+        acceptor_.async_accept(sock_,
+            std::bind(&http_proxy::on_accept, this,
+                beast::asio::placeholders::error));
+        thread_ = std::thread{[&]{ ios_.run(); }};
+    }
+
+    ~http_proxy()
+    {
+        error_code ec;
+        ios_.dispatch(
+            [&]{ acceptor_.close(ec); });
+        thread_.join();
+    }
+
+    template<class... Args>
+    void
+    log(Args const&... args)
+    {
+        if(log_)
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            log_args(args...);
+        }
+    }
+
+private:
+    void
+    log_args()
+    {
+    }
+
+    template<class Arg, class... Args>
+    void
+    log_args(Arg const& arg, Args const&... args)
+    {
+        std::cerr << arg;
+        log_args(args...);
+    }
+
+    void
+    fail(error_code ec, std::string what)
+    {
+        log(what, ": ", ec.message(), "\n");
+    }
+
+    void
+    fail(int id, error_code const& ec)
+    {
+        if(ec != boost::asio::error::operation_aborted &&
+                ec != boost::asio::error::eof)
+            log("#", id, " ", ec.message(), "\n");
+    }
+
+    struct lambda
+    {
+        int id;
+        http_proxy& self;
+        socket_type sock;
+        boost::asio::io_service::work work;
+
+        lambda(int id_, http_proxy& self_,
+                socket_type&& sock_)
+            : id(id_)
+            , self(self_)
+            , sock(std::move(sock_))
+            , work(sock.get_io_service())
+        {
+        }
+
+        void operator()()
+        {
+            self.do_peer(id, std::move(sock));
+        }
+    };
+
+    void
+    on_accept(error_code ec)
+    {
+        if(! acceptor_.is_open())
+            return;
+        if(ec)
+            return fail(ec, "accept");
+        static int id_ = 0;
+        std::thread{lambda{++id_, *this, std::move(sock_)}}.detach();
+        acceptor_.async_accept(sock_,
+            std::bind(&http_proxy::on_accept, this,
+                asio::placeholders::error));
+    }
+
+    // Remove the fields which apply only to a single connection
+    template<bool isRequest, class Fields>
+    static
+    void
+    strip_hop_by_hop(header<isRequest, Fields>& h)
+    {
+        std::vector<std::string> names;
+        for(auto const& name : token_list{h.fields["Connection"]})
+            names.emplace_back(name.data(), name.size());
+        for(auto const& name : names)
+            h.fields.erase(name);
+        for(auto const name : {"Connection", "Keep-Alive",
+                "Proxy-Connection", "Proxy-Authenticate",
+                    "Proxy-Authorization", "TE", "Upgrade"})
+            h.fields.erase(name);
+    }
+
+    // Forward the body which follows a parsed header
+    template<bool isRequest>
+    static
+    void
+    relay(socket_type& from, socket_type& to, streambuf& sb,
+        header_parser_v1<isRequest, fields> const& p,
+            bool has_body, splice_pipe& pipe, error_code& ec)
+    {
+        if(! has_body)
+            return;
+        if(p.flags() & parse_flag::chunked)
+            return relay_chunked(from, to, sb, ec);
+        if(p.flags() & parse_flag::contentlength)
+            return relay_body(from, to, sb, std::stoull(
+                p.get().fields["Content-Length"].to_string()),
+                    pipe, ec);
+        if(! isRequest)
+            return relay_until_eof(from, to, sb, ec);
+    }
+
+    void
+    do_peer(int id, socket_type&& sock0)
+    {
+        socket_type sock(std::move(sock0));
+        socket_type up(sock.get_io_service());
+        streambuf sb;
+        streambuf usb;
+        splice_pipe pipe;
+        error_code ec;
+        for(;;)
+        {
+            header_parser_v1<true, fields> req;
+            parse(sock, sb, req, ec);
+            if(ec)
+                break;
+            bool const keep_alive = req.keep_alive();
+            auto& hreq = req.get();
+            strip_hop_by_hop(hreq);
+            hreq.fields.insert("Via", "1.1 http_proxy");
+            if(! up.is_open())
+            {
+                usb.consume(usb.size());
+                up.connect(upstream_, ec);
+                if(ec)
+                    break;
+            }
+            // A client expecting 100-continue holds back the body
+            // until told to go ahead, but the upstream is only read
+            // after the body. Answer the expectation here instead.
+            bool const expect_continue = hreq.version >= 11 &&
+                (req.flags() & (parse_flag::chunked |
+                    parse_flag::contentlength)) &&
+                beast::detail::ci_equal(
+                    hreq.fields["Expect"], "100-continue");
+            if(expect_continue)
+                hreq.fields.erase("Expect");
+            write(up, hreq, ec);
+            if(ec)
+                break;
+            if(expect_continue)
+            {
+                header<false, fields> cont;
+                cont.version = 11;
+                cont.status = 100;
+                cont.reason = reason_string(cont.status);
+                write(sock, cont, ec);
+                if(ec)
+                    break;
+            }
+            relay(sock, up, sb, req, true, pipe, ec);
+            if(ec)
+                break;
+            // Interim responses precede the final one
+            boost::optional<header_parser_v1<false, fields>> opt;
+            for(;;)
+            {
+                opt.emplace();
+                parse(up, usb, *opt, ec);
+                if(ec)
+                    break;
+                auto const status = opt->get().status;
+                if(status < 100 || status > 199 || status == 101)
+                    break;
+                write(sock, opt->get(), ec);
+                if(ec)
+                    break;
+            }
+            if(ec)
+                break;
+            auto& res = *opt;
+            auto& hres = res.get();
+            bool const until_eof = res.needs_eof();
+            bool const upstream_alive =
+                res.keep_alive() && ! until_eof;
+            auto const status = hres.status;
+            bool const has_body = hreq.method != "HEAD" &&
+                status != 204 && status != 304 && status != 101;
+            strip_hop_by_hop(hres);
+            hres.fields.insert("Via", "1.1 http_proxy");
+            if(! keep_alive || (has_body && until_eof))
+                hres.fields.insert("Connection", "close");
+            else if(hres.version < 11)
+                hres.fields.insert("Connection", "keep-alive");
+            write(sock, hres, ec);
+            if(ec)
+                break;
+            relay(up, sock, usb, res, has_body, pipe, ec);
+            if(ec)
+                break;
+            if(! upstream_alive)
+                up.close(ec);
+            if(! keep_alive || (has_body && until_eof))
+            {
+                sock.shutdown(socket_type::shutdown_send, ec);
+                break;
+            }
+        }
+        fail(id, ec);
+    }
+};
+
+} // http
+} // beast
+
+#endif
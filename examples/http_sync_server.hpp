@@ -8,8 +8,11 @@
 #ifndef BEAST_EXAMPLE_HTTP_SYNC_SERVER_H_INCLUDED
 #define BEAST_EXAMPLE_HTTP_SYNC_SERVER_H_INCLUDED
 
-#include "file_body.hpp"
-#include "mime_type.hpp"
+#include "compressed_cache.hpp"
+#include "file_cache.hpp"
+#include "mmap_body.hpp"
+#include "range_body.hpp"
+#include "shared_body.hpp"
 
 #include <beast/http.hpp>
 #include <beast/core/placeholders.hpp>
@@ -36,7 +39,7 @@ class http_sync_server
     using socket_type = boost::asio::ip::tcp::socket;
 
     using req_type = request<string_body>;
-    using resp_type = response<file_body>;
+    using resp_type = response<mmap_body>;
 
     bool log_ = true;
     std::mutex m_;
@@ -44,6 +47,8 @@ class http_sync_server
     socket_type sock_;
     boost::asio::ip::tcp::acceptor acceptor_;
     std::string root_;
+    file_cache cache_;
+    compressed_cache zcache_;
     std::thread thread_;
 
 public:
@@ -162,7 +167,9 @@ private:
             if(path == "/")
                 path = "/index.html";
             path = root_ + path;
-            if(! boost::filesystem::exists(path))
+            error_code ev;
+            auto const e = cache_.get(path, ev);
+            if(ev == boost::system::errc::no_such_file_or_directory)
             {
                 response<string_body> res;
                 res.status = 404;
@@ -177,21 +184,7 @@ private:
                     break;
                 return;
             }
-            try
-            {
-                resp_type res;
-                res.status = 200;
-                res.reason = "OK";
-                res.version = req.version;
-                res.fields.insert("Server", "http_sync_server");
-                res.fields.insert("Content-Type", mime_type(path));
-                res.body = path;
-                prepare(res);
-                write(sock, res, ec);
-                if(ec)
-                    break;
-            }
-            catch(std::exception const& e)
+            if(ev)
             {
                 response<string_body> res;
                 res.status = 500;
@@ -200,12 +193,111 @@ private:
                 res.fields.insert("Server", "http_sync_server");
                 res.fields.insert("Content-Type", "text/html");
                 res.body =
-                    std::string{"An internal error occurred: "} + e.what();
+                    std::string{"An internal error occurred: "} + ev.message();
                 prepare(res);
                 write(sock, res, ec);
                 if(ec)
                     break;
+                continue;
+            }
+            if(req.method == "GET" &&
+                req.fields.exists("Range") &&
+                if_range_matches(req.fields["If-Range"],
+                    e->etag, e->last_modified))
+            {
+                std::vector<byte_range> ranges;
+                auto const size = e->file->size();
+                auto const result = parse_range(
+                    req.fields["Range"], size, ranges);
+                if(result == range_result::unsatisfiable)
+                {
+                    response<empty_body> res;
+                    res.status = 416;
+                    res.reason = "Range Not Satisfiable";
+                    res.version = req.version;
+                    res.fields.insert("Server", "http_sync_server");
+                    res.fields.insert("Content-Range",
+                        "bytes */" + e->content_length);
+                    res.fields.insert("Content-Length", "0");
+                    write(sock, res, ec);
+                    if(ec)
+                        break;
+                    continue;
+                }
+                if(result == range_result::partial)
+                {
+                    response<range_body> res;
+                    res.status = 206;
+                    res.reason = "Partial Content";
+                    res.version = req.version;
+                    res.fields.insert("Server", "http_sync_server");
+                    res.fields.insert("Accept-Ranges", "bytes");
+                    res.fields.insert("ETag", e->etag);
+                    res.fields.insert("Last-Modified", e->last_modified);
+                    if(ranges.size() == 1)
+                    {
+                        res.fields.insert("Content-Type", e->content_type);
+                        res.fields.insert("Content-Range",
+                            content_range(ranges.front(), size));
+                    }
+                    std::string boundary;
+                    res.body = make_range_body(e->file,
+                        std::move(ranges), e->content_type, boundary);
+                    if(! boundary.empty())
+                        res.fields.insert("Content-Type",
+                            "multipart/byteranges; boundary=" + boundary);
+                    prepare(res);
+                    write(sock, res, ec);
+                    if(ec)
+                        break;
+                    continue;
+                }
             }
+            auto const compressible =
+                is_compressible(e->content_type);
+            if(compressible)
+            {
+                auto const coding = select_coding(
+                    req.fields["Accept-Encoding"]);
+                auto const z = zcache_.get(path, *e, coding);
+                if(z)
+                {
+                    response<shared_body> res;
+                    res.status = 200;
+                    res.reason = "OK";
+                    res.version = req.version;
+                    res.fields.insert("Server", "http_sync_server");
+                    res.fields.insert("Content-Type", e->content_type);
+                    res.fields.insert("Content-Encoding", to_string(coding));
+                    res.fields.insert("Vary", "Accept-Encoding");
+                    res.fields.insert("ETag",
+                        variant_etag(e->etag, coding));
+                    res.fields.insert("Last-Modified", e->last_modified);
+                    res.body = z;
+                    prepare(res);
+                    write(sock, res, ec);
+                    if(ec)
+                        break;
+                    continue;
+                }
+            }
+            // The cached fields replace prepare()
+            resp_type res;
+            res.status = 200;
+            res.reason = "OK";
+            res.version = req.version;
+            res.fields.insert("Server", "http_sync_server");
+            res.fields.insert("Content-Type", e->content_type);
+            res.fields.insert("Content-Length", e->content_length);
+            res.fields.insert("ETag", e->etag);
+            res.fields.insert("Last-Modified", e->last_modified);
+            res.fields.insert("Accept-Ranges", "bytes");
+            if(compressible)
+                res.fields.insert("Vary", "Accept-Encoding");
+            res.body = e->file;
+            write(sock, res, ec);
+            if(ec)
+                break;
         }
         fail(id, ec);
     }
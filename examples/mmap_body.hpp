@@ -0,0 +1,196 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_EXAMPLE_MMAP_BODY_H_INCLUDED
+#define BEAST_EXAMPLE_MMAP_BODY_H_INCLUDED
+
+#include <beast/core/error.hpp>
+#include <beast/http/message.hpp>
+#include <beast/http/resume_context.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/logic/tribool.hpp>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace beast {
+namespace http {
+
+/** A read-only memory mapping of an entire file.
+
+    The pages are shared with the operating system's page cache,
+    so any number of responses referring to the same mapping cost
+    no additional memory and require no copies in user space.
+*/
+class mapped_file
+{
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+    struct stat st_;
+
+public:
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    mapped_file() = default;
+
+    ~mapped_file()
+    {
+        if(data_)
+            ::munmap(data_, size_);
+    }
+
+    /// Returns a pointer to the first byte of the mapping
+    void const*
+    data() const
+    {
+        return data_;
+    }
+
+    /// Returns the size of the mapping in bytes
+    std::size_t
+    size() const
+    {
+        return size_;
+    }
+
+    /// Returns the file status captured when the file was mapped
+    struct stat const&
+    status() const
+    {
+        return st_;
+    }
+
+    /** Map a file into memory.
+
+        @param path The path to the file.
+
+        @param ec Set to the error, if any occurred.
+
+        @return The mapping, or `nullptr` on error.
+    */
+    static
+    std::shared_ptr<mapped_file const>
+    open(std::string const& path, error_code& ec)
+    {
+        auto const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd == -1)
+        {
+            ec = boost::system::errc::make_error_code(
+                static_cast<boost::system::errc::errc_t>(errno));
+            return nullptr;
+        }
+        auto p = open(fd, ec);
+        ::close(fd);
+        return p;
+    }
+
+    /** Map an open file descriptor into memory.
+
+        The descriptor is not closed, and may be closed
+        by the caller as soon as this function returns.
+
+        @param fd The file descriptor, open for reading.
+
+        @param ec Set to the error, if any occurred.
+
+        @return The mapping, or `nullptr` on error.
+    */
+    static
+    std::shared_ptr<mapped_file const>
+    open(int fd, error_code& ec)
+    {
+        std::shared_ptr<mapped_file> p{new mapped_file};
+        if(::fstat(fd, &p->st_) == -1)
+        {
+            ec = boost::system::errc::make_error_code(
+                static_cast<boost::system::errc::errc_t>(errno));
+            return nullptr;
+        }
+        if(! S_ISREG(p->st_.st_mode))
+        {
+            ec = boost::system::errc::make_error_code(
+                boost::system::errc::not_supported);
+            return nullptr;
+        }
+        p->size_ = static_cast<std::size_t>(p->st_.st_size);
+        // mmap refuses zero length mappings
+        if(p->size_ == 0)
+            return p;
+        auto const data = ::mmap(nullptr, p->size_,
+            PROT_READ, MAP_SHARED, fd, 0);
+        if(data == MAP_FAILED)
+        {
+            ec = boost::system::errc::make_error_code(
+                static_cast<boost::system::errc::errc_t>(errno));
+            return nullptr;
+        }
+        p->data_ = data;
+        // The hint is advisory, failure is harmless
+        ::madvise(p->data_, p->size_, MADV_SEQUENTIAL);
+        return p;
+    }
+};
+
+/** A Body backed by a shared read-only memory mapped file.
+
+    The writer hands the mapped pages to the stream as a
+    single buffer, so there is no intermediate copy.
+*/
+struct mmap_body
+{
+    using value_type = std::shared_ptr<mapped_file const>;
+
+    class writer
+    {
+        value_type body_;
+
+    public:
+        writer(writer const&) = delete;
+        writer& operator=(writer const&) = delete;
+
+        template<bool isRequest, class Fields>
+        writer(message<isRequest, mmap_body, Fields> const& m) noexcept
+            : body_(m.body)
+        {
+        }
+
+        void
+        init(error_code& ec) noexcept
+        {
+            if(! body_)
+                ec = boost::system::errc::make_error_code(
+                    boost::system::errc::bad_file_descriptor);
+        }
+
+        std::uint64_t
+        content_length() const noexcept
+        {
+            return body_->size();
+        }
+
+        template<class WriteFunction>
+        boost::tribool
+        write(resume_context&&, error_code&,
+            WriteFunction&& wf) noexcept
+        {
+            wf(boost::asio::const_buffers_1{
+                body_->data(), body_->size()});
+            return true;
+        }
+    };
+};
+
+} // http
+} // beast
+
+#endif
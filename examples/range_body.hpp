@@ -0,0 +1,368 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_EXAMPLE_RANGE_BODY_H_INCLUDED
+#define BEAST_EXAMPLE_RANGE_BODY_H_INCLUDED
+
+#include "mmap_body.hpp"
+
+#include <beast/core/error.hpp>
+#include <beast/http/message.hpp>
+#include <beast/http/resume_context.hpp>
+#include <beast/core/detail/ci_char_traits.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/logic/tribool.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace beast {
+namespace http {
+
+/// An inclusive range of byte positions in a representation
+struct byte_range
+{
+    std::uint64_t first;
+    std::uint64_t last;
+};
+
+/// The result of evaluating a Range field against a representation
+enum class range_result
+{
+    /// The field is absent, malformed, or should be ignored
+    ignore,
+
+    /// At least one range is satisfiable, send 206
+    partial,
+
+    /// No range is satisfiable, send 416
+    unsatisfiable
+};
+
+/** Parse a Range field value as per rfc7233.
+
+    @param value The value of the Range field.
+
+    @param size The size of the selected representation.
+
+    @param ranges Receives the satisfiable ranges in ascending order.
+    Overlapping and adjacent ranges are merged, as permitted by rfc7233
+    section 4.1, so that no byte is sent twice and a response is never
+    larger than the representation plus the multipart framing.
+
+    @param max_ranges The largest number of ranges accepted. Requests
+    with more ranges are ignored, to limit the cost of pathological
+    requests.
+*/
+inline
+range_result
+parse_range(boost::string_ref value, std::uint64_t size,
+    std::vector<byte_range>& ranges, std::size_t max_ranges = 16)
+{
+    ranges.clear();
+    auto const is_ws =
+        [](char c)
+        {
+            return c == ' ' || c == '\t';
+        };
+    auto const skip_ws =
+        [&]
+        {
+            while(! value.empty() && is_ws(value.front()))
+                value.remove_prefix(1);
+        };
+    // Returns false if no digits or on overflow
+    auto const number =
+        [&](std::uint64_t& n)
+        {
+            if(value.empty() || value.front() < '0' || value.front() > '9')
+                return false;
+            n = 0;
+            while(! value.empty() &&
+                value.front() >= '0' && value.front() <= '9')
+            {
+                auto const d = static_cast<unsigned>(value.front() - '0');
+                if(n > ((std::numeric_limits<std::uint64_t>::max)() - d) / 10)
+                    return false;
+                n = 10 * n + d;
+                value.remove_prefix(1);
+            }
+            return true;
+        };
+    skip_ws();
+    if(! beast::detail::ci_equal(value.substr(0, 6), "bytes="))
+        return range_result::ignore;
+    value.remove_prefix(6);
+    std::size_t count = 0;
+    for(;;)
+    {
+        skip_ws();
+        if(value.empty())
+            break;
+        if(value.front() == ',')
+        {
+            value.remove_prefix(1);
+            continue;
+        }
+        if(++count > max_ranges)
+            return range_result::ignore;
+        byte_range r;
+        if(value.front() == '-')
+        {
+            // suffix-byte-range-spec
+            value.remove_prefix(1);
+            std::uint64_t n;
+            if(! number(n))
+                return range_result::ignore;
+            if(n > 0 && size > 0)
+            {
+                r.first = n < size ? size - n : 0;
+                r.last = size - 1;
+                ranges.push_back(r);
+            }
+        }
+        else
+        {
+            // byte-range-spec
+            if(! number(r.first))
+                return range_result::ignore;
+            if(value.empty() || value.front() != '-')
+                return range_result::ignore;
+            value.remove_prefix(1);
+            if(value.empty() || value.front() < '0' || value.front() > '9')
+            {
+                r.last = (std::numeric_limits<std::uint64_t>::max)();
+            }
+            else
+            {
+                if(! number(r.last))
+                    return range_result::ignore;
+                if(r.last < r.first)
+                    return range_result::ignore;
+            }
+            if(r.first < size)
+            {
+                if(r.last >= size)
+                    r.last = size - 1;
+                ranges.push_back(r);
+            }
+        }
+        skip_ws();
+        if(! value.empty() && value.front() != ',')
+            return range_result::ignore;
+    }
+    if(count == 0)
+        return range_result::ignore;
+    if(ranges.empty())
+        return range_result::unsatisfiable;
+    std::sort(ranges.begin(), ranges.end(),
+        [](byte_range const& lhs, byte_range const& rhs)
+        {
+            return lhs.first < rhs.first;
+        });
+    auto out = ranges.begin();
+    for(auto it = ranges.begin() + 1; it != ranges.end(); ++it)
+    {
+        // Positions are below size, so last + 1 can't overflow
+        if(it->first <= out->last + 1)
+        {
+            if(it->last > out->last)
+                out->last = it->last;
+        }
+        else
+        {
+            *++out = *it;
+        }
+    }
+    ranges.erase(out + 1, ranges.end());
+    return range_result::partial;
+}
+
+/** Return `true` if a Range field should be honored.
+
+    @param if_range The value of the If-Range field, which may be empty.
+
+    @param etag The strong entity tag of the representation.
+
+    @param last_modified The Last-Modified date of the representation.
+*/
+inline
+bool
+if_range_matches(boost::string_ref const& if_range,
+    boost::string_ref const& etag,
+        boost::string_ref const& last_modified)
+{
+    if(if_range.empty())
+        return true;
+    // Weak tags never match
+    if(if_range.starts_with("W/"))
+        return false;
+    return if_range == etag || if_range == last_modified;
+}
+
+/** A Body holding one or more byte ranges of a mapped file.
+
+    For a single range the writer sends the slice of the mapping
+    directly. For multiple ranges the delimiters and part headers
+    are formatted up front, and the writer sends them gathered with
+    the slices of the mapping in a single buffer sequence. The file
+    contents are never copied.
+*/
+struct range_body
+{
+    struct value_type
+    {
+        /// The mapped file
+        std::shared_ptr<mapped_file const> file;
+
+        /// The ranges to send
+        std::vector<byte_range> ranges;
+
+        /// The delimiter and header preceding each part, if multipart
+        std::vector<std::string> heads;
+
+        /// The closing delimiter, if multipart
+        std::string tail;
+    };
+
+    class writer
+    {
+        value_type const& body_;
+        std::vector<boost::asio::const_buffer> v_;
+        std::uint64_t size_ = 0;
+
+    public:
+        writer(writer const&) = delete;
+        writer& operator=(writer const&) = delete;
+
+        template<bool isRequest, class Fields>
+        writer(message<isRequest, range_body, Fields> const& m) noexcept
+            : body_(m.body)
+        {
+        }
+
+        void
+        init(error_code& ec) noexcept
+        {
+            if(! body_.file || body_.ranges.empty() || (
+                body_.ranges.size() > 1 &&
+                    body_.heads.size() != body_.ranges.size()))
+            {
+                ec = boost::system::errc::make_error_code(
+                    boost::system::errc::invalid_argument);
+                return;
+            }
+            auto const p = static_cast<
+                char const*>(body_.file->data());
+            try
+            {
+                v_.reserve(2 * body_.ranges.size() + 1);
+            }
+            catch(std::exception const&)
+            {
+                ec = boost::system::errc::make_error_code(
+                    boost::system::errc::not_enough_memory);
+                return;
+            }
+            for(std::size_t i = 0; i < body_.ranges.size(); ++i)
+            {
+                auto const& r = body_.ranges[i];
+                if(! body_.heads.empty())
+                    v_.emplace_back(boost::asio::buffer(body_.heads[i]));
+                auto const n = static_cast<
+                    std::size_t>(r.last - r.first + 1);
+                v_.emplace_back(p + r.first, n);
+            }
+            if(! body_.heads.empty())
+                v_.emplace_back(boost::asio::buffer(body_.tail));
+            size_ = boost::asio::buffer_size(v_);
+        }
+
+        std::uint64_t
+        content_length() const noexcept
+        {
+            return size_;
+        }
+
+        template<class WriteFunction>
+        boost::tribool
+        write(resume_context&&, error_code&,
+            WriteFunction&& wf) noexcept
+        {
+            wf(v_);
+            return true;
+        }
+    };
+};
+
+/// Return the value of the Content-Range field for a range
+inline
+std::string
+content_range(byte_range const& r, std::uint64_t size)
+{
+    return "bytes " +
+        std::to_string(r.first) + "-" +
+        std::to_string(r.last) + "/" +
+        std::to_string(size);
+}
+
+/** Build the body for a range response.
+
+    @param file The mapped file.
+
+    @param ranges The satisfiable ranges, from @ref parse_range.
+
+    @param content_type The type of the file.
+
+    @param boundary Receives the multipart boundary, which will be
+    empty if a single range is sent.
+*/
+inline
+range_body::value_type
+make_range_body(std::shared_ptr<mapped_file const> file,
+    std::vector<byte_range> ranges,
+        std::string const& content_type, std::string& boundary)
+{
+    range_body::value_type v;
+    boundary.clear();
+    if(ranges.size() > 1)
+    {
+        static std::string const b =
+            []
+            {
+                static char const digits[] = "0123456789abcdef";
+                std::random_device rng;
+                std::string s = "BEAST_";
+                for(int i = 0; i < 16; ++i)
+                    s.push_back(digits[rng() % 16]);
+                return s;
+            }();
+        boundary = b;
+        v.heads.reserve(ranges.size());
+        for(auto const& r : ranges)
+            v.heads.emplace_back(
+                "\r\n--" + boundary + "\r\n"
+                "Content-Type: " + content_type + "\r\n"
+                "Content-Range: " + content_range(r, file->size()) +
+                "\r\n\r\n");
+        v.tail = "\r\n--" + boundary + "--\r\n";
+    }
+    v.file = std::move(file);
+    v.ranges = std::move(ranges);
+    return v;
+}
+
+} // http
+} // beast
+
+#endif
@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_EXAMPLE_SHARED_BODY_H_INCLUDED
+#define BEAST_EXAMPLE_SHARED_BODY_H_INCLUDED
+
+#include <beast/core/error.hpp>
+#include <beast/http/message.hpp>
+#include <beast/http/resume_context.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/logic/tribool.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace beast {
+namespace http {
+
+/** A Body holding a shared reference to an immutable string.
+
+    Many messages may refer to the same string, which is
+    written to the stream without being copied.
+*/
+struct shared_body
+{
+    using value_type = std::shared_ptr<std::string const>;
+
+    class writer
+    {
+        value_type body_;
+
+    public:
+        writer(writer const&) = delete;
+        writer& operator=(writer const&) = delete;
+
+        template<bool isRequest, class Fields>
+        writer(message<isRequest, shared_body, Fields> const& m) noexcept
+            : body_(m.body)
+        {
+        }
+
+        void
+        init(error_code& ec) noexcept
+        {
+            if(! body_)
+                ec = boost::system::errc::make_error_code(
+                    boost::system::errc::invalid_argument);
+        }
+
+        std::uint64_t
+        content_length() const noexcept
+        {
+            return body_->size();
+        }
+
+        template<class WriteFunction>
+        boost::tribool
+        write(resume_context&&, error_code&,
+            WriteFunction&& wf) noexcept
+        {
+            wf(boost::asio::buffer(*body_));
+            return true;
+        }
+    };
+};
+
+} // http
+} // beast
+
+#endif
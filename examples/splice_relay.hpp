@@ -0,0 +1,499 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_EXAMPLE_SPLICE_RELAY_H_INCLUDED
+#define BEAST_EXAMPLE_SPLICE_RELAY_H_INCLUDED
+
+#include <beast/core/error.hpp>
+#include <beast/http/parse_error.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <limits>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace beast {
+namespace http {
+
+#ifdef __linux__
+
+/** A pipe used as the kernel buffer between two spliced sockets.
+
+    The pipe is created lazily, and kept for the life of the object
+    so that one pipe serves every message on a connection.
+*/
+class splice_pipe
+{
+    int fd_[2] = {-1, -1};
+
+public:
+    splice_pipe(splice_pipe const&) = delete;
+    splice_pipe& operator=(splice_pipe const&) = delete;
+
+    splice_pipe() = default;
+
+    ~splice_pipe()
+    {
+        if(fd_[0] != -1)
+            ::close(fd_[0]);
+        if(fd_[1] != -1)
+            ::close(fd_[1]);
+    }
+
+    /// Returns the read end of the pipe, or -1 if not open
+    int
+    read_end() const
+    {
+        return fd_[0];
+    }
+
+    /// Returns the write end of the pipe, or -1 if not open
+    int
+    write_end() const
+    {
+        return fd_[1];
+    }
+
+    /// Create the pipe if it is not already open
+    void
+    open(error_code& ec)
+    {
+        if(fd_[0] != -1)
+            return;
+        if(::pipe2(fd_, O_CLOEXEC) == -1)
+        {
+            fd_[0] = -1;
+            fd_[1] = -1;
+            ec = boost::system::errc::make_error_code(
+                static_cast<boost::system::errc::errc_t>(errno));
+        }
+    }
+};
+
+#else
+
+/** Stands in for the splice pipe where splice is not available.
+
+    Bodies between TCP sockets are then copied like any other.
+*/
+class splice_pipe
+{
+public:
+    splice_pipe(splice_pipe const&) = delete;
+    splice_pipe& operator=(splice_pipe const&) = delete;
+
+    splice_pipe() = default;
+};
+
+#endif
+
+/** Tracks the extent of a chunked body without decoding it.
+
+    Octets are forwarded verbatim, the scanner only follows the
+    chunk framing far enough to know where the message ends,
+    including the last chunk and any trailer fields.
+*/
+class chunk_scanner
+{
+    enum state
+    {
+        s_size0,
+        s_size,
+        s_ext,
+        s_size_lf,
+        s_data,
+        s_data_cr,
+        s_data_lf,
+        s_trailer,
+        s_trailer_line,
+        s_trailer_lf,
+        s_final_lf,
+        s_done
+    };
+
+    state s_ = s_size0;
+    std::uint64_t size_ = 0;
+
+public:
+    /// Returns `true` if the end of the body was seen
+    bool
+    done() const
+    {
+        return s_ == s_done;
+    }
+
+    /** Scan the next octets of a chunked body.
+
+        @param p A pointer to the octets.
+
+        @param n The number of octets.
+
+        @param ec Set to the error, if any occurred.
+
+        @return The number of octets which belong to the body.
+        This is less than `n` only when the end of the body is
+        reached or an error occurs.
+    */
+    std::size_t
+    scan(char const* p, std::size_t n, error_code& ec)
+    {
+        auto const hex =
+            [](char c) -> int
+            {
+                if(c >= '0' && c <= '9')
+                    return c - '0';
+                if(c >= 'a' && c <= 'f')
+                    return c - 'a' + 10;
+                if(c >= 'A' && c <= 'F')
+                    return c - 'A' + 10;
+                return -1;
+            };
+        auto const fail =
+            [&](parse_error e)
+            {
+                ec = e;
+            };
+        std::size_t i = 0;
+        while(i < n && s_ != s_done)
+        {
+            auto const c = p[i];
+            switch(s_)
+            {
+            case s_size0:
+            case s_size:
+            {
+                auto const d = hex(c);
+                if(d != -1)
+                {
+                    if(size_ > ((std::numeric_limits<
+                            std::uint64_t>::max)() >> 4))
+                        return fail(parse_error::invalid_chunk_size), i;
+                    size_ = 16 * size_ + d;
+                    s_ = s_size;
+                }
+                else if(s_ == s_size0)
+                    return fail(parse_error::invalid_chunk_size), i;
+                else if(c == ';' || c == ' ' || c == '\t')
+                    s_ = s_ext;
+                else if(c == '\r')
+                    s_ = s_size_lf;
+                else
+                    return fail(parse_error::invalid_chunk_size), i;
+                ++i;
+                break;
+            }
+
+            case s_ext:
+                if(c == '\r')
+                    s_ = s_size_lf;
+                ++i;
+                break;
+
+            case s_size_lf:
+                if(c != '\n')
+                    return fail(parse_error::bad_crlf), i;
+                s_ = size_ == 0 ? s_trailer : s_data;
+                ++i;
+                break;
+
+            case s_data:
+            {
+                auto const m = static_cast<std::size_t>(
+                    (std::min<std::uint64_t>)(size_, n - i));
+                size_ -= m;
+                i += m;
+                if(size_ == 0)
+                    s_ = s_data_cr;
+                break;
+            }
+
+            case s_data_cr:
+                if(c != '\r')
+                    return fail(parse_error::bad_crlf), i;
+                s_ = s_data_lf;
+                ++i;
+                break;
+
+            case s_data_lf:
+                if(c != '\n')
+                    return fail(parse_error::bad_crlf), i;
+                s_ = s_size0;
+                ++i;
+                break;
+
+            case s_trailer:
+                s_ = c == '\r' ? s_final_lf : s_trailer_line;
+                ++i;
+                break;
+
+            case s_trailer_line:
+                if(c == '\r')
+                    s_ = s_trailer_lf;
+                ++i;
+                break;
+
+            case s_trailer_lf:
+                if(c != '\n')
+                    return fail(parse_error::bad_crlf), i;
+                s_ = s_trailer;
+                ++i;
+                break;
+
+            case s_final_lf:
+                if(c != '\n')
+                    return fail(parse_error::bad_crlf), i;
+                s_ = s_done;
+                ++i;
+                break;
+
+            case s_done:
+                break;
+            }
+        }
+        return i;
+    }
+};
+
+/** Relay a body of known length, copying through a bounded buffer.
+
+    This works with any stream, including SSL streams, whose
+    octets cannot be moved by the kernel. Octets already read
+    into the dynamic buffer while parsing the header are sent
+    first.
+
+    @param from The stream to read the body from.
+
+    @param to The stream to write the body to.
+
+    @param dynabuf The buffer used when parsing the header.
+
+    @param n The number of octets in the body.
+
+    @param ec Set to the error, if any occurred.
+*/
+template<class SyncReadStream,
+    class SyncWriteStream, class DynamicBuffer>
+void
+relay_body(SyncReadStream& from, SyncWriteStream& to,
+    DynamicBuffer& dynabuf, std::uint64_t n, error_code& ec)
+{
+    std::uint8_t buf[16384];
+    while(n > 0)
+    {
+        std::size_t m;
+        if(dynabuf.size() > 0)
+        {
+            m = boost::asio::buffer_copy(boost::asio::buffer(buf,
+                static_cast<std::size_t>((std::min<std::uint64_t>)(
+                    n, sizeof(buf)))), dynabuf.data());
+            dynabuf.consume(m);
+        }
+        else
+        {
+            m = from.read_some(boost::asio::buffer(buf,
+                static_cast<std::size_t>((std::min<std::uint64_t>)(
+                    n, sizeof(buf)))), ec);
+            if(ec)
+                return;
+        }
+        boost::asio::write(to, boost::asio::buffer(buf, m), ec);
+        if(ec)
+            return;
+        n -= m;
+    }
+}
+
+#ifdef __linux__
+
+/** Relay a body of known length between TCP sockets using splice.
+
+    The octets move from the receive queue of one socket to the
+    send queue of the other through a pipe, without ever being
+    copied into user space. If the kernel refuses to splice these
+    descriptors, the remainder is relayed by copying instead.
+
+    @param from The socket to read the body from.
+
+    @param to The socket to write the body to.
+
+    @param dynabuf The buffer used when parsing the header.
+
+    @param n The number of octets in the body.
+
+    @param pipe The pipe to splice through.
+
+    @param ec Set to the error, if any occurred.
+*/
+template<class DynamicBuffer>
+void
+relay_body(boost::asio::ip::tcp::socket& from,
+    boost::asio::ip::tcp::socket& to, DynamicBuffer& dynabuf,
+        std::uint64_t n, splice_pipe& pipe, error_code& ec)
+{
+    // Octets read past the header can't be spliced
+    auto const m = (std::min<std::uint64_t>)(n, dynabuf.size());
+    if(m > 0)
+    {
+        relay_body(from, to, dynabuf, m, ec);
+        if(ec)
+            return;
+        n -= m;
+    }
+    if(n == 0)
+        return;
+    pipe.open(ec);
+    if(ec)
+        return;
+    auto const errno_ec =
+        []
+        {
+            return boost::system::errc::make_error_code(
+                static_cast<boost::system::errc::errc_t>(errno));
+        };
+    auto const in = from.native_handle();
+    auto const out = to.native_handle();
+    while(n > 0)
+    {
+        auto const want = static_cast<std::size_t>(
+            (std::min<std::uint64_t>)(n, 65536));
+        auto const got = ::splice(in, nullptr,
+            pipe.write_end(), nullptr, want,
+                SPLICE_F_MOVE | SPLICE_F_MORE);
+        if(got == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == EINVAL)
+                return relay_body(from, to, dynabuf, n, ec);
+            ec = errno_ec();
+            return;
+        }
+        if(got == 0)
+        {
+            ec = boost::asio::error::eof;
+            return;
+        }
+        // Empty the pipe before reading more, so its
+        // contents never outlive the loop on an error.
+        auto left = static_cast<std::size_t>(got);
+        while(left > 0)
+        {
+            auto const put = ::splice(pipe.read_end(), nullptr,
+                out, nullptr, left, SPLICE_F_MOVE |
+                    (n > static_cast<std::uint64_t>(got) ?
+                        SPLICE_F_MORE : 0));
+            if(put == -1)
+            {
+                if(errno == EINTR)
+                    continue;
+                ec = errno_ec();
+                return;
+            }
+            left -= static_cast<std::size_t>(put);
+        }
+        n -= static_cast<std::size_t>(got);
+    }
+}
+
+#else
+
+/** Relay a body of known length between TCP sockets.
+
+    Without splice, the octets are copied through a bounded buffer.
+*/
+template<class DynamicBuffer>
+void
+relay_body(boost::asio::ip::tcp::socket& from,
+    boost::asio::ip::tcp::socket& to, DynamicBuffer& dynabuf,
+        std::uint64_t n, splice_pipe&, error_code& ec)
+{
+    relay_body(from, to, dynabuf, n, ec);
+}
+
+#endif
+
+/** Relay a chunked body, copying through a bounded buffer.
+
+    The chunks are forwarded as they arrive without being decoded,
+    so the peer receives exactly the framing that was sent.
+
+    @param from The stream to read the body from.
+
+    @param to The stream to write the body to.
+
+    @param dynabuf The buffer used when parsing the header.
+    On return it holds any octets read past the end of the body.
+
+    @param ec Set to the error, if any occurred.
+*/
+template<class SyncReadStream,
+    class SyncWriteStream, class DynamicBuffer>
+void
+relay_chunked(SyncReadStream& from, SyncWriteStream& to,
+    DynamicBuffer& dynabuf, error_code& ec)
+{
+    chunk_scanner cs;
+    std::uint8_t buf[16384];
+    while(! cs.done())
+    {
+        if(dynabuf.size() == 0)
+        {
+            auto const m = from.read_some(
+                dynabuf.prepare(sizeof(buf)), ec);
+            if(ec)
+                return;
+            dynabuf.commit(m);
+        }
+        auto const m = boost::asio::buffer_copy(
+            boost::asio::buffer(buf), dynabuf.data());
+        auto const used = cs.scan(
+            reinterpret_cast<char const*>(buf), m, ec);
+        if(ec)
+            return;
+        boost::asio::write(to, boost::asio::buffer(buf, used), ec);
+        if(ec)
+            return;
+        dynabuf.consume(used);
+    }
+}
+
+/** Relay a body delimited by the end of the stream.
+
+    @param from The stream to read the body from.
+
+    @param to The stream to write the body to.
+
+    @param dynabuf The buffer used when parsing the header.
+
+    @param ec Set to the error, if any occurred. The end
+    of the stream is not reported as an error.
+*/
+template<class SyncReadStream,
+    class SyncWriteStream, class DynamicBuffer>
+void
+relay_until_eof(SyncReadStream& from, SyncWriteStream& to,
+    DynamicBuffer& dynabuf, error_code& ec)
+{
+    relay_body(from, to, dynabuf, dynabuf.size(), ec);
+    if(ec)
+        return;
+    relay_body(from, to, dynabuf,
+        (std::numeric_limits<std::uint64_t>::max)(), ec);
+    if(ec == boost::asio::error::eof)
+        ec = {};
+}
+
+} // http
+} // beast
+
+#endif
@@ -9,6 +9,8 @@
 #define BEAST_DETAIL_BASE64_HPP
 
 #include <cctype>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace beast {
@@ -62,54 +64,70 @@ is_base64(unsigned char c)
     return (std::isalnum(c) || (c == '+') || (c == '/'));
 }
 
-template<class = void>
-std::string
-base64_encode (std::uint8_t const* data,
-    std::size_t in_len)
+/// Returns the number of characters needed to encode `n` bytes
+inline
+std::size_t constexpr
+base64_encoded_size(std::size_t n)
 {
-    unsigned char c3[3], c4[4];
-    int i = 0;
-    int j = 0;
+    return 4 * ((n + 2) / 3);
+}
 
-    std::string ret;
-    ret.reserve (3 + in_len * 8 / 6);
+/** Encode a series of octets as a padded, base64 string.
 
-    char const* alphabet (base64_alphabet().data());
+    The caller provides storage for
+    `base64_encoded_size(in_len)` characters.
 
-    while(in_len--)
+    @return The number of characters written.
+*/
+template<class = void>
+std::size_t
+base64_encode(char* dest,
+    std::uint8_t const* data, std::size_t in_len)
+{
+    char const* alphabet (base64_alphabet().data());
+    auto out = dest;
+    for(; in_len >= 3; in_len -= 3, data += 3)
     {
-        c3[i++] = *(data++);
-        if(i == 3)
-        {
-            c4[0] = (c3[0] & 0xfc) >> 2;
-            c4[1] = ((c3[0] & 0x03) << 4) + ((c3[1] & 0xf0) >> 4);
-            c4[2] = ((c3[1] & 0x0f) << 2) + ((c3[2] & 0xc0) >> 6);
-            c4[3] = c3[2] & 0x3f;
-            for(i = 0; (i < 4); i++)
-                ret += alphabet[c4[i]];
-            i = 0;
-        }
+        *out++ = alphabet[(data[0] & 0xfc) >> 2];
+        *out++ = alphabet[((data[0] & 0x03) << 4) +
+            ((data[1] & 0xf0) >> 4)];
+        *out++ = alphabet[((data[1] & 0x0f) << 2) +
+            ((data[2] & 0xc0) >> 6)];
+        *out++ = alphabet[data[2] & 0x3f];
     }
-
-    if(i)
+    switch(in_len)
     {
-        for(j = i; j < 3; j++)
-            c3[j] = '\0';
-
-        c4[0] = (c3[0] & 0xfc) >> 2;
-        c4[1] = ((c3[0] & 0x03) << 4) + ((c3[1] & 0xf0) >> 4);
-        c4[2] = ((c3[1] & 0x0f) << 2) + ((c3[2] & 0xc0) >> 6);
-        c4[3] = c3[2] & 0x3f;
-
-        for(j = 0; (j < i + 1); j++)
-            ret += alphabet[c4[j]];
-
-        while((i++ < 3))
-            ret += '=';
+    case 2:
+        *out++ = alphabet[(data[0] & 0xfc) >> 2];
+        *out++ = alphabet[((data[0] & 0x03) << 4) +
+            ((data[1] & 0xf0) >> 4)];
+        *out++ = alphabet[(data[1] & 0x0f) << 2];
+        *out++ = '=';
+        break;
+
+    case 1:
+        *out++ = alphabet[(data[0] & 0xfc) >> 2];
+        *out++ = alphabet[(data[0] & 0x03) << 4];
+        *out++ = '=';
+        *out++ = '=';
+        break;
+
+    default:
+        break;
     }
+    return static_cast<std::size_t>(out - dest);
+}
 
+template<class = void>
+std::string
+base64_encode (std::uint8_t const* data,
+    std::size_t in_len)
+{
+    std::string ret;
+    ret.resize(base64_encoded_size(in_len));
+    if(in_len > 0)
+        base64_encode(&ret[0], data, in_len);
     return ret;
-
 }
 
 template<class = void>
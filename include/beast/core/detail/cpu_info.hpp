@@ -0,0 +1,102 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_CORE_DETAIL_CPU_INFO_HPP
+#define BEAST_CORE_DETAIL_CPU_INFO_HPP
+
+// SIMD code paths are available on x86-64, where SSE2 is part of the
+// baseline instruction set. Wider instruction sets are compiled with
+// per-function target attributes and selected at run time, so the
+// program runs on any x86-64 processor. Define BEAST_NO_SIMD to use
+// only the portable code.
+//
+#ifndef BEAST_NO_SIMD
+# if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#  define BEAST_SIMD_X86 1
+#  define BEAST_TARGET(isa) __attribute__((target(isa)))
+# elif defined(_M_X64) && defined(_MSC_VER)
+#  define BEAST_SIMD_X86 1
+#  define BEAST_TARGET(isa)
+# endif
+#endif
+
+#ifndef BEAST_SIMD_X86
+# define BEAST_SIMD_X86 0
+#endif
+
+#if BEAST_SIMD_X86
+# ifdef _MSC_VER
+#  include <intrin.h>
+# else
+#  include <cpuid.h>
+# endif
+# include <immintrin.h>
+#endif
+
+namespace beast {
+namespace detail {
+
+/// The instruction set extensions usable by this process.
+struct cpu_info
+{
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool avx2 = false;
+    bool avx512bw = false;
+    bool sha = false;
+
+    cpu_info()
+    {
+#if BEAST_SIMD_X86
+        sse2 = true;
+# ifdef _MSC_VER
+        int r[4];
+        __cpuid(r, 0);
+        auto const max = r[0];
+        __cpuid(r, 1);
+        ssse3 = (r[2] & (1 << 9)) != 0;
+        // The OS must save the wider registers on a context switch
+        bool const osxsave = (r[2] & (1 << 27)) != 0;
+        auto const xcr0 = osxsave ? _xgetbv(0) : 0;
+        if(max >= 7)
+        {
+            __cpuidex(r, 7, 0);
+            avx2 = (r[1] & (1 << 5)) != 0 &&
+                (xcr0 & 0x06) == 0x06;
+            avx512bw = (r[1] & (1 << 16)) != 0 &&
+                (r[1] & (1 << 30)) != 0 &&
+                    (xcr0 & 0xe6) == 0xe6;
+            sha = (r[1] & (1 << 29)) != 0;
+        }
+# else
+        __builtin_cpu_init();
+        ssse3 = __builtin_cpu_supports("ssse3") != 0;
+        avx2 = __builtin_cpu_supports("avx2") != 0;
+        avx512bw = __builtin_cpu_supports("avx512f") != 0 &&
+            __builtin_cpu_supports("avx512bw") != 0;
+        // Not every compiler knows the name "sha"
+        unsigned a, b, c, d;
+        sha = __get_cpuid_count(7, 0, &a, &b, &c, &d) &&
+            (b & (1 << 29)) != 0;
+# endif
+#endif
+    }
+};
+
+/// Returns the instruction set extensions usable by this process.
+inline
+cpu_info const&
+get_cpu_info()
+{
+    static cpu_info const info;
+    return info;
+}
+
+} // detail
+} // beast
+
+#endif
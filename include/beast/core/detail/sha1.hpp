@@ -8,6 +8,7 @@
 #ifndef BEAST_DETAIL_SHA1_HPP
 #define BEAST_DETAIL_SHA1_HPP
 
+#include <beast/core/detail/cpu_info.hpp>
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
@@ -214,6 +215,120 @@ transform(
     digest[4] += e;
 }
 
+// Process whole blocks without vector instructions
+//
+template<class = void>
+void
+transform_scalar(std::uint32_t digest[],
+    std::uint8_t const* p, std::size_t blocks)
+{
+    for(; blocks > 0; --blocks, p += BLOCK_BYTES)
+    {
+        std::uint32_t block[BLOCK_INTS];
+        make_block(p, block);
+        transform(digest, block);
+    }
+}
+
+#if BEAST_SIMD_X86
+
+// Four rounds, the immediate operand selects the round function
+//
+template<class = void>
+BEAST_TARGET("sha,ssse3,sse4.1")
+__m128i
+rnds4(__m128i abcd, __m128i e, std::size_t f)
+{
+    switch(f)
+    {
+    case 0:  return _mm_sha1rnds4_epu32(abcd, e, 0);
+    case 1:  return _mm_sha1rnds4_epu32(abcd, e, 1);
+    case 2:  return _mm_sha1rnds4_epu32(abcd, e, 2);
+    default: return _mm_sha1rnds4_epu32(abcd, e, 3);
+    }
+}
+
+// Process whole blocks with the SHA extensions. The state stays
+// in registers from one block to the next. Step s performs rounds
+// 4s to 4s+3 while scheduling the message words of later steps.
+//
+template<class = void>
+BEAST_TARGET("sha,ssse3,sse4.1")
+void
+transform_shani(std::uint32_t digest[],
+    std::uint8_t const* p, std::size_t blocks)
+{
+    // Reverses the bytes of each word
+    __m128i const bswap = _mm_set_epi64x(
+        0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(digest)), 0x1b);
+    __m128i e0 = _mm_set_epi32(
+        static_cast<int>(digest[4]), 0, 0, 0);
+    __m128i e1 = _mm_setzero_si128();
+    __m128i m[4];
+    for(; blocks > 0; --blocks, p += BLOCK_BYTES)
+    {
+        auto const abcd_save = abcd;
+        auto const e_save = e0;
+        for(std::size_t s = 0; s < 20; ++s)
+        {
+            auto& w = m[s % 4];
+            if(s < 4)
+                w = _mm_shuffle_epi8(_mm_loadu_si128(
+                    reinterpret_cast<__m128i const*>(
+                        p + 16 * s)), bswap);
+            if(s % 2 == 0)
+            {
+                e0 = s == 0 ?
+                    _mm_add_epi32(e0, w) :
+                    _mm_sha1nexte_epu32(e0, w);
+                e1 = abcd;
+            }
+            else
+            {
+                e1 = _mm_sha1nexte_epu32(e1, w);
+                e0 = abcd;
+            }
+            if(s >= 3 && s <= 18)
+                m[(s + 1) % 4] =
+                    _mm_sha1msg2_epu32(m[(s + 1) % 4], w);
+            abcd = rnds4(abcd, s % 2 == 0 ? e0 : e1, s / 5);
+            if(s >= 1 && s <= 16)
+                m[(s + 3) % 4] =
+                    _mm_sha1msg1_epu32(m[(s + 3) % 4], w);
+            if(s >= 2 && s <= 17)
+                m[(s + 2) % 4] =
+                    _mm_xor_si128(m[(s + 2) % 4], w);
+        }
+        // After an odd number of steps, e0 holds the next e
+        e0 = _mm_sha1nexte_epu32(e0, e_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(digest),
+        _mm_shuffle_epi32(abcd, 0x1b));
+    digest[4] = static_cast<std::uint32_t>(
+        _mm_extract_epi32(e0, 3));
+}
+
+#endif
+
+// Process whole blocks with the
+// fastest code the processor supports
+//
+inline
+void
+transform_blocks(std::uint32_t digest[],
+    std::uint8_t const* p, std::size_t blocks)
+{
+#if BEAST_SIMD_X86
+    auto const& cpu = get_cpu_info();
+    if(cpu.sha && cpu.ssse3)
+        return transform_shani(digest, p, blocks);
+#endif
+    transform_scalar(digest, p, blocks);
+}
+
 } // sha1
 
 struct sha1_context
@@ -247,7 +362,7 @@ update(sha1_context& ctx,
 {
     auto p = reinterpret_cast<
         std::uint8_t const*>(message);
-    for(;;)
+    if(ctx.buflen > 0)
     {
         auto const n = (std::min)(
             size, sizeof(ctx.buf) - ctx.buflen);
@@ -258,40 +373,47 @@ update(sha1_context& ctx,
         p += n;
         size -= n;
         ctx.buflen = 0;
-        std::uint32_t block[sha1::BLOCK_INTS];
-        sha1::make_block(ctx.buf, block);
-        sha1::transform(ctx.digest, block);
+        sha1::transform_blocks(ctx.digest, ctx.buf, 1);
         ++ctx.blocks;
     }
+    // Whole blocks are hashed where they lie
+    auto const blocks = size / sha1::BLOCK_BYTES;
+    if(blocks > 0)
+    {
+        sha1::transform_blocks(ctx.digest, p, blocks);
+        ctx.blocks += blocks;
+        p += blocks * sha1::BLOCK_BYTES;
+        size -= blocks * sha1::BLOCK_BYTES;
+    }
+    std::memcpy(ctx.buf, p, size);
+    ctx.buflen = size;
 }
 
 template<class = void>
 void
 finish(sha1_context& ctx, void* digest) noexcept
 {
-    using sha1::BLOCK_INTS;
     using sha1::BLOCK_BYTES;
 
     std::uint64_t total_bits =
         (ctx.blocks*64 + ctx.buflen) * 8;
     // pad
     ctx.buf[ctx.buflen++] = 0x80;
-    auto const buflen = ctx.buflen;
-    while(ctx.buflen < 64)
-        ctx.buf[ctx.buflen++] = 0x00;
-    std::uint32_t block[BLOCK_INTS];
-    sha1::make_block(ctx.buf, block);
-    if(buflen > BLOCK_BYTES - 8)
+    if(ctx.buflen > BLOCK_BYTES - 8)
     {
-        sha1::transform(ctx.digest, block);
-        for(size_t i = 0; i < BLOCK_INTS - 2; i++)
-            block[i] = 0;
+        std::memset(ctx.buf + ctx.buflen, 0,
+            BLOCK_BYTES - ctx.buflen);
+        sha1::transform_blocks(ctx.digest, ctx.buf, 1);
+        ctx.buflen = 0;
     }
+    std::memset(ctx.buf + ctx.buflen, 0,
+        BLOCK_BYTES - 8 - ctx.buflen);
 
-    /* Append total_bits, split this uint64_t into two uint32_t */
-    block[BLOCK_INTS - 1] = total_bits & 0xffffffff;
-    block[BLOCK_INTS - 2] = (total_bits >> 32);
-    sha1::transform(ctx.digest, block);
+    // Append total_bits, most significant byte first
+    for(std::size_t i = 0; i < 8; ++i)
+        ctx.buf[BLOCK_BYTES - 1 - i] =
+            static_cast<std::uint8_t>(total_bits >> (8 * i));
+    sha1::transform_blocks(ctx.digest, ctx.buf, 1);
     for(std::size_t i = 0; i < sha1::DIGEST_BYTES/4; i++)
     {
         std::uint8_t* d =
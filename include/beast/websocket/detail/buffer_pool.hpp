@@ -0,0 +1,200 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_BUFFER_POOL_HPP
+#define BEAST_WEBSOCKET_DETAIL_BUFFER_POOL_HPP
+
+#include <boost/assert.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+/** A process-wide pool of buffers in power of two size classes.
+
+    Streams hold a read or write buffer only while a message which
+    needs one is in progress, and give it back here afterwards, so
+    that idle connections cost no buffer memory. Each size class
+    retains a bounded number of idle bytes. Requests larger than the
+    largest class are passed through to the heap.
+
+    Objects of this type may be used concurrently from multiple threads.
+*/
+class buffer_pool
+{
+    // Precedes each buffer. The next pointer is
+    // only used while the buffer is in a free list.
+    struct alignas(16) header
+    {
+        std::size_t size;
+        header* next;
+    };
+
+    static std::size_t constexpr min_shift = 9;     // 512 bytes
+    static std::size_t constexpr classes = 9;       // up to 128KB
+
+    std::mutex m_;
+    header* free_[classes] = {};
+    std::size_t idle_[classes] = {};
+    std::size_t max_idle_;
+    std::atomic<std::size_t> used_{0};
+
+public:
+    buffer_pool(buffer_pool const&) = delete;
+    buffer_pool& operator=(buffer_pool const&) = delete;
+
+    /** Construct the pool.
+
+        @param max_idle The largest number of idle bytes
+        retained by each size class.
+    */
+    explicit
+    buffer_pool(std::size_t max_idle = 4 * 1024 * 1024)
+        : max_idle_(max_idle)
+    {
+    }
+
+    ~buffer_pool()
+    {
+        for(auto h : free_)
+        {
+            while(h)
+            {
+                auto const next = h->next;
+                ::operator delete(h);
+                h = next;
+            }
+        }
+    }
+
+    /// Returns the pool shared by all streams
+    static
+    buffer_pool&
+    instance()
+    {
+        // Never destroyed, since streams with static
+        // storage duration may release buffers late.
+        static buffer_pool* const p = new buffer_pool;
+        return *p;
+    }
+
+    /// Returns the number of bytes in buffers handed out
+    std::size_t
+    in_use() const
+    {
+        return used_.load(std::memory_order_relaxed);
+    }
+
+    /// Returns the number of bytes in idle buffers
+    std::size_t
+    idle()
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        std::size_t n = 0;
+        for(auto const size : idle_)
+            n += size;
+        return n;
+    }
+
+    /** Return a buffer of at least `n` bytes.
+
+        The buffer must be given back with @ref deallocate.
+    */
+    std::uint8_t*
+    allocate(std::size_t n)
+    {
+        auto const i = index(n);
+        header* h = nullptr;
+        if(i < classes)
+        {
+            n = std::size_t{1} << (min_shift + i);
+            std::lock_guard<std::mutex> lock(m_);
+            h = free_[i];
+            if(h)
+            {
+                free_[i] = h->next;
+                idle_[i] -= n;
+            }
+        }
+        if(! h)
+        {
+            h = ::new(::operator new(sizeof(header) + n)) header;
+            h->size = n;
+        }
+        used_.fetch_add(n, std::memory_order_relaxed);
+        return reinterpret_cast<std::uint8_t*>(h + 1);
+    }
+
+    /// Give back a buffer returned by @ref allocate
+    void
+    deallocate(std::uint8_t* p) noexcept
+    {
+        auto const h =
+            reinterpret_cast<header*>(p) - 1;
+        auto const n = h->size;
+        used_.fetch_sub(n, std::memory_order_relaxed);
+        auto const i = index(n);
+        if(i < classes)
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            if(idle_[i] + n <= max_idle_)
+            {
+                h->next = free_[i];
+                free_[i] = h;
+                idle_[i] += n;
+                return;
+            }
+        }
+        ::operator delete(h);
+    }
+
+private:
+    static
+    std::size_t
+    index(std::size_t n)
+    {
+        std::size_t i = 0;
+        while(i < classes &&
+                n > (std::size_t{1} << (min_shift + i)))
+            ++i;
+        return i;
+    }
+};
+
+/// Gives a buffer back to the shared pool
+struct buffer_deleter
+{
+    void
+    operator()(std::uint8_t* p) const noexcept
+    {
+        buffer_pool::instance().deallocate(p);
+    }
+};
+
+/// A buffer owned by a stream and borrowed from the shared pool
+using pooled_buffer =
+    std::unique_ptr<std::uint8_t[], buffer_deleter>;
+
+/// Return a buffer of at least `n` bytes from the shared pool
+inline
+pooled_buffer
+make_pooled_buffer(std::size_t n)
+{
+    return pooled_buffer{buffer_pool::instance().allocate(n)};
+}
+
+} // detail
+} // websocket
+} // beast
+
+#endif
@@ -0,0 +1,164 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_CHACHA_HPP
+#define BEAST_WEBSOCKET_DETAIL_CHACHA_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+/** A ChaCha keystream generator, as described in rfc7539.
+
+    Each call returns the next 32-bit word of the keystream. Words
+    are produced a block of sixteen at a time, so the cost of the
+    block function is shared by the keys drawn from it.
+
+    @tparam Rounds The number of rounds, which must be even.
+*/
+template<std::size_t Rounds>
+class chacha
+{
+    static_assert(Rounds % 2 == 0,
+        "Rounds must be even");
+
+    std::uint32_t in_[16];
+    std::uint32_t out_[16];
+    std::size_t n_ = 16;
+
+public:
+    using result_type = std::uint32_t;
+
+    /// Construct the generator with an all-zero key
+    chacha();
+
+    static constexpr
+    result_type
+    min()
+    {
+        return 0;
+    }
+
+    static constexpr
+    result_type
+    max()
+    {
+        return (std::numeric_limits<result_type>::max)();
+    }
+
+    /** Set the key, nonce, and block counter.
+
+        The next word returned is the first word of the block
+        selected by `counter`.
+    */
+    void
+    seed(std::array<std::uint32_t, 8> const& key,
+        std::array<std::uint32_t, 3> const& nonce = {{}},
+            std::uint32_t counter = 0);
+
+    /// Returns the next word of the keystream
+    result_type
+    operator()();
+
+private:
+    void
+    block();
+};
+
+template<std::size_t Rounds>
+chacha<Rounds>::
+chacha()
+{
+    seed({{}});
+}
+
+template<std::size_t Rounds>
+void
+chacha<Rounds>::
+seed(std::array<std::uint32_t, 8> const& key,
+    std::array<std::uint32_t, 3> const& nonce,
+        std::uint32_t counter)
+{
+    // "expand 32-byte k"
+    in_[0] = 0x61707865;
+    in_[1] = 0x3320646e;
+    in_[2] = 0x79622d32;
+    in_[3] = 0x6b206574;
+    for(std::size_t i = 0; i < 8; ++i)
+        in_[4 + i] = key[i];
+    in_[12] = counter;
+    for(std::size_t i = 0; i < 3; ++i)
+        in_[13 + i] = nonce[i];
+    n_ = 16;
+}
+
+template<std::size_t Rounds>
+auto
+chacha<Rounds>::
+operator()() ->
+    result_type
+{
+    if(n_ == 16)
+    {
+        block();
+        n_ = 0;
+    }
+    return out_[n_++];
+}
+
+template<std::size_t Rounds>
+void
+chacha<Rounds>::
+block()
+{
+    auto const rotl =
+        [](std::uint32_t v, int n)
+        {
+            return (v << n) | (v >> (32 - n));
+        };
+    auto const qr =
+        [&](std::uint32_t& a, std::uint32_t& b,
+            std::uint32_t& c, std::uint32_t& d)
+        {
+            a += b; d ^= a; d = rotl(d, 16);
+            c += d; b ^= c; b = rotl(b, 12);
+            a += b; d ^= a; d = rotl(d,  8);
+            c += d; b ^= c; b = rotl(b,  7);
+        };
+    auto& x = out_;
+    for(std::size_t i = 0; i < 16; ++i)
+        x[i] = in_[i];
+    for(std::size_t i = 0; i < Rounds; i += 2)
+    {
+        // column round
+        qr(x[0], x[4], x[ 8], x[12]);
+        qr(x[1], x[5], x[ 9], x[13]);
+        qr(x[2], x[6], x[10], x[14]);
+        qr(x[3], x[7], x[11], x[15]);
+        // diagonal round
+        qr(x[0], x[5], x[10], x[15]);
+        qr(x[1], x[6], x[11], x[12]);
+        qr(x[2], x[7], x[ 8], x[13]);
+        qr(x[3], x[4], x[ 9], x[14]);
+    }
+    for(std::size_t i = 0; i < 16; ++i)
+        x[i] += in_[i];
+    ++in_[12];
+}
+
+using chacha20 = chacha<20>;
+
+} // detail
+} // websocket
+} // beast
+
+#endif
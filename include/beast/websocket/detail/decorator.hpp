@@ -119,9 +119,12 @@ private:
     }
 };
 
+struct default_decorator;
+
 class decorator_type
 {
     std::shared_ptr<abstract_decorator> p_;
+    bool default_;
 
 public:
     decorator_type() = delete;
@@ -137,10 +140,19 @@ public:
     decorator_type(F&& f)
         : p_(std::make_shared<decorator<F>>(
             std::forward<F>(f)))
+        , default_(std::is_same<typename
+            std::decay<F>::type, default_decorator>::value)
     {
         BOOST_ASSERT(p_);
     }
 
+    /// Returns `true` if this wraps the default decorator
+    bool
+    is_default() const
+    {
+        return default_;
+    }
+
     void
     operator()(request_type& req)
     {
@@ -37,20 +37,38 @@ make_sec_ws_key(Gen& g)
         a.data(), a.size());
 }
 
+// The number of characters in a Sec-WebSocket-Accept value
+static std::size_t constexpr sec_ws_accept_size = 28;
+
+/** Calculate the Sec-WebSocket-Accept value for a key.
+
+    Exactly `sec_ws_accept_size` characters are
+    written to `dest`, and no memory is allocated.
+*/
 template<class = void>
-std::string
-make_sec_ws_accept(boost::string_ref const& key)
+void
+make_sec_ws_accept(char* dest, boost::string_ref const& key)
 {
-    std::string s(key.data(), key.size());
-    s += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    static boost::string_ref const guid =
+        "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
     beast::detail::sha1_context ctx;
     beast::detail::init(ctx);
-    beast::detail::update(ctx, s.data(), s.size());
+    beast::detail::update(ctx, key.data(), key.size());
+    beast::detail::update(ctx, guid.data(), guid.size());
     std::array<std::uint8_t,
         beast::detail::sha1_context::digest_size> digest;
     beast::detail::finish(ctx, digest.data());
-    return beast::detail::base64_encode(
-        digest.data(), digest.size());
+    beast::detail::base64_encode(
+        dest, digest.data(), digest.size());
+}
+
+template<class = void>
+std::string
+make_sec_ws_accept(boost::string_ref const& key)
+{
+    char buf[sec_ws_accept_size];
+    make_sec_ws_accept(buf, key);
+    return std::string(buf, sizeof(buf));
 }
 
 } // detail
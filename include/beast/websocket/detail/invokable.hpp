@@ -123,6 +123,12 @@ public:
         return *this;
     }
 
+    bool
+    empty() const
+    {
+        return ! base_;
+    }
+
     template<class F>
     void
     emplace(F&& f);
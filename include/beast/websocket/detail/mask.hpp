@@ -8,7 +8,11 @@
 #ifndef BEAST_WEBSOCKET_DETAIL_MASK_HPP
 #define BEAST_WEBSOCKET_DETAIL_MASK_HPP
 
+#include <beast/websocket/detail/chacha.hpp>
+#include <beast/core/detail/cpu_info.hpp>
 #include <boost/asio/buffer.hpp>
+#include <boost/assert.hpp>
+#include <algorithm>
 #include <array>
 #include <climits>
 #include <cstdint>
@@ -73,9 +77,83 @@ maskgen_t<_>::rekey()
 #endif
 }
 
-// VFALCO NOTE This generator has 5KB of state!
-//using maskgen = maskgen_t<std::mt19937>;
-using maskgen = maskgen_t<std::minstd_rand>;
+// Source of mask keys shared by all streams on a thread
+//
+// Keys are drawn from a ChaCha20 keystream, which is seeded
+// from std::random_device when the thread first needs a key,
+// and reseeded after every reseed_interval keys.
+//
+template<class = void>
+class thread_maskgen_t
+{
+    chacha20 g_;
+    std::size_t n_ = 0;
+
+public:
+    using result_type = std::uint32_t;
+
+    /// The number of keys drawn between reseeds
+    static std::size_t constexpr reseed_interval = 1024 * 1024;
+
+    /// Returns the generator for the calling thread
+    static
+    thread_maskgen_t&
+    instance()
+    {
+        static thread_local thread_maskgen_t g;
+        return g;
+    }
+
+    result_type
+    operator()();
+
+    void
+    rekey();
+};
+
+template<class _>
+auto
+thread_maskgen_t<_>::operator()() ->
+    result_type
+{
+    for(;;)
+    {
+        if(n_-- == 0)
+        {
+            rekey();
+            n_ = reseed_interval - 1;
+        }
+        if(auto key = g_())
+            return key;
+    }
+}
+
+template<class _>
+void
+thread_maskgen_t<_>::rekey()
+{
+    std::random_device rng;
+    std::array<std::uint32_t, 8> key;
+    for(auto& i : key)
+        i = rng();
+    g_.seed(key);
+}
+
+using thread_maskgen = thread_maskgen_t<>;
+
+// The mask key source of a stream, which holds no
+// state of its own and so costs nothing to construct.
+//
+struct maskgen
+{
+    using result_type = std::uint32_t;
+
+    result_type
+    operator()()
+    {
+        return thread_maskgen::instance()();
+    }
+};
 
 //------------------------------------------------------------------------------
 
@@ -229,13 +307,173 @@ mask_inplace_fast(
     }
 }
 
+#if BEAST_SIMD_X86
+
+// The vector kernels mask whole registers, each a multiple of four
+// bytes, so the key phase only changes in the unaligned prologue and
+// the leftovers, which are handled by mask_inplace_fast.
+
+// Returns the number of bytes before p reaches the alignment
+inline
+std::size_t
+mask_prologue(std::uint8_t const* p,
+    std::size_t n, std::size_t align)
+{
+    return (std::min)(n, static_cast<std::size_t>(
+        (0 - reinterpret_cast<std::uintptr_t>(p)) & (align - 1)));
+}
+
+// SSE2 optimized
+//
+template<class KeyType>
+void
+mask_inplace_sse2(
+    boost::asio::mutable_buffer const& b,
+        KeyType& key)
+{
+    using boost::asio::buffer_cast;
+    using boost::asio::buffer_size;
+    auto n = buffer_size(b);
+    auto p = buffer_cast<std::uint8_t*>(b);
+    auto const d = mask_prologue(p, n, 16);
+    mask_inplace_fast(boost::asio::mutable_buffer{p, d}, key);
+    p += d;
+    n -= d;
+    auto const k = _mm_set1_epi32(static_cast<int>(
+        static_cast<std::uint32_t>(key)));
+    for(; n >= 64; n -= 64, p += 64)
+    {
+        auto const v = reinterpret_cast<__m128i*>(p);
+        _mm_store_si128(v,   _mm_xor_si128(_mm_load_si128(v),   k));
+        _mm_store_si128(v+1, _mm_xor_si128(_mm_load_si128(v+1), k));
+        _mm_store_si128(v+2, _mm_xor_si128(_mm_load_si128(v+2), k));
+        _mm_store_si128(v+3, _mm_xor_si128(_mm_load_si128(v+3), k));
+    }
+    for(; n >= 16; n -= 16, p += 16)
+    {
+        auto const v = reinterpret_cast<__m128i*>(p);
+        _mm_store_si128(v, _mm_xor_si128(_mm_load_si128(v), k));
+    }
+    mask_inplace_fast(boost::asio::mutable_buffer{p, n}, key);
+}
+
+// AVX2 optimized
+//
+template<class KeyType>
+BEAST_TARGET("avx2")
+void
+mask_inplace_avx2(
+    boost::asio::mutable_buffer const& b,
+        KeyType& key)
+{
+    using boost::asio::buffer_cast;
+    using boost::asio::buffer_size;
+    auto n = buffer_size(b);
+    auto p = buffer_cast<std::uint8_t*>(b);
+    auto const d = mask_prologue(p, n, 32);
+    mask_inplace_fast(boost::asio::mutable_buffer{p, d}, key);
+    p += d;
+    n -= d;
+    auto const k = _mm256_set1_epi32(static_cast<int>(
+        static_cast<std::uint32_t>(key)));
+    for(; n >= 128; n -= 128, p += 128)
+    {
+        auto const v = reinterpret_cast<__m256i*>(p);
+        _mm256_store_si256(v,   _mm256_xor_si256(_mm256_load_si256(v),   k));
+        _mm256_store_si256(v+1, _mm256_xor_si256(_mm256_load_si256(v+1), k));
+        _mm256_store_si256(v+2, _mm256_xor_si256(_mm256_load_si256(v+2), k));
+        _mm256_store_si256(v+3, _mm256_xor_si256(_mm256_load_si256(v+3), k));
+    }
+    for(; n >= 32; n -= 32, p += 32)
+    {
+        auto const v = reinterpret_cast<__m256i*>(p);
+        _mm256_store_si256(v, _mm256_xor_si256(_mm256_load_si256(v), k));
+    }
+    mask_inplace_fast(boost::asio::mutable_buffer{p, n}, key);
+}
+
+// AVX-512 optimized
+//
+template<class KeyType>
+BEAST_TARGET("avx512f")
+void
+mask_inplace_avx512(
+    boost::asio::mutable_buffer const& b,
+        KeyType& key)
+{
+    using boost::asio::buffer_cast;
+    using boost::asio::buffer_size;
+    auto n = buffer_size(b);
+    auto p = buffer_cast<std::uint8_t*>(b);
+    auto const d = mask_prologue(p, n, 64);
+    mask_inplace_fast(boost::asio::mutable_buffer{p, d}, key);
+    p += d;
+    n -= d;
+    auto const k = _mm512_set1_epi32(static_cast<int>(
+        static_cast<std::uint32_t>(key)));
+    for(; n >= 256; n -= 256, p += 256)
+    {
+        auto const v = reinterpret_cast<__m512i*>(p);
+        _mm512_store_si512(v,   _mm512_xor_si512(_mm512_load_si512(v),   k));
+        _mm512_store_si512(v+1, _mm512_xor_si512(_mm512_load_si512(v+1), k));
+        _mm512_store_si512(v+2, _mm512_xor_si512(_mm512_load_si512(v+2), k));
+        _mm512_store_si512(v+3, _mm512_xor_si512(_mm512_load_si512(v+3), k));
+    }
+    for(; n >= 64; n -= 64, p += 64)
+    {
+        auto const v = reinterpret_cast<__m512i*>(p);
+        _mm512_store_si512(v, _mm512_xor_si512(_mm512_load_si512(v), k));
+    }
+    mask_inplace_fast(boost::asio::mutable_buffer{p, n}, key);
+}
+
+template<class KeyType>
+using mask_function = void(*)(
+    boost::asio::mutable_buffer const&, KeyType&);
+
+// Choose the widest kernel the processor supports
+//
+template<class KeyType>
+mask_function<KeyType>
+select_mask_inplace()
+{
+    auto const& cpu = beast::detail::get_cpu_info();
+    if(cpu.avx512bw)
+        return &mask_inplace_avx512<KeyType>;
+    if(cpu.avx2)
+        return &mask_inplace_avx2<KeyType>;
+    return &mask_inplace_sse2<KeyType>;
+}
+
+#endif
+
+// Buffers smaller than this are masked without vector instructions
+static std::size_t constexpr mask_simd_threshold = 64;
+
+template<class KeyType>
+void
+mask_inplace_select(
+    boost::asio::mutable_buffer const& b,
+        KeyType& key)
+{
+#if BEAST_SIMD_X86
+    if(boost::asio::buffer_size(b) >= mask_simd_threshold)
+    {
+        static auto const f =
+            select_mask_inplace<KeyType>();
+        return f(b, key);
+    }
+#endif
+    mask_inplace_fast(b, key);
+}
+
 inline
 void
 mask_inplace(
     boost::asio::mutable_buffer const& b,
         std::uint32_t& key)
 {
-    mask_inplace_fast(b, key);
+    mask_inplace_select(b, key);
 }
 
 inline
@@ -244,7 +482,7 @@ mask_inplace(
     boost::asio::mutable_buffer const& b,
         std::uint64_t& key)
 {
-    mask_inplace_fast(b, key);
+    mask_inplace_select(b, key);
 }
 
 // Apply mask in place
@@ -258,6 +496,25 @@ mask_inplace(
         mask_inplace(b, key);
 }
 
+// Apply mask in place to buffers the caller gave up,
+// which only a mutable buffer sequence can be.
+//
+template<class Buffers, class KeyType>
+void
+mask_inplace(
+    Buffers const& bs, KeyType& key, std::true_type)
+{
+    mask_inplace(bs, key);
+}
+
+template<class Buffers, class KeyType>
+void
+mask_inplace(
+    Buffers const&, KeyType&, std::false_type)
+{
+    BOOST_ASSERT(false);
+}
+
 } // detail
 } // websocket
 } // beast
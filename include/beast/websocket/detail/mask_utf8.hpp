@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_MASK_UTF8_HPP
+#define BEAST_WEBSOCKET_DETAIL_MASK_UTF8_HPP
+
+#include <beast/websocket/detail/mask.hpp>
+#include <beast/websocket/detail/utf8_checker.hpp>
+#include <boost/asio/buffer.hpp>
+#include <algorithm>
+#include <cstdint>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+// Bytes unmasked and then validated together. Small enough that
+// the validator reads them from L1 cache, large enough that each
+// piece is validated with vector instructions.
+static std::size_t constexpr mask_utf8_chunk = 2048;
+
+// Unmask text in place and check that it is valid utf8,
+// in a single pass over memory.
+//
+template<class KeyType>
+bool
+mask_utf8_inplace(
+    boost::asio::mutable_buffer const& b,
+        KeyType& key, utf8_checker& utf8)
+{
+    using boost::asio::buffer_cast;
+    using boost::asio::buffer_size;
+    auto n = buffer_size(b);
+    auto p = buffer_cast<std::uint8_t*>(b);
+    while(n > 0)
+    {
+        auto const m = (std::min)(n, mask_utf8_chunk);
+        mask_inplace(boost::asio::mutable_buffer{p, m}, key);
+        if(! utf8.write(p, m))
+            return false;
+        p += m;
+        n -= m;
+    }
+    return true;
+}
+
+template<class MutableBuffers, class KeyType>
+bool
+mask_utf8_inplace(
+    MutableBuffers const& bs,
+        KeyType& key, utf8_checker& utf8)
+{
+    for(boost::asio::mutable_buffer b : bs)
+        if(! mask_utf8_inplace(b, key, utf8))
+            return false;
+    return true;
+}
+
+} // detail
+} // websocket
+} // beast
+
+#endif
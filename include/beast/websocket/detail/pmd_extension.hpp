@@ -16,6 +16,9 @@
 #include <beast/websocket/option.hpp>
 #include <beast/http/rfc7230.hpp>
 #include <boost/asio/buffer.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <utility>
 
 namespace beast {
@@ -278,12 +281,10 @@ pmd_negotiate(
             o.server_max_window_bits;
     if(config.server_max_window_bits < 15)
     {
-        // ZLib's deflateInit silently treats 8 as
-        // 9 due to a bug, so prevent 8 from being used.
+        // A client may ask for a window of 8 bits. ZLib's
+        // deflate can't produce one, so messages from the
+        // server are then sent uncompressed.
         //
-        if(config.server_max_window_bits < 9)
-            config.server_max_window_bits = 9;
-
         s += "; server_max_window_bits=";
         s += std::to_string(
             config.server_max_window_bits);
@@ -331,6 +332,34 @@ pmd_negotiate(
         fields.replace("Sec-WebSocket-Extensions", s);
 }
 
+// Returns `true` if a server's response is acceptable
+// for the offer made with the given local options.
+//
+inline
+bool
+pmd_check(pmd_offer const& res,
+    permessage_deflate const& o)
+{
+    if(! res.accept)
+        return true;
+    if(! o.client_enable)
+        return false;
+    // The server must not use a larger
+    // window than the client offered.
+    auto const server_bits =
+        res.server_max_window_bits == 0 ?
+            15 : res.server_max_window_bits;
+    if(server_bits > o.server_max_window_bits)
+        return false;
+    // A value without one in the offer,
+    // or larger than the offer, is invalid.
+    if(res.client_max_window_bits == -1 ||
+            res.client_max_window_bits >
+                o.client_max_window_bits)
+        return false;
+    return true;
+}
+
 // Normalize the server's response
 //
 inline
@@ -350,14 +379,17 @@ pmd_normalize(pmd_offer& offer)
 
 //--------------------------------------------------------------------
 
-// Decompress into a DynamicBuffer
+// Decompress into a DynamicBuffer, producing at most `limit`
+// bytes. On return `in` holds the input not yet consumed.
+// Returns: the number of bytes produced
 //
 template<class InflateStream, class DynamicBuffer>
-void
+std::size_t
 inflate(
     InflateStream& zi,
     DynamicBuffer& dynabuf,
-    boost::asio::const_buffer const& in,
+    boost::asio::const_buffer& in,
+    std::size_t limit,
     error_code& ec)
 {
     using boost::asio::buffer_cast;
@@ -365,16 +397,18 @@ inflate(
     zlib::z_params zs;
     zs.avail_in = buffer_size(in);
     zs.next_in = buffer_cast<void const*>(in);
-    for(;;)
+    std::size_t total = 0;
+    while(total < limit)
     {
         // VFALCO we could be smarter about the size
-        auto const bs = dynabuf.prepare(
-            read_size_helper(dynabuf, 65536));
+        auto const bs = dynabuf.prepare((std::min)(
+            read_size_helper(dynabuf, 65536), limit - total));
         auto const out = *bs.begin();
         zs.avail_out = buffer_size(out);
         zs.next_out = buffer_cast<void*>(out);
         zi.write(zs, zlib::Flush::sync, ec);
         dynabuf.commit(zs.total_out);
+        total += zs.total_out;
         zs.total_out = 0;
         if( ec == zlib::error::need_buffers ||
             ec == zlib::error::end_of_stream)
@@ -383,8 +417,11 @@ inflate(
             break;
         }
         if(ec)
-            return;
+            break;
     }
+    in = boost::asio::const_buffer{
+        zs.next_in, zs.avail_in};
+    return total;
 }
 
 // Compress a buffer sequence
@@ -465,6 +502,44 @@ deflate(
     return true;
 }
 
+// Returns `false` if a sample from the start of the buffers
+// looks too random for deflate to make it smaller.
+//
+// The estimate is the order-0 entropy of the first kilobyte.
+// Text and markup measure 4 to 6 bits per byte, while data that
+// is already compressed or encrypted measures close to 8.
+//
+template<class ConstBufferSequence>
+bool
+pmd_compressible(ConstBufferSequence const& buffers)
+{
+    using boost::asio::buffer_cast;
+    using boost::asio::buffer_size;
+    std::size_t constexpr limit = 1024;
+    std::uint16_t count[256] = {};
+    std::size_t n = 0;
+    for(auto const& b : buffers)
+    {
+        auto const p = buffer_cast<std::uint8_t const*>(b);
+        auto const m = (std::min)(
+            buffer_size(b), limit - n);
+        for(std::size_t i = 0; i < m; ++i)
+            ++count[p[i]];
+        n += m;
+        if(n == limit)
+            break;
+    }
+    // Too little to judge
+    if(n < 128)
+        return true;
+    double sum = 0;
+    for(auto const c : count)
+        if(c > 0)
+            sum += c * std::log2(c);
+    auto const bits = std::log2(n) - sum / n;
+    return bits < 7.5;
+}
+
 } // detail
 } // websocket
 } // beast
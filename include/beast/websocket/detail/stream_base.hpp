@@ -11,12 +11,16 @@
 #include <beast/websocket/error.hpp>
 #include <beast/websocket/option.hpp>
 #include <beast/websocket/rfc6455.hpp>
+#include <beast/websocket/detail/buffer_pool.hpp>
 #include <beast/websocket/detail/decorator.hpp>
 #include <beast/websocket/detail/frame.hpp>
 #include <beast/websocket/detail/invokable.hpp>
 #include <beast/websocket/detail/mask.hpp>
 #include <beast/websocket/detail/pmd_extension.hpp>
+#include <beast/websocket/detail/submit_queue.hpp>
 #include <beast/websocket/detail/utf8_checker.hpp>
+#include <beast/websocket/detail/zlib_pool.hpp>
+#include <beast/core/consuming_buffers.hpp>
 #include <beast/http/empty_body.hpp>
 #include <beast/http/message.hpp>
 #include <beast/http/string_body.hpp>
@@ -24,15 +28,20 @@
 #include <beast/zlib/inflate_stream.hpp>
 #include <boost/asio/error.hpp>
 #include <boost/assert.hpp>
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <limits>
 #include <memory>
+#include <vector>
 
 namespace beast {
 namespace websocket {
 namespace detail {
 
 /// Identifies the role of a WebSockets stream.
-enum class role_type
+enum class role_type : std::uint8_t
 {
     /// Stream is operating as a client.
     client,
@@ -50,20 +59,25 @@ protected:
 
     struct op {};
 
+    // Members are grouped by size to keep the stream small
+
     detail::maskgen maskgen_;               // source of mask keys
     decorator_type d_;                      // adorns http messages
-    bool keep_alive_ = false;               // close on failed upgrade
     std::size_t rd_msg_max_ =
         16 * 1024 * 1024;                   // max message size
-    bool wr_autofrag_ = true;               // auto fragment
     std::size_t wr_buf_size_ = 4096;        // write buffer size
     std::size_t rd_buf_size_ = 4096;        // read buffer size
-    opcode wr_opcode_ = opcode::text;       // outgoing message type
+    std::size_t rd_inflate_limit_ = 0;      // max inflated per read
+    std::size_t wq_limit_ =
+        1024 * 1024;                        // write queue limit
+    std::chrono::microseconds
+        wr_latency_{0};                     // control frame latency
+    std::chrono::milliseconds
+        idle_timeout_{0};                   // idle timeout
+    std::size_t wr_frag_size_ =
+        16 * 1024;                          // adaptive fragment size
     ping_cb ping_cb_;                       // ping callback
-    role_type role_;                        // server or client
-    bool failed_;                           // the connection failed
 
-    bool wr_close_;                         // sent close frame
     op* wr_block_;                          // op currenly writing
 
     ping_data* ping_data_;                  // where to put the payload
@@ -72,6 +86,15 @@ protected:
     invokable ping_op_;                     // ping parking
     close_reason cr_;                       // set from received close frame
 
+    bool keep_alive_ = false;               // close on failed upgrade
+    bool wr_autofrag_ = true;               // auto fragment
+    opcode wr_opcode_ = opcode::text;       // outgoing message type
+    compression wr_compress_ =
+        compression::automatic;             // next message compression
+    role_type role_;                        // server or client
+    bool failed_;                           // the connection failed
+    bool wr_close_;                         // sent close frame
+
     // State information for the message being received
     //
     struct rd_t
@@ -94,8 +117,43 @@ protected:
         // changed mid-send without affecting the current message.
         std::size_t buf_size;
 
-        // The read buffer. Used for compression and masking.
-        std::unique_ptr<std::uint8_t[]> buf;
+        // The read buffer. Used for decompression. It is borrowed
+        // from the pool at the beginning of a compressed message,
+        // and given back after the last frame.
+        pooled_buffer buf;
+
+        // The state of the compressed frame being received is kept
+        // here, so that it can be delivered over several reads.
+
+        // Payload bytes of the frame not yet received
+        std::uint64_t remain;
+
+        // Received input which is not yet inflated
+        boost::asio::const_buffer zin;
+
+        // Bytes inflated towards the current read
+        std::size_t zsize;
+
+        // The most bytes inflated by one read
+        std::size_t zlimit;
+
+        // Unmasks the frame payload
+        detail::prepared_key key;
+
+        // `true` if the frame payload is masked
+        bool mask;
+
+        // `true` if the frame is the last of its message
+        bool fin;
+
+        // `true` once the end-of-message block is inflated
+        bool ztail;
+
+        // `true` if the inflate stream may hold more output
+        bool zmore;
+
+        // `true` while a frame is partly delivered
+        bool zframe;
     };
 
     rd_t rd_;
@@ -108,6 +166,16 @@ protected:
         // `false` if next frame starts a new message
         bool cont;
 
+        // `true` if a compressed message has begun but its
+        // first frame is held back, because the deflate stream
+        // has not produced any output yet.
+        bool pending;
+
+        // `true` from the start of a message until its last frame
+        // is sent, while the write buffer and the deflate stream
+        // belong to it.
+        bool active;
+
         // `true` if this message should be auto-fragmented
         // This gets set to the auto-fragment option at the beginning
         // of sending a message, so that the option can be changed
@@ -120,6 +188,10 @@ protected:
         // mid-send without affecting the current message.
         bool compress;
 
+        // `true` if the client masks the caller's buffers in place,
+        // so this message needs no write buffer unless compressed.
+        bool inplace;
+
         // Size of the write buffer.
         // This gets set to the write buffer size option at the
         // beginning of sending a message, so that the option can be
@@ -127,9 +199,9 @@ protected:
         std::size_t buf_size;
 
         // The write buffer. Used for compression and masking.
-        // The buffer is allocated or reallocated at the beginning of
-        // sending a message.
-        std::unique_ptr<std::uint8_t[]> buf;
+        // The buffer is borrowed from the pool at the beginning of
+        // sending a message, and given back after the last frame.
+        pooled_buffer buf;
     };
 
     wr_t wr_;
@@ -140,8 +212,11 @@ protected:
         // `true` if current read message is compressed
         bool rd_set;
 
-        zlib::deflate_stream zo;
-        zlib::inflate_stream zi;
+        // These are created when first needed. Without context
+        // takeover they are borrowed from the thread's zlib_pool
+        // at the start of each message and given back at the end.
+        std::unique_ptr<zlib::deflate_stream> zo;
+        std::unique_ptr<zlib::inflate_stream> zi;
     };
 
     // If not engaged, then permessage-deflate is not
@@ -154,6 +229,61 @@ protected:
     // Offer for clients, negotiated result for servers
     pmd_offer pmd_config_;
 
+    // The outgoing message queue
+    //
+    struct wq_t : op
+    {
+        // A complete frame, which starts at `offset`
+        struct entry
+        {
+            std::vector<std::uint8_t> data;
+            std::size_t offset;
+            std::size_t credit = 0; // submitted bytes to release
+        };
+
+        // The largest number of frames in one write
+        static std::size_t constexpr max_batch = 64;
+
+        std::deque<entry> q;
+        std::size_t size = 0;       // bytes in queued frames
+        std::size_t sending = 0;    // frames being written
+        bool active = false;        // the queue is being sent
+        error_code ec;              // why sending failed
+        std::vector<
+            boost::asio::const_buffer> bs;  // frames being written
+        invokable flush_op;         // flush parking
+    };
+
+    // Created when a message is first queued
+    std::unique_ptr<wq_t> wq_;
+
+    // Messages submitted from other threads
+    submit_queue sq_;
+
+    // State information for the idle timeout
+    //
+    struct idle_t : op
+    {
+        // `true` while the timer is running
+        bool active = false;
+
+        // `true` if bytes arrived since the last check
+        bool rx = false;
+
+        // `true` if a ping was sent during this silence
+        bool pinged = false;
+
+        // `true` while the keepalive ping waits in ping_op_
+        bool parked = false;
+
+        // The keepalive ping frame, which is written
+        // from here so that sending it needs no storage.
+        std::uint8_t fb[6];
+        std::uint8_t fb_size = 0;
+    };
+
+    idle_t idle_;
+
     stream_base(stream_base&&) = default;
     stream_base(stream_base const&) = delete;
     stream_base& operator=(stream_base&&) = default;
@@ -182,16 +312,124 @@ protected:
     read_fh2(detail::frame_header& fh,
         DynamicBuffer& db, close_code::value& code);
 
+    // `true` if the peer discards its compression
+    // state after each message it sends.
+    bool
+    pmd_rd_no_context_takeover() const
+    {
+        return role_ == role_type::client ?
+            pmd_config_.server_no_context_takeover :
+            pmd_config_.client_no_context_takeover;
+    }
+
+    // `true` if we discard our compression
+    // state after each message we send.
+    bool
+    pmd_wr_no_context_takeover() const
+    {
+        return role_ == role_type::client ?
+            pmd_config_.client_no_context_takeover :
+            pmd_config_.server_no_context_takeover;
+    }
+
+    // The window size of messages we receive
+    int
+    pmd_rd_window_bits() const
+    {
+        return role_ == role_type::client ?
+            pmd_config_.server_max_window_bits :
+            pmd_config_.client_max_window_bits;
+    }
+
+    // The window size of messages we send
+    int
+    pmd_wr_window_bits() const
+    {
+        return role_ == role_type::client ?
+            pmd_config_.client_max_window_bits :
+            pmd_config_.server_max_window_bits;
+    }
+
+    // `true` if compressed messages received by `src`
+    // can be sent by this stream without inflating them.
+    // The peer of this stream must accept the window used
+    // by the peer of `src`, and must not rely on context
+    // takeover unless that peer provides it.
+    bool
+    pmd_relay(stream_base const& src) const
+    {
+        return pmd_ && src.pmd_ &&
+            wr_compress_ != compression::never &&
+            src.pmd_rd_window_bits() <= pmd_wr_window_bits() &&
+            (src.pmd_rd_no_context_takeover() ||
+                ! pmd_wr_no_context_takeover());
+    }
+
+    // Returns the largest payload for the next
+    // fragment of an asynchronously sent message.
+    std::size_t
+    wr_frag_size() const
+    {
+        if(wr_latency_.count() == 0)
+            return wr_.buf_size;
+        // Masked payloads are copied to the write buffer
+        if(role_ == role_type::client && ! wr_.inplace)
+            return (std::min)(wr_frag_size_, wr_.buf_size);
+        return wr_frag_size_;
+    }
+
+    // Called after sending a fragment, to fit
+    // the fragment size to the control frame latency
+    template<class = void>
+    void
+    wr_adapt(std::size_t n,
+        std::chrono::steady_clock::duration elapsed);
+
     // Called before receiving the first frame of each message
     template<class = void>
     void
     rd_begin();
 
+    // Called after receiving the last frame of each message
+    template<class = void>
+    void
+    rd_done();
+
+    // Called before receiving the payload of a compressed frame
+    template<class = void>
+    void
+    rd_zbegin(frame_header const& fh);
+
+    // Called after receiving compressed payload into the read buffer
+    template<class = void>
+    void
+    rd_zinput(std::size_t bytes_transferred);
+
+    // Inflates received payload, returns `true` when
+    // some of the message is ready for the caller
+    template<class DynamicBuffer>
+    bool
+    rd_inflate(DynamicBuffer& dynabuf,
+        close_code::value& code, error_code& ec);
+
     // Called before sending the first frame of each message
     //
+    template<class ConstBufferSequence>
+    void
+    wr_begin(ConstBufferSequence const& buffers,
+        bool fin, bool inplace = false);
+
+    // Called after sending the last frame of each message
     template<class = void>
     void
-    wr_begin();
+    wr_done();
+
+    // Called before sending a frame relayed from another
+    // stream, returns `true` if the payload needs masking.
+    template<class = void>
+    bool
+    wr_relay(frame_header const& fh,
+        frame_header& wfh, prepared_key& key);
 
     template<class DynamicBuffer>
     void
@@ -211,39 +449,37 @@ open(role_type role)
     role_ = role;
     failed_ = false;
     rd_.cont = false;
+    rd_.zframe = false;
     wr_close_ = false;
     wr_block_ = nullptr;    // should be nullptr on close anyway
     ping_data_ = nullptr;   // should be nullptr on close anyway
 
     wr_.cont = false;
+    wr_.pending = false;
+    wr_.active = false;
+    wr_.inplace = false;
     wr_.buf_size = 0;
 
+    // Discard frames left from an earlier session
+    BOOST_ASSERT(! wq_ || ! wq_->active);
+    wq_.reset();
+    sq_.closed = false;
+
     if(((role_ == role_type::client && pmd_opts_.client_enable) ||
         (role_ == role_type::server && pmd_opts_.server_enable)) &&
             pmd_config_.accept)
     {
         pmd_normalize(pmd_config_);
-        pmd_.reset(new pmd_t);
+        // A server which leaves out client_max_window_bits
+        // lets the client use any window, so the one in the
+        // local options is used. The server's window was
+        // checked against the offer in the handshake.
         if(role_ == role_type::client)
-        {
-            pmd_->zi.reset(
-                pmd_config_.server_max_window_bits);
-            pmd_->zo.reset(
-                pmd_opts_.compLevel,
+            pmd_config_.client_max_window_bits = (std::min)(
                 pmd_config_.client_max_window_bits,
-                pmd_opts_.memLevel,
-                zlib::Strategy::normal);
-        }
-        else
-        {
-            pmd_->zi.reset(
-                pmd_config_.client_max_window_bits);
-            pmd_->zo.reset(
-                pmd_opts_.compLevel,
-                pmd_config_.server_max_window_bits,
-                pmd_opts_.memLevel,
-                zlib::Strategy::normal);
-        }
+                    pmd_opts_.client_max_window_bits);
+        // The zlib streams are created on first use
+        pmd_.reset(new pmd_t);
     }
 }
 
@@ -447,13 +683,24 @@ void
 stream_base::
 rd_begin()
 {
-    // Maintain the read buffer
-    if(pmd_)
+    if(pmd_ && pmd_->rd_set)
     {
+        // Maintain the read buffer
         if(! rd_.buf || rd_.buf_size != rd_buf_size_)
         {
             rd_.buf_size = rd_buf_size_;
-            rd_.buf.reset(new std::uint8_t[rd_.buf_size]);
+            rd_.buf = make_pooled_buffer(rd_.buf_size);
+        }
+
+        // Create or borrow the inflate stream
+        if(! pmd_->zi)
+        {
+            if(pmd_rd_no_context_takeover())
+                pmd_->zi = zlib_pool<
+                    zlib::inflate_stream>::instance().get();
+            else
+                pmd_->zi.reset(new zlib::inflate_stream);
+            pmd_->zi->reset(pmd_rd_window_bits());
         }
     }
 }
@@ -461,19 +708,201 @@ rd_begin()
 template<class>
 void
 stream_base::
-wr_begin()
+rd_done()
+{
+    // Give the buffer back until the next message
+    rd_.buf.reset();
+    if(pmd_ && pmd_->zi && pmd_rd_no_context_takeover())
+        zlib_pool<zlib::inflate_stream>::instance().put(
+            std::move(pmd_->zi));
+}
+
+template<class>
+void
+stream_base::
+rd_zbegin(frame_header const& fh)
+{
+    rd_.remain = fh.len;
+    rd_.zin = {};
+    rd_.mask = fh.mask;
+    if(fh.mask)
+        prepare_key(rd_.key, fh.key);
+    rd_.fin = fh.fin;
+    rd_.ztail = false;
+    rd_.zmore = false;
+    rd_.zframe = true;
+    rd_.zsize = 0;
+    rd_.zlimit = rd_inflate_limit_ > 0 ?
+        rd_inflate_limit_ : (std::numeric_limits<
+            std::size_t>::max)();
+}
+
+template<class>
+void
+stream_base::
+rd_zinput(std::size_t bytes_transferred)
+{
+    auto const in = boost::asio::buffer(
+        rd_.buf.get(), bytes_transferred);
+    if(rd_.mask)
+        mask_inplace(in, rd_.key);
+    rd_.remain -= bytes_transferred;
+    rd_.zin = in;
+}
+
+/*  Inflate the received payload of the current frame.
+
+    At most `rd_.zlimit` bytes are produced per read, and
+    decompressed bytes count towards the message size limit. This
+    returns `false` when the frame needs more payload, or upon
+    error. Otherwise `rd_.zframe` is cleared once the whole frame
+    has been delivered.
+*/
+template<class DynamicBuffer>
+bool
+stream_base::
+rd_inflate(DynamicBuffer& dynabuf,
+    close_code::value& code, error_code& ec)
+{
+    using boost::asio::buffer;
+    using boost::asio::buffer_size;
+    auto const limit = rd_.zlimit;
+    for(;;)
+    {
+        if(buffer_size(rd_.zin) == 0 && ! rd_.zmore)
+        {
+            // inflate even if fh.len == 0, otherwise we
+            // never emit the end-of-stream deflate block.
+            if(rd_.remain > 0)
+                return false;
+            if(! rd_.fin || rd_.ztail)
+                break;
+            static std::uint8_t constexpr
+                empty_block[4] = {
+                    0x00, 0x00, 0xff, 0xff };
+            rd_.zin = buffer(&empty_block[0], 4);
+            rd_.ztail = true;
+        }
+        auto n = limit - rd_.zsize;
+        if(rd_msg_max_)
+        {
+            // Allow one byte past the limit, to detect it
+            auto const room = rd_.size < rd_msg_max_ ?
+                rd_msg_max_ - rd_.size : 0;
+            if(room < n)
+                n = static_cast<std::size_t>(room + 1);
+        }
+        auto const prev = dynabuf.size();
+        auto const avail = buffer_size(rd_.zin);
+        auto const bytes = detail::inflate(
+            *pmd_->zi, dynabuf, rd_.zin, n, ec);
+        failed_ = ec != 0;
+        if(failed_)
+            return false;
+        if(bytes == 0 && buffer_size(rd_.zin) == avail)
+            // The inflate stream has ended
+            rd_.zin = {};
+        rd_.zmore = bytes == n;
+        rd_.size += bytes;
+        if(rd_msg_max_ && rd_.size > rd_msg_max_)
+        {
+            code = close_code::too_big;
+            return false;
+        }
+        if(rd_.op == opcode::text)
+        {
+            consuming_buffers<typename
+                DynamicBuffer::const_buffers_type
+                    > cb{dynabuf.data()};
+            cb.consume(prev);
+            if(! rd_.utf8.write(cb))
+            {
+                code = close_code::bad_payload;
+                return false;
+            }
+        }
+        rd_.zsize += bytes;
+        if(rd_.zsize == limit)
+        {
+            rd_.zsize = 0;
+            return true;
+        }
+    }
+    if(rd_.fin)
+    {
+        if(rd_.op == opcode::text &&
+            ! rd_.utf8.finish())
+        {
+            code = close_code::bad_payload;
+            return false;
+        }
+        rd_done();
+    }
+    rd_.zframe = false;
+    rd_.zsize = 0;
+    return true;
+}
+
+template<class ConstBufferSequence>
+void
+stream_base::
+wr_begin(ConstBufferSequence const& buffers,
+    bool fin, bool inplace)
 {
-    wr_.autofrag = wr_autofrag_;
-    wr_.compress = static_cast<bool>(pmd_);
+    wr_.active = true;
+
+    // A latency bound requires fragments
+    wr_.autofrag = wr_autofrag_ ||
+        wr_latency_.count() > 0;
+
+    // Decide if this message is compressed. A window of
+    // 8 bits can be negotiated, but ZLib's deflate can't
+    // produce one, so those messages are sent as they are.
+    switch(wr_compress_)
+    {
+    case compression::always:
+        wr_.compress = pmd_ && pmd_wr_window_bits() > 8;
+        break;
+
+    case compression::never:
+        wr_.compress = false;
+        break;
+
+    default:
+        wr_.compress = pmd_ && pmd_wr_window_bits() > 8 && ! (fin &&
+            boost::asio::buffer_size(buffers) <
+                pmd_opts_.msg_size_threshold) && ! (
+            pmd_opts_.sample_entropy &&
+                ! pmd_compressible(buffers));
+        break;
+    }
+    wr_compress_ = compression::automatic;
+
+    // Create or borrow the deflate stream
+    if(wr_.compress && ! pmd_->zo)
+    {
+        if(pmd_wr_no_context_takeover())
+            pmd_->zo = zlib_pool<
+                zlib::deflate_stream>::instance().get();
+        else
+            pmd_->zo.reset(new zlib::deflate_stream);
+        pmd_->zo->reset(
+            pmd_opts_.compLevel,
+            pmd_wr_window_bits(),
+            pmd_opts_.memLevel,
+            zlib::Strategy::normal);
+    }
+
+    wr_.inplace = inplace && ! wr_.compress;
 
     // Maintain the write buffer
-    if( wr_.compress ||
-        role_ == detail::role_type::client)
+    if( wr_.compress || (
+        role_ == detail::role_type::client && ! wr_.inplace))
     {
         if(! wr_.buf || wr_.buf_size != wr_buf_size_)
         {
             wr_.buf_size = wr_buf_size_;
-            wr_.buf.reset(new std::uint8_t[wr_.buf_size]);
+            wr_.buf = make_pooled_buffer(wr_.buf_size);
         }
     }
     else
@@ -483,6 +912,72 @@ wr_begin()
     }
 }
 
+template<class>
+void
+stream_base::
+wr_done()
+{
+    wr_.active = false;
+
+    // Give the buffer back until the next message
+    wr_.buf.reset();
+    if(pmd_ && pmd_->zo && pmd_wr_no_context_takeover())
+        zlib_pool<zlib::deflate_stream>::instance().put(
+            std::move(pmd_->zo));
+}
+
+template<class>
+bool
+stream_base::
+wr_relay(frame_header const& fh,
+    frame_header& wfh, prepared_key& key)
+{
+    BOOST_ASSERT(wr_.cont == (fh.op == opcode::cont));
+    wfh.op = fh.op;
+    wfh.fin = fh.fin;
+    wfh.rsv1 = fh.rsv1;
+    wfh.rsv2 = false;
+    wfh.rsv3 = false;
+    wfh.len = fh.len;
+    wfh.mask = role_ == role_type::client;
+    // Removing the received mask and applying ours
+    // is the same as applying both keys at once.
+    std::uint32_t k = fh.mask ? fh.key : 0;
+    if(wfh.mask)
+    {
+        wfh.key = maskgen_();
+        k ^= wfh.key;
+    }
+    wr_.cont = ! fh.fin;
+    if(k == 0)
+        return false;
+    prepare_key(key, k);
+    return true;
+}
+
+template<class>
+void
+stream_base::
+wr_adapt(std::size_t n,
+    std::chrono::steady_clock::duration elapsed)
+{
+    std::size_t constexpr min_size = 512;
+    std::size_t constexpr max_size = 1024 * 1024;
+    // A pending control frame waits for at most one
+    // fragment, so size the next one to take no longer
+    // than the limit at the rate the last one was sent.
+    auto const t = std::chrono::duration_cast<
+        std::chrono::microseconds>(elapsed).count();
+    auto size = 2 * wr_frag_size_;
+    if(t > 0)
+        size = static_cast<std::size_t>((std::min)(
+            static_cast<std::uint64_t>(size),
+            static_cast<std::uint64_t>(n) *
+                wr_latency_.count() / t));
+    wr_frag_size_ = (std::max)(min_size,
+        (std::min)(size, max_size));
+}
+
 template<class DynamicBuffer>
 void
 stream_base::
@@ -0,0 +1,167 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_SUBMIT_QUEUE_HPP
+#define BEAST_WEBSOCKET_DETAIL_SUBMIT_QUEUE_HPP
+
+#include <boost/assert.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+/** A lock-free queue of messages from many threads to one.
+
+    Producers on any thread push messages with a single atomic
+    exchange loop, and the consumer takes every pushed message at
+    once with a single atomic exchange. Each message is one
+    allocation holding both the link and the payload.
+
+    The producer whose push finds the queue empty is told so, and
+    it alone arranges for the consumer to run. The consumer always
+    takes the whole queue, so a message is never left behind
+    without a pending consumer.
+*/
+class submit_queue
+{
+public:
+    /// A message, whose payload follows it in memory
+    struct node
+    {
+        node* next;
+        std::size_t size;
+
+        std::uint8_t*
+        data()
+        {
+            return reinterpret_cast<
+                std::uint8_t*>(this + 1);
+        }
+    };
+
+private:
+    std::atomic<node*> head_{nullptr};
+
+public:
+    /// Payload bytes submitted and not yet released
+    std::atomic<std::size_t> bytes{0};
+
+    /// Set by the consumer when no more messages are wanted
+    std::atomic<bool> closed{false};
+
+    submit_queue() = default;
+
+    /** Move constructor.
+
+        The source must be empty, as streams may not be moved
+        while operations are pending.
+    */
+    submit_queue(submit_queue&& other)
+    {
+        BOOST_ASSERT(other.head_.load() == nullptr);
+        closed.store(other.closed.load());
+    }
+
+    /// Move assignment, the source and destination must be empty
+    submit_queue&
+    operator=(submit_queue&& other)
+    {
+        BOOST_ASSERT(head_.load() == nullptr);
+        BOOST_ASSERT(other.head_.load() == nullptr);
+        closed.store(other.closed.load());
+        return *this;
+    }
+
+    ~submit_queue()
+    {
+        destroy_all(pop_all());
+    }
+
+    /// Allocate a message with room for `size` bytes of payload
+    static
+    node*
+    make(std::size_t size)
+    {
+        auto const n = ::new(::operator new(
+            sizeof(node) + size)) node;
+        n->next = nullptr;
+        n->size = size;
+        return n;
+    }
+
+    /// Free a message obtained from @ref make
+    static
+    void
+    destroy(node* n)
+    {
+        n->~node();
+        ::operator delete(n);
+    }
+
+    /// Free a list of messages
+    static
+    void
+    destroy_all(node* n)
+    {
+        while(n)
+        {
+            auto const next = n->next;
+            destroy(n);
+            n = next;
+        }
+    }
+
+    /** Push a message, from any thread.
+
+        @return `true` if the queue was empty.
+    */
+    bool
+    push(node* n)
+    {
+        auto h = head_.load(std::memory_order_relaxed);
+        do
+        {
+            n->next = h;
+        }
+        while(! head_.compare_exchange_weak(h, n,
+            std::memory_order_release,
+                std::memory_order_relaxed));
+        return h == nullptr;
+    }
+
+    /** Remove every message, from the consumer thread.
+
+        @return The messages in the order they were pushed,
+        linked by `next`, or `nullptr` if the queue is empty.
+    */
+    node*
+    pop_all()
+    {
+        auto n = head_.exchange(
+            nullptr, std::memory_order_acquire);
+        // The list is newest first
+        node* prev = nullptr;
+        while(n)
+        {
+            auto const next = n->next;
+            n->next = prev;
+            prev = n;
+            n = next;
+        }
+        return prev;
+    }
+};
+
+} // detail
+} // websocket
+} // beast
+
+#endif
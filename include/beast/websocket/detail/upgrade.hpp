@@ -0,0 +1,239 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_UPGRADE_HPP
+#define BEAST_WEBSOCKET_DETAIL_UPGRADE_HPP
+
+#include <beast/websocket/detail/hybi13.hpp>
+#include <beast/http/rfc7230.hpp>
+#include <beast/core/detail/ci_char_traits.hpp>
+#include <beast/version.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+#include <cstring>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+/*  Support for accepting a WebSocket upgrade without the HTTP parser.
+
+    Only the plainest form of a valid upgrade request is recognized
+    here. Anything else, including requests which would be rejected,
+    is left to the full parser so the response is the same either way.
+*/
+
+// Largest request header scanned without the HTTP parser
+static std::size_t constexpr upgrade_limit = 4096;
+
+// Largest response produced by make_upgrade_response
+static std::size_t constexpr upgrade_response_limit = 192;
+
+/** Return the size of a complete request header.
+
+    @return The number of characters up to and including the
+    blank line ending the header, or zero if it is incomplete.
+*/
+template<class = void>
+std::size_t
+find_upgrade_end(char const* p, std::size_t n)
+{
+    for(std::size_t i = 3; i < n; ++i)
+    {
+        if(p[i] == '\n' && p[i-1] == '\r' &&
+            p[i-2] == '\n' && p[i-3] == '\r')
+            return i + 1;
+    }
+    return 0;
+}
+
+inline
+bool
+is_upgrade_tchar(char c)
+{
+    /*
+        tchar = "!" | "#" | "$" | "%" | "&" |
+                "'" | "*" | "+" | "-" | "." |
+                "^" | "_" | "`" | "|" | "~" |
+                DIGIT | ALPHA
+    */
+    auto const u = static_cast<unsigned char>(c);
+    if((u >= '0' && u <= '9') ||
+        (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z'))
+        return true;
+    return c != 0 && std::strchr("!#$%&'*+-.^_`|~", c) != nullptr;
+}
+
+/** Scan a complete request header for a plain upgrade request.
+
+    The request must be "GET <target> HTTP/1.1" with a Host, an
+    Upgrade list containing "websocket", a Connection list containing
+    "upgrade", one Sec-WebSocket-Key and Sec-WebSocket-Version 13. A
+    message body, folded lines, repeated fields or, when `pmd` is set,
+    an extension offer cause the scan to fail.
+
+    @param s The header, including the terminating blank line.
+
+    @param pmd `true` if extension offers need negotiating.
+
+    @param key Set to the value of Sec-WebSocket-Key on success.
+
+    @return `true` if the request may be accepted with the fixed
+    response produced by @ref make_upgrade_response.
+*/
+template<class = void>
+bool
+parse_upgrade(boost::string_ref s,
+    bool pmd, boost::string_ref& key)
+{
+    using beast::detail::ci_equal;
+    auto const eol =
+        [&]
+        {
+            auto const n = s.find("\r\n");
+            if(n == boost::string_ref::npos)
+                return boost::string_ref{};
+            auto const line = s.substr(0, n);
+            s.remove_prefix(n + 2);
+            return line;
+        };
+    auto const trim =
+        [](boost::string_ref v)
+        {
+            while(! v.empty() &&
+                    (v.front() == ' ' || v.front() == '\t'))
+                v.remove_prefix(1);
+            while(! v.empty() &&
+                    (v.back() == ' ' || v.back() == '\t'))
+                v.remove_suffix(1);
+            return v;
+        };
+
+    // request-line
+    {
+        auto line = eol();
+        if(! line.starts_with("GET ") ||
+                ! line.ends_with(" HTTP/1.1"))
+            return false;
+        line = line.substr(4, line.size() - 13);
+        if(line.empty())
+            return false;
+        for(auto c : line)
+            if(static_cast<unsigned char>(c) <= ' ' || c == 127)
+                return false;
+    }
+
+    bool host = false;
+    bool upgrade = false;
+    bool connection = false;
+    bool version = false;
+    key.clear();
+    for(;;)
+    {
+        if(s.empty())
+            return false;
+        auto const line = eol();
+        if(line.empty())
+            break;
+        if(line.front() == ' ' || line.front() == '\t')
+            return false; // obs-fold
+        auto const colon = line.find(':');
+        if(colon == 0 || colon == boost::string_ref::npos)
+            return false;
+        auto const name = line.substr(0, colon);
+        for(auto c : name)
+            if(! is_upgrade_tchar(c))
+                return false;
+        auto const value = trim(line.substr(colon + 1));
+        for(auto c : value)
+            if(static_cast<unsigned char>(c) < ' ' && c != '\t')
+                return false;
+        if(ci_equal(name, "Host"))
+        {
+            if(host)
+                return false;
+            host = true;
+        }
+        else if(ci_equal(name, "Upgrade"))
+        {
+            if(upgrade || ! http::token_list{
+                    value}.exists("websocket"))
+                return false;
+            upgrade = true;
+        }
+        else if(ci_equal(name, "Connection"))
+        {
+            if(connection || ! http::token_list{
+                    value}.exists("upgrade"))
+                return false;
+            connection = true;
+        }
+        else if(ci_equal(name, "Sec-WebSocket-Key"))
+        {
+            if(! key.empty() || value.empty())
+                return false;
+            key = value;
+        }
+        else if(ci_equal(name, "Sec-WebSocket-Version"))
+        {
+            if(version || value != "13")
+                return false;
+            version = true;
+        }
+        else if(ci_equal(name, "Content-Length") ||
+            ci_equal(name, "Transfer-Encoding"))
+        {
+            return false;
+        }
+        else if(pmd && ci_equal(name, "Sec-WebSocket-Extensions"))
+        {
+            return false;
+        }
+    }
+    return host && upgrade && connection &&
+        version && ! key.empty();
+}
+
+/** Write the response accepting a plain upgrade request.
+
+    The response is the one produced for the request with the
+    default decorator and no negotiated extensions. At most
+    `upgrade_response_limit` characters are written to `dest`.
+
+    @return The number of characters written.
+*/
+template<class = void>
+std::size_t
+make_upgrade_response(char* dest, boost::string_ref const& key)
+{
+    static char const head[] =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Sec-WebSocket-Accept: ";
+    static char const tail[] =
+        "\r\n"
+        "Server: Beast/" BEAST_VERSION_STRING "\r\n"
+        "Connection: upgrade\r\n"
+        "\r\n";
+    static_assert(sizeof(head) - 1 + sec_ws_accept_size +
+        sizeof(tail) - 1 <= upgrade_response_limit,
+            "upgrade_response_limit too small");
+    auto p = dest;
+    std::memcpy(p, head, sizeof(head) - 1);
+    p += sizeof(head) - 1;
+    make_sec_ws_accept(p, key);
+    p += sec_ws_accept_size;
+    std::memcpy(p, tail, sizeof(tail) - 1);
+    p += sizeof(tail) - 1;
+    return static_cast<std::size_t>(p - dest);
+}
+
+} // detail
+} // websocket
+} // beast
+
+#endif
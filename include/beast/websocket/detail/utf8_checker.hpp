@@ -11,6 +11,7 @@
 #include <boost/asio/buffer.hpp>
 #include <boost/assert.hpp>
 #include <beast/core/buffer_concepts.hpp>
+#include <beast/core/detail/cpu_info.hpp>
 #include <algorithm>
 #include <cstdint>
 
@@ -63,6 +64,272 @@ namespace detail {
     3. This notice may not be removed or altered from any source distribution.
 */
 
+#if BEAST_SIMD_X86
+
+/*  Vectorized validation, after the lookup algorithm in
+
+        Validating UTF-8 In Less Than One Instruction Per Byte
+        John Keiser, Daniel Lemire, 2020
+        https://arxiv.org/abs/2010.03090
+
+    Each byte is classified together with the byte before it using
+    three table lookups on nibbles, which produces a bit for every
+    kind of error that can be detected from a pair of bytes. The
+    remaining error, a missing or extra second or third continuation
+    byte, is found by comparing the bytes two and three positions
+    back. The kernels check every sequence which lies entirely in the
+    range they are given, and check nothing about a sequence cut off
+    by the end of the range, which the caller passes to the scalar
+    code instead.
+*/
+
+// Bits in the result of the lookups
+enum : std::uint8_t
+{
+    utf8_too_short      = 1 << 0,   // 11______ 0_______
+                                    // 11______ 11______
+    utf8_too_long       = 1 << 1,   // 0_______ 10______
+    utf8_overlong_3     = 1 << 2,   // 11100000 100_____
+    utf8_too_large      = 1 << 3,   // 11110100 1001____
+                                    // 11110100 101_____
+                                    // 11110101 1001____
+                                    // 11110101 101_____
+                                    // 1111011_ 1001____
+                                    // 1111011_ 101_____
+                                    // 11111___ 1001____
+                                    // 11111___ 101_____
+    utf8_surrogate      = 1 << 4,   // 11101101 101_____
+    utf8_overlong_2     = 1 << 5,   // 1100000_ 10______
+    utf8_too_large_1000 = 1 << 6,   // 11110101 1000____
+                                    // 1111011_ 1000____
+                                    // 11111___ 1000____
+    utf8_overlong_4     = 1 << 6,   // 11110000 1000____
+    utf8_two_conts      = 1 << 7,   // 10______ 10______
+    utf8_carry          = utf8_too_short | utf8_too_long | utf8_two_conts
+};
+
+#define BEAST_UTF8_BYTE_1_HIGH \
+    utf8_too_long, utf8_too_long, utf8_too_long, utf8_too_long, \
+    utf8_too_long, utf8_too_long, utf8_too_long, utf8_too_long, \
+    utf8_two_conts, utf8_two_conts, utf8_two_conts, utf8_two_conts, \
+    utf8_too_short | utf8_overlong_2, \
+    utf8_too_short, \
+    utf8_too_short | utf8_overlong_3 | utf8_surrogate, \
+    utf8_too_short | utf8_too_large | utf8_too_large_1000 | utf8_overlong_4
+
+#define BEAST_UTF8_BYTE_1_LOW \
+    utf8_carry | utf8_overlong_3 | utf8_overlong_2 | utf8_overlong_4, \
+    utf8_carry | utf8_overlong_2, \
+    utf8_carry, \
+    utf8_carry, \
+    utf8_carry | utf8_too_large, \
+    utf8_carry | utf8_too_large | utf8_too_large_1000, \
+    utf8_carry | utf8_too_large | utf8_too_large_1000, \
+    utf8_carry | utf8_too_large | utf8_too_large_1000, \
+    utf8_carry | utf8_too_large | utf8_too_large_1000, \
+    utf8_carry | utf8_too_large | utf8_too_large_1000, \
+    utf8_carry | utf8_too_large | utf8_too_large_1000, \
+    utf8_carry | utf8_too_large | utf8_too_large_1000, \
+    utf8_carry | utf8_too_large | utf8_too_large_1000, \
+    utf8_carry | utf8_too_large | utf8_too_large_1000 | utf8_surrogate, \
+    utf8_carry | utf8_too_large | utf8_too_large_1000, \
+    utf8_carry | utf8_too_large | utf8_too_large_1000
+
+#define BEAST_UTF8_BYTE_2_HIGH \
+    utf8_too_short, utf8_too_short, utf8_too_short, utf8_too_short, \
+    utf8_too_short, utf8_too_short, utf8_too_short, utf8_too_short, \
+    utf8_too_long | utf8_overlong_2 | utf8_two_conts | \
+        utf8_overlong_3 | utf8_too_large_1000 | utf8_overlong_4, \
+    utf8_too_long | utf8_overlong_2 | utf8_two_conts | \
+        utf8_overlong_3 | utf8_too_large, \
+    utf8_too_long | utf8_overlong_2 | utf8_two_conts | \
+        utf8_surrogate | utf8_too_large, \
+    utf8_too_long | utf8_overlong_2 | utf8_two_conts | \
+        utf8_surrogate | utf8_too_large, \
+    utf8_too_short, utf8_too_short, utf8_too_short, utf8_too_short
+
+// Lead bytes which need more bytes than remain in the block
+#define BEAST_UTF8_INCOMPLETE \
+    255, 255, 255, 255, 255, 255, 255, 255, \
+    255, 255, 255, 255, 255, 0xf0 - 1, 0xe0 - 1, 0xc0 - 1
+
+// Buffers smaller than this are checked without vector instructions
+static std::size_t constexpr utf8_simd_threshold = 64;
+
+/*  Returns the length of the prefix of a checked range which
+    holds only complete sequences, given that it starts on a
+    sequence boundary.
+*/
+inline
+std::size_t
+utf8_simd_extent(std::uint8_t const* in, std::size_t m)
+{
+    for(std::size_t k = 1; k <= 3 && k <= m; ++k)
+    {
+        auto const c = in[m - k];
+        if(c < 0x80)
+            break;
+        if(c >= 0xc0)
+        {
+            std::size_t const need =
+                c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : 2;
+            if(need > k)
+                return m - k;
+            break;
+        }
+    }
+    return m;
+}
+
+// SSSE3 optimized
+//
+template<class = void>
+BEAST_TARGET("ssse3")
+bool
+utf8_check_ssse3(std::uint8_t const* in, std::size_t size)
+{
+    static std::uint8_t const tables[4][16] = {
+        { BEAST_UTF8_BYTE_1_HIGH },
+        { BEAST_UTF8_BYTE_1_LOW },
+        { BEAST_UTF8_BYTE_2_HIGH },
+        { BEAST_UTF8_INCOMPLETE } };
+    auto const t1h = _mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(tables[0]));
+    auto const t1l = _mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(tables[1]));
+    auto const t2h = _mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(tables[2]));
+    auto const incomplete = _mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(tables[3]));
+    auto const nibble = _mm_set1_epi8(0x0f);
+    auto const third = _mm_set1_epi8(0xe0 - 0x80);
+    auto const fourth = _mm_set1_epi8(0xf0 - 0x80);
+    auto const zero = _mm_setzero_si128();
+    auto error = zero;
+    auto prev_in = zero;
+    auto prev_incomplete = zero;
+    for(auto const end = in + (size & ~std::size_t{15});
+        in != end; in += 16)
+    {
+        auto const v = _mm_loadu_si128(
+            reinterpret_cast<__m128i const*>(in));
+        if(_mm_movemask_epi8(v) == 0)
+        {
+            // An ASCII block may only follow a complete sequence
+            error = _mm_or_si128(error, prev_incomplete);
+            prev_in = v;
+            prev_incomplete = zero;
+            continue;
+        }
+        auto const prev1 = _mm_alignr_epi8(v, prev_in, 15);
+        auto const sc = _mm_and_si128(_mm_and_si128(
+            _mm_shuffle_epi8(t1h, _mm_and_si128(
+                _mm_srli_epi16(prev1, 4), nibble)),
+            _mm_shuffle_epi8(t1l, _mm_and_si128(prev1, nibble))),
+            _mm_shuffle_epi8(t2h, _mm_and_si128(
+                _mm_srli_epi16(v, 4), nibble)));
+        auto const prev2 = _mm_alignr_epi8(v, prev_in, 14);
+        auto const prev3 = _mm_alignr_epi8(v, prev_in, 13);
+        auto const must23 = _mm_and_si128(_mm_or_si128(
+            _mm_subs_epu8(prev2, third),
+            _mm_subs_epu8(prev3, fourth)),
+                _mm_set1_epi8(-128));
+        error = _mm_or_si128(error, _mm_xor_si128(must23, sc));
+        prev_in = v;
+        prev_incomplete = _mm_subs_epu8(v, incomplete);
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) == 0xffff;
+}
+
+// AVX2 optimized
+//
+template<class = void>
+BEAST_TARGET("avx2")
+bool
+utf8_check_avx2(std::uint8_t const* in, std::size_t size)
+{
+    static std::uint8_t const tables[4][16] = {
+        { BEAST_UTF8_BYTE_1_HIGH },
+        { BEAST_UTF8_BYTE_1_LOW },
+        { BEAST_UTF8_BYTE_2_HIGH },
+        { BEAST_UTF8_INCOMPLETE } };
+    // The shuffles work within each 128-bit lane
+    auto const t1h = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(tables[0])));
+    auto const t1l = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(tables[1])));
+    auto const t2h = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(tables[2])));
+    // Only the last three bytes of the high lane matter
+    auto const incomplete = _mm256_inserti128_si256(
+        _mm256_set1_epi8(-1), _mm_loadu_si128(
+            reinterpret_cast<__m128i const*>(tables[3])), 1);
+    auto const nibble = _mm256_set1_epi8(0x0f);
+    auto const third = _mm256_set1_epi8(0xe0 - 0x80);
+    auto const fourth = _mm256_set1_epi8(0xf0 - 0x80);
+    auto const zero = _mm256_setzero_si256();
+    auto error = zero;
+    auto prev_in = zero;
+    auto prev_incomplete = zero;
+    for(auto const end = in + (size & ~std::size_t{31});
+        in != end; in += 32)
+    {
+        auto const v = _mm256_loadu_si256(
+            reinterpret_cast<__m256i const*>(in));
+        if(_mm256_movemask_epi8(v) == 0)
+        {
+            // An ASCII block may only follow a complete sequence
+            error = _mm256_or_si256(error, prev_incomplete);
+            prev_in = v;
+            prev_incomplete = zero;
+            continue;
+        }
+        // The high lane of the previous block, then the low lane of v
+        auto const x = _mm256_permute2x128_si256(prev_in, v, 0x21);
+        auto const prev1 = _mm256_alignr_epi8(v, x, 15);
+        auto const sc = _mm256_and_si256(_mm256_and_si256(
+            _mm256_shuffle_epi8(t1h, _mm256_and_si256(
+                _mm256_srli_epi16(prev1, 4), nibble)),
+            _mm256_shuffle_epi8(t1l, _mm256_and_si256(prev1, nibble))),
+            _mm256_shuffle_epi8(t2h, _mm256_and_si256(
+                _mm256_srli_epi16(v, 4), nibble)));
+        auto const prev2 = _mm256_alignr_epi8(v, x, 14);
+        auto const prev3 = _mm256_alignr_epi8(v, x, 13);
+        auto const must23 = _mm256_and_si256(_mm256_or_si256(
+            _mm256_subs_epu8(prev2, third),
+            _mm256_subs_epu8(prev3, fourth)),
+                _mm256_set1_epi8(-128));
+        error = _mm256_or_si256(error, _mm256_xor_si256(must23, sc));
+        prev_in = v;
+        prev_incomplete = _mm256_subs_epu8(v, incomplete);
+    }
+    return _mm256_testz_si256(error, error) != 0;
+}
+
+#undef BEAST_UTF8_BYTE_1_HIGH
+#undef BEAST_UTF8_BYTE_1_LOW
+#undef BEAST_UTF8_BYTE_2_HIGH
+#undef BEAST_UTF8_INCOMPLETE
+
+using utf8_check_function =
+    bool(*)(std::uint8_t const*, std::size_t);
+
+// Choose the widest kernel the processor supports
+//
+inline
+utf8_check_function
+select_utf8_check()
+{
+    auto const& cpu = beast::detail::get_cpu_info();
+    if(cpu.avx2)
+        return &utf8_check_avx2<>;
+    if(cpu.ssse3)
+        return &utf8_check_ssse3<>;
+    return nullptr;
+}
+
+#endif
+
 /** A UTF8 validator.
 
     This validator can be used to check if a buffer containing UTF8 text is
@@ -101,6 +368,13 @@ public:
     template<class ConstBufferSequence>
     bool
     write(ConstBufferSequence const& bs);
+
+    /** Check if text is valid UTF8, without vector instructions
+
+        @return `true` if the text is valid utf8 or false otherwise.
+    */
+    bool
+    write_scalar(std::uint8_t const* in, std::size_t size);
 };
 
 template<class _>
@@ -139,6 +413,39 @@ utf8_checker_t<_>::write(ConstBufferSequence const& bs)
 template<class _>
 bool
 utf8_checker_t<_>::write(std::uint8_t const* in, std::size_t size)
+{
+#if BEAST_SIMD_X86
+    if(size >= utf8_simd_threshold)
+    {
+        // Complete a sequence split by the previous call
+        if(need_ > 0)
+        {
+            auto const n = need_;
+            if(! write_scalar(in, n))
+                return false;
+            in += n;
+            size -= n;
+        }
+        static auto const f = select_utf8_check();
+        if(f)
+        {
+            auto const m = size & ~std::size_t{31};
+            if(! f(in, m))
+                return false;
+            // A sequence cut off at m is checked again below
+            auto const n = utf8_simd_extent(in, m);
+            in += n;
+            size -= n;
+        }
+    }
+#endif
+    return write_scalar(in, size);
+}
+
+template<class _>
+bool
+utf8_checker_t<_>::write_scalar(
+    std::uint8_t const* in, std::size_t size)
 {
     auto const valid =
         [](std::uint8_t const*& in)
@@ -150,7 +457,8 @@ utf8_checker_t<_>::write(std::uint8_t const* in, std::size_t size)
             }
             if ((in[0] & 0x60) == 0x40)
             {
-                if ((in[1] & 0xc0) != 0x80)
+                if (in[0] < 194 ||
+                    (in[1] & 0xc0) != 0x80)
                     return false;
                 in += 2;
                 return true;
@@ -241,8 +549,8 @@ utf8_checker_t<_>::write(std::uint8_t const* in, std::size_t size)
         p_ = have_;
     }
 
-    auto last = in + size - 7;
-    while(in < last)
+    // Compare distances, in may be null when size is zero
+    while(end - in > 7)
     {
 #if BEAST_WEBSOCKET_NO_UNALIGNED_READ
         auto constexpr align = sizeof(std::size_t) - 1;
@@ -269,8 +577,7 @@ utf8_checker_t<_>::write(std::uint8_t const* in, std::size_t size)
             return false;
 #endif
     }
-    last += 4;
-    while(in < last)
+    while(end - in > 3)
         if(! valid(in))
             return false;
 
@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_WORKER_POOL_HPP
+#define BEAST_WEBSOCKET_DETAIL_WORKER_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+/** A process-wide pool of threads for CPU-bound work.
+
+    Streams use this to compress large messages away from the
+    threads running the io_service, so that one big message does
+    not hold up every other connection served by the same thread.
+    Jobs are taken from a single shared queue in the order they
+    were posted. The threads are started when the pool is first
+    used, and joined when the program exits. Jobs still queued
+    when a pool is destroyed are not run.
+*/
+class worker_pool
+{
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> q_;
+    std::vector<std::thread> threads_;
+    bool stop_ = false;
+    bool at_exit_;
+
+public:
+    /// Returns the pool shared by the process
+    static
+    worker_pool&
+    instance()
+    {
+        static worker_pool pool{0, true};
+        return pool;
+    }
+
+    /** Construct the pool.
+
+        @param n The number of threads. If this is zero, one
+        fewer than the number of hardware threads is used, with
+        a minimum of one.
+
+        @param at_exit `true` if the pool is destroyed when the
+        program exits. Jobs still queued then are not destroyed
+        either, since the streams and io_services their handlers
+        belong to may already be gone.
+    */
+    explicit
+    worker_pool(std::size_t n = 0, bool at_exit = false)
+        : at_exit_(at_exit)
+    {
+        if(n == 0)
+        {
+            n = std::thread::hardware_concurrency();
+            n = n > 1 ? n - 1 : 1;
+        }
+        threads_.reserve(n);
+        for(std::size_t i = 0; i < n; ++i)
+            threads_.emplace_back(
+                [this]{ run(); });
+    }
+
+    /// Destructor, abandons queued jobs then joins the threads
+    ~worker_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for(auto& t : threads_)
+            t.join();
+        if(at_exit_ && ! q_.empty())
+            new std::deque<std::function<void()>>(std::move(q_));
+    }
+
+    /// Returns the number of threads
+    std::size_t
+    size() const
+    {
+        return threads_.size();
+    }
+
+    /** Queue a job to run on one of the threads.
+
+        The function is invoked with no arguments. It must not
+        throw, and should return promptly to the caller's
+        io_service any work that has to happen there.
+    */
+    template<class Function>
+    void
+    post(Function&& f)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            q_.emplace_back(std::forward<Function>(f));
+        }
+        cv_.notify_one();
+    }
+
+private:
+    void
+    run()
+    {
+        for(;;)
+        {
+            std::function<void()> f;
+            {
+                std::unique_lock<std::mutex> lock(m_);
+                cv_.wait(lock,
+                    [this]{ return stop_ || ! q_.empty(); });
+                if(stop_)
+                    return;
+                f = std::move(q_.front());
+                q_.pop_front();
+            }
+            f();
+        }
+    }
+};
+
+} // detail
+} // websocket
+} // beast
+
+#endif
@@ -0,0 +1,84 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_ZLIB_POOL_HPP
+#define BEAST_WEBSOCKET_DETAIL_ZLIB_POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+/** A per-thread cache of idle compression streams.
+
+    When context takeover is disabled the compression state is
+    discarded after every message, so there is no need for each
+    connection to own one. Streams borrow a deflate or inflate
+    stream from the pool of the calling thread for the duration of
+    one message, and give it back afterwards. The allocations made
+    by the zlib stream, such as its window, are kept with it and
+    reused when the next borrower has the same parameters.
+
+    @tparam ZStream The type of zlib stream to cache.
+*/
+template<class ZStream>
+class zlib_pool
+{
+    std::vector<std::unique_ptr<ZStream>> v_;
+
+public:
+    /// The largest number of idle streams kept by each thread
+    static std::size_t constexpr max_idle = 4;
+
+    /// Returns the pool for the calling thread
+    static
+    zlib_pool&
+    instance()
+    {
+        static thread_local zlib_pool pool;
+        return pool;
+    }
+
+    /// Returns the number of idle streams
+    std::size_t
+    size() const
+    {
+        return v_.size();
+    }
+
+    /** Borrow a stream.
+
+        The caller must reset the stream before using it.
+    */
+    std::unique_ptr<ZStream>
+    get()
+    {
+        if(v_.empty())
+            return std::unique_ptr<ZStream>(new ZStream);
+        auto p = std::move(v_.back());
+        v_.pop_back();
+        return p;
+    }
+
+    /// Give back a stream obtained from any thread's pool
+    void
+    put(std::unique_ptr<ZStream> p)
+    {
+        if(p && v_.size() < max_idle)
+            v_.emplace_back(std::move(p));
+    }
+};
+
+} // detail
+} // websocket
+} // beast
+
+#endif
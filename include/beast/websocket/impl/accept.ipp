@@ -8,6 +8,7 @@
 #ifndef BEAST_WEBSOCKET_IMPL_ACCEPT_IPP
 #define BEAST_WEBSOCKET_IMPL_ACCEPT_IPP
 
+#include <beast/websocket/detail/upgrade.hpp>
 #include <beast/http/message.hpp>
 #include <beast/http/parser_v1.hpp>
 #include <beast/http/read.hpp>
@@ -17,6 +18,8 @@
 #include <beast/core/handler_ptr.hpp>
 #include <beast/core/prepare_buffers.hpp>
 #include <beast/core/detail/type_traits.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/write.hpp>
 #include <boost/assert.hpp>
 #include <memory>
 #include <type_traits>
@@ -152,6 +155,8 @@ class stream<NextLayer>::accept_op
         bool cont;
         stream<NextLayer>& ws;
         http::request<http::string_body> req;
+        char res[detail::upgrade_response_limit];
+        std::size_t res_size;
         int state = 0;
 
         template<class Buffers>
@@ -231,7 +236,6 @@ stream<NextLayer>::accept_op<Handler>::
 operator()(error_code const& ec,
     std::size_t bytes_transferred, bool again)
 {
-    beast::detail::ignore_unused(bytes_transferred);
     auto& d = *d_;
     d.cont = d.cont || again;
     while(! ec && d.state != 99)
@@ -239,15 +243,61 @@ operator()(error_code const& ec,
         switch(d.state)
         {
         case 0:
-            // read message
+            // A decorated response needs the parsed request
+            d.state = d.ws.d_.is_default() ? 1 : 4;
+            break;
+
+        // scan buffered request
+        case 1:
+        {
+            bool fallback = false;
+            d.res_size = d.ws.accept_buffered(d.res, fallback);
+            if(fallback)
+            {
+                d.state = 4;
+                break;
+            }
+            if(d.res_size == 0)
+            {
+                // read more of the request
+                d.state = 2;
+                d.ws.next_layer().async_read_some(
+                    d.ws.stream_.buffer().prepare(
+                        detail::upgrade_limit -
+                            d.ws.stream_.buffer().size()),
+                                std::move(*this));
+                return;
+            }
+            // send fixed response
+            d.state = 3;
+            boost::asio::async_write(d.ws.next_layer(),
+                boost::asio::buffer(d.res, d.res_size),
+                    std::move(*this));
+            return;
+        }
+
+        case 2:
+            d.ws.stream_.buffer().commit(bytes_transferred);
             d.state = 1;
+            break;
+
+        // sent fixed response
+        case 3:
+            d.ws.pmd_config_.accept = false;
+            d.ws.open(detail::role_type::server);
+            d.state = 99;
+            break;
+
+        case 4:
+            // read message
+            d.state = 5;
             http::async_read(d.ws.next_layer(),
                 d.ws.stream_.buffer(), d.req,
                     std::move(*this));
             return;
 
         // got message
-        case 1:
+        case 5:
         {
             // respond to request
             auto& ws = d.ws;
@@ -372,6 +422,33 @@ accept(ConstBufferSequence const& buffers, error_code& ec)
     stream_.buffer().commit(buffer_copy(
         stream_.buffer().prepare(
             buffer_size(buffers)), buffers));
+    // A decorated response needs the parsed request
+    if(d_.is_default())
+    {
+        char res[detail::upgrade_response_limit];
+        for(;;)
+        {
+            bool fallback = false;
+            auto const n = accept_buffered(res, fallback);
+            if(fallback)
+                break;
+            if(n > 0)
+            {
+                boost::asio::write(stream_,
+                    boost::asio::buffer(res, n), ec);
+                if(ec)
+                    return;
+                pmd_config_.accept = false;
+                open(detail::role_type::server);
+                return;
+            }
+            stream_.buffer().commit(next_layer().read_some(
+                stream_.buffer().prepare(detail::upgrade_limit -
+                    stream_.buffer().size()), ec));
+            if(ec)
+                return;
+        }
+    }
     http::request<http::string_body> m;
     http::read(next_layer(), stream_.buffer(), m, ec);
     if(ec)
@@ -414,10 +491,48 @@ accept(http::request<Body, Fields> const& req,
         //             teardown if Connection: close.
         return;
     }
-    pmd_read(pmd_config_, req.fields);
+    // Use the negotiated settings, not the client's offer
+    pmd_read(pmd_config_, res.fields);
     open(detail::role_type::server);
 }
 
+/*  Accept a buffered upgrade request without the HTTP parser.
+
+    Returns the size of the response written to `res` after
+    consuming the request header, or zero if more of the header
+    is needed. `fallback` is set when the request must be read
+    with the parser instead.
+*/
+template<class NextLayer>
+std::size_t
+stream<NextLayer>::
+accept_buffered(char* res, bool& fallback)
+{
+    using boost::asio::buffer;
+    using boost::asio::buffer_copy;
+    auto& sb = stream_.buffer();
+    char buf[detail::upgrade_limit];
+    auto const size = buffer_copy(
+        buffer(buf, sizeof(buf)), sb.data());
+    auto const n = detail::find_upgrade_end(buf, size);
+    if(n == 0)
+    {
+        fallback = size >= sizeof(buf);
+        return 0;
+    }
+    boost::string_ref key;
+    if(! detail::parse_upgrade({buf, n},
+        pmd_opts_.server_enable, key))
+    {
+        fallback = true;
+        return 0;
+    }
+    auto const len =
+        detail::make_upgrade_response(res, key);
+    sb.consume(n);
+    return len;
+}
+
 //------------------------------------------------------------------------------
 
 } // websocket
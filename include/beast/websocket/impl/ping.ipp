@@ -131,6 +131,13 @@ operator()(error_code ec, bool again)
         case 0:
             if(d.ws.wr_block_)
             {
+                // A parked keepalive ping gives up its place
+                if(d.ws.idle_.parked)
+                {
+                    d.ws.idle_.parked = false;
+                    d.ws.idle_.pinged = false;
+                    d.ws.ping_op_.maybe_invoke();
+                }
                 // suspend
                 d.state = 2;
                 d.ws.ping_op_.template emplace<
@@ -188,8 +195,10 @@ operator()(error_code ec, bool again)
 upcall:
     if(d.ws.wr_block_ == &d)
         d.ws.wr_block_ = nullptr;
+    // A keepalive ping may have been parked behind this one
     d.ws.rd_op_.maybe_invoke() ||
-        d.ws.wr_op_.maybe_invoke();
+        d.ws.ping_op_.maybe_invoke() ||
+            d.ws.wr_op_.maybe_invoke();
     d_.invoke(ec);
 }
 
@@ -275,6 +284,202 @@ pong(ping_data const& payload, error_code& ec)
 
 //------------------------------------------------------------------------------
 
+// Watch for silence from the remote peer
+//
+// The op is the handler for the idle timer, and for the write of
+// the keepalive ping.
+//
+// No caller waits on these operations, so the stream may be
+// destroyed while they are pending. The op holds a weak reference
+// to the timer, which the stream owns, and touches nothing when
+// the timer is gone. The timer and the write complete through the
+// stream's strand.
+//
+template<class NextLayer>
+class stream<NextLayer>::idle_op
+{
+    stream<NextLayer>& ws_;
+    std::weak_ptr<idle_timer_type> alive_;
+
+public:
+    // Parked in place of a ping. The slot belongs to the
+    // stream, so this holds only a reference to it.
+    struct resume
+    {
+        stream<NextLayer>& ws;
+
+        void
+        operator()()
+        {
+            idle_op{ws}();
+        }
+    };
+
+    explicit
+    idle_op(stream<NextLayer>& ws)
+        : ws_(ws)
+        , alive_(ws.idle_timer_)
+    {
+    }
+
+    void operator()();
+
+    void operator()(error_code ec);
+
+    void operator()(error_code ec, std::size_t);
+};
+
+// Send the keepalive ping
+template<class NextLayer>
+void
+stream<NextLayer>::
+idle_op::
+operator()()
+{
+    auto& ws = ws_;
+    auto& idle = ws.idle_;
+    // A ping took our place while we were parked
+    if(! idle.parked)
+        return;
+    if(ws.wr_block_)
+    {
+        // suspend
+        ws.ping_op_.template emplace<
+            resume>(resume{ws});
+        return;
+    }
+    idle.parked = false;
+    if(! idle.active || ws.failed_ || ws.wr_close_)
+    {
+        ws.rd_op_.maybe_invoke() ||
+            ws.wr_op_.maybe_invoke();
+        return;
+    }
+    ws.wr_block_ = &idle;
+    boost::asio::async_write(ws.stream_,
+        boost::asio::buffer(idle.fb, idle.fb_size),
+            ws.strand_->wrap(std::move(*this)));
+}
+
+// The timer expired
+template<class NextLayer>
+void
+stream<NextLayer>::
+idle_op::
+operator()(error_code ec)
+{
+    // The stream may be gone if the wait was canceled
+    if(ec == boost::asio::error::operation_aborted)
+        return;
+    // An expiry was already queued when the stream was destroyed
+    if(alive_.expired())
+        return;
+    auto& ws = ws_;
+    auto& idle = ws.idle_;
+    if(! idle.active)
+        return;
+    if(ws.failed_)
+    {
+        idle.active = false;
+        return;
+    }
+    if(idle.rx)
+    {
+        idle.rx = false;
+        idle.pinged = false;
+    }
+    else if(! idle.pinged)
+    {
+        idle.pinged = true;
+        // Skip it if a ping is being sent or waits
+        if(ws.wr_block_ != &idle &&
+            ws.ping_op_.empty() && ! ws.wr_close_)
+        {
+            detail::fh_streambuf fb;
+            ws.template write_ping<static_streambuf>(
+                fb, opcode::ping, ping_data{});
+            idle.fb_size = static_cast<std::uint8_t>(
+                boost::asio::buffer_copy(boost::asio::buffer(
+                    idle.fb), fb.data()));
+            if(ws.wr_block_)
+            {
+                // suspend
+                idle.parked = true;
+                ws.ping_op_.template emplace<
+                    resume>(resume{ws});
+            }
+            else
+            {
+                ws.wr_block_ = &idle;
+                boost::asio::async_write(ws.stream_,
+                    boost::asio::buffer(idle.fb, idle.fb_size),
+                        ws.strand_->wrap(idle_op{ws}));
+            }
+        }
+    }
+    else
+    {
+        // Silent for the whole timeout. Closing
+        // the socket completes pending operations.
+        idle.active = false;
+        ws.failed_ = true;
+        ws.lowest_layer().close(ec);
+        return;
+    }
+    ws.idle_timer_->expires_from_now(ws.idle_timeout_ / 2);
+    ws.idle_timer_->async_wait(ws.strand_->wrap(idle_op{ws}));
+}
+
+// The keepalive ping was written
+template<class NextLayer>
+void
+stream<NextLayer>::
+idle_op::
+operator()(error_code ec, std::size_t)
+{
+    // The stream may be gone, even if the write succeeded
+    if(alive_.expired())
+        return;
+    auto& ws = ws_;
+    if(ec)
+        ws.failed_ = true;
+    if(ws.wr_block_ == &ws.idle_)
+        ws.wr_block_ = nullptr;
+    // A ping may have been parked behind this one
+    ws.rd_op_.maybe_invoke() ||
+        ws.ping_op_.maybe_invoke() ||
+            ws.wr_op_.maybe_invoke();
+}
+
+template<class NextLayer>
+void
+stream<NextLayer>::
+idle_start(std::true_type)
+{
+    if(! idle_timer_)
+        idle_timer_ = std::make_shared<
+            idle_timer_type>(get_io_service());
+    idle_.active = true;
+    idle_.rx = false;
+    idle_.pinged = false;
+    idle_timer_->expires_from_now(idle_timeout_ / 2);
+    idle_timer_->async_wait(strand_->wrap(idle_op{*this}));
+}
+
+template<class NextLayer>
+void
+stream<NextLayer>::
+idle_stop()
+{
+    if(! idle_.active)
+        return;
+    idle_.active = false;
+    error_code ec;
+    idle_timer_->cancel(ec);
+}
+
+//------------------------------------------------------------------------------
+
 } // websocket
 } // beast
 
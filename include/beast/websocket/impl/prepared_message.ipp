@@ -0,0 +1,164 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_IMPL_PREPARED_MESSAGE_IPP
+#define BEAST_WEBSOCKET_IMPL_PREPARED_MESSAGE_IPP
+
+#include <beast/core/buffer_concepts.hpp>
+#include <beast/core/consuming_buffers.hpp>
+#include <beast/core/error.hpp>
+#include <beast/core/static_streambuf.hpp>
+#include <beast/core/detail/type_traits.hpp>
+#include <beast/websocket/detail/frame.hpp>
+#include <beast/websocket/detail/pmd_extension.hpp>
+#include <beast/zlib/deflate_stream.hpp>
+#include <boost/assert.hpp>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace beast {
+namespace websocket {
+
+namespace detail {
+
+// Write an unmasked, unfragmented frame header
+inline
+std::uint8_t
+write_prepared_header(std::uint8_t (&out)[10],
+    opcode op, bool rsv1, std::size_t size)
+{
+    using boost::asio::buffer;
+    using boost::asio::buffer_copy;
+    frame_header fh;
+    fh.op = op;
+    fh.fin = true;
+    fh.mask = false;
+    fh.rsv1 = rsv1;
+    fh.rsv2 = false;
+    fh.rsv3 = false;
+    fh.len = size;
+    fh.key = 0;
+    fh_streambuf fh_buf;
+    write<static_streambuf>(fh_buf, fh);
+    return static_cast<std::uint8_t>(
+        buffer_copy(buffer(out), fh_buf.data()));
+}
+
+} // detail
+
+template<class ConstBufferSequence>
+prepared_message::
+prepared_message(opcode op,
+    ConstBufferSequence const& buffers)
+{
+    static_assert(beast::is_ConstBufferSequence<
+        ConstBufferSequence>::value,
+            "ConstBufferSequence requirements not met");
+    construct(op, buffers, nullptr);
+}
+
+template<class ConstBufferSequence>
+prepared_message::
+prepared_message(opcode op,
+    ConstBufferSequence const& buffers,
+        permessage_deflate const& pmd)
+{
+    static_assert(beast::is_ConstBufferSequence<
+        ConstBufferSequence>::value,
+            "ConstBufferSequence requirements not met");
+    construct(op, buffers,
+        pmd.server_enable ? &pmd : nullptr);
+}
+
+inline
+auto
+prepared_message::
+frame(bool deflated) const ->
+    const_buffers_type
+{
+    using boost::asio::const_buffer;
+    auto const& m = *impl_;
+    if(! deflated)
+        return {{
+            const_buffer{m.header, m.header_size},
+            const_buffer{m.data.get(), m.size}}};
+    BOOST_ASSERT(m.deflated_size != 0);
+    return {{
+        const_buffer{m.deflated_header,
+            m.deflated_header_size},
+        const_buffer{m.data.get() + m.size,
+            m.deflated_size}}};
+}
+
+template<class ConstBufferSequence>
+void
+prepared_message::
+construct(opcode op, ConstBufferSequence const& buffers,
+    permessage_deflate const* pmd)
+{
+    using boost::asio::buffer;
+    using boost::asio::buffer_copy;
+    using boost::asio::buffer_size;
+    if(op != opcode::binary && op != opcode::text)
+        throw beast::detail::make_exception<std::invalid_argument>(
+            "bad opcode", __FILE__, __LINE__);
+    std::unique_ptr<impl> p(new impl);
+    p->op = op;
+    p->window_bits = 0;
+    p->size = buffer_size(buffers);
+    p->deflated_size = 0;
+    p->header_size = detail::write_prepared_header(
+        p->header, op, false, p->size);
+    p->deflated_header_size = 0;
+
+    // Compress the payload once, with a fresh context
+    std::vector<std::uint8_t> out;
+    if(pmd && p->size > 0)
+    {
+        zlib::deflate_stream zo;
+        zo.reset(pmd->compLevel, pmd->server_max_window_bits,
+            pmd->memLevel, zlib::Strategy::normal);
+        consuming_buffers<ConstBufferSequence> cb{buffers};
+        std::size_t n = 0;
+        for(;;)
+        {
+            out.resize(n + 4096);
+            boost::asio::mutable_buffer b{&out[n], 4096};
+            error_code ec;
+            auto const more =
+                detail::deflate(zo, b, cb, true, ec);
+            if(ec)
+                throw system_error{ec};
+            n += buffer_size(b);
+            if(! more)
+                break;
+        }
+        // Keep it only if it saves space
+        if(n < p->size)
+        {
+            p->window_bits = pmd->server_max_window_bits;
+            p->deflated_size = n;
+            p->deflated_header_size =
+                detail::write_prepared_header(
+                    p->deflated_header, op, true, n);
+        }
+    }
+
+    p->data.reset(new std::uint8_t[
+        p->size + p->deflated_size]);
+    buffer_copy(buffer(p->data.get(), p->size), buffers);
+    if(p->deflated_size > 0)
+        std::memcpy(p->data.get() + p->size,
+            out.data(), p->deflated_size);
+    impl_ = std::move(p);
+}
+
+} // websocket
+} // beast
+
+#endif
@@ -0,0 +1,517 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_IMPL_QUEUE_IPP
+#define BEAST_WEBSOCKET_IMPL_QUEUE_IPP
+
+#include <beast/core/bind_handler.hpp>
+#include <beast/core/buffer_concepts.hpp>
+#include <beast/core/consuming_buffers.hpp>
+#include <beast/core/handler_helpers.hpp>
+#include <beast/core/handler_ptr.hpp>
+#include <beast/core/static_streambuf.hpp>
+#include <beast/core/stream_concepts.hpp>
+#include <beast/websocket/detail/frame.hpp>
+#include <boost/assert.hpp>
+#include <atomic>
+#include <memory>
+
+namespace beast {
+namespace websocket {
+
+//------------------------------------------------------------------------------
+
+// Send the outgoing message queue
+//
+// The op has no handler of its own. Its state lives in the stream,
+// so that it is small enough to be parked while a control frame is
+// written. Each write gathers every frame queued so far, up to a
+// limit, and frames queued meanwhile go out with the next write.
+//
+// Without a handler, nothing ties the op to the program's strand,
+// so it is posted to the stream's strand, and its writes complete
+// there.
+//
+template<class NextLayer>
+class stream<NextLayer>::queue_op
+{
+    stream<NextLayer>& ws_;
+
+public:
+    explicit
+    queue_op(stream<NextLayer>& ws)
+        : ws_(ws)
+    {
+    }
+
+    void operator()();
+
+    void operator()(error_code ec, std::size_t);
+
+private:
+    void fail(error_code const& ec);
+};
+
+template<class NextLayer>
+void
+stream<NextLayer>::
+queue_op::
+operator()()
+{
+    auto& ws = ws_;
+    auto& wq = *ws.wq_;
+    BOOST_ASSERT(wq.active);
+    if(ws.wr_block_)
+    {
+        // suspend
+        ws.wr_op_.template emplace<
+            queue_op>(std::move(*this));
+        return;
+    }
+    if(ws.failed_ || ws.wr_close_)
+        return fail(boost::asio::error::operation_aborted);
+    ws.wr_block_ = &wq;
+    wq.bs.clear();
+    for(auto const& e : wq.q)
+    {
+        if(wq.bs.size() == wq_t::max_batch)
+            break;
+        wq.bs.emplace_back(&e.data[e.offset],
+            e.data.size() - e.offset);
+    }
+    wq.sending = wq.bs.size();
+    boost::asio::async_write(ws.stream_,
+        wq.bs, ws.strand_->wrap(std::move(*this)));
+}
+
+template<class NextLayer>
+void
+stream<NextLayer>::
+queue_op::
+operator()(error_code ec, std::size_t)
+{
+    auto& ws = ws_;
+    auto& wq = *ws.wq_;
+    BOOST_ASSERT(ws.wr_block_ == &wq);
+    if(ec)
+    {
+        ws.failed_ = true;
+        return fail(ec);
+    }
+    for(; wq.sending > 0; --wq.sending)
+    {
+        auto const& e = wq.q.front();
+        wq.size -= e.data.size() - e.offset;
+        if(e.credit > 0)
+            ws.sq_.bytes.fetch_sub(e.credit,
+                std::memory_order_relaxed);
+        wq.q.pop_front();
+    }
+    ws.wr_block_ = nullptr;
+    if(wq.q.empty())
+        wq.active = false;
+    // Allow outgoing control frames to
+    // be sent in between queued frames:
+    ws.rd_op_.maybe_invoke() ||
+        ws.ping_op_.maybe_invoke();
+    if(wq.active)
+        return (*this)();
+    wq.flush_op.maybe_invoke();
+}
+
+template<class NextLayer>
+void
+stream<NextLayer>::
+queue_op::
+fail(error_code const& ec)
+{
+    auto& ws = ws_;
+    auto& wq = *ws.wq_;
+    if(ws.wr_block_ == &wq)
+        ws.wr_block_ = nullptr;
+    wq.ec = ec;
+    ws.sq_.closed = true;
+    for(auto const& e : wq.q)
+        if(e.credit > 0)
+            ws.sq_.bytes.fetch_sub(e.credit,
+                std::memory_order_relaxed);
+    wq.q.clear();
+    wq.size = 0;
+    wq.sending = 0;
+    wq.active = false;
+    ws.rd_op_.maybe_invoke() ||
+        ws.ping_op_.maybe_invoke();
+    wq.flush_op.maybe_invoke();
+}
+
+//------------------------------------------------------------------------------
+
+// Move submitted messages to the outgoing message queue
+//
+// One of these is posted each time a thread submits to an empty
+// submission queue. It takes every message submitted so far, so
+// a burst from many threads is framed in a single handler. It
+// runs in the stream's strand, like the queue op it starts.
+//
+template<class NextLayer>
+class stream<NextLayer>::submit_op
+{
+    stream<NextLayer>& ws_;
+
+public:
+    explicit
+    submit_op(stream<NextLayer>& ws)
+        : ws_(ws)
+    {
+    }
+
+    void operator()();
+};
+
+template<class NextLayer>
+void
+stream<NextLayer>::
+submit_op::
+operator()()
+{
+    using boost::asio::buffer;
+    auto& ws = ws_;
+    auto& sq = ws.sq_;
+    auto n = sq.pop_all();
+    if(! ws.wq_)
+        ws.wq_.reset(new wq_t);
+    auto& wq = *ws.wq_;
+    if(ws.failed_ || ws.wr_close_ || wq.ec)
+        sq.closed = true;
+    while(n)
+    {
+        auto const next = n->next;
+        std::size_t release = n->size;
+        if(! sq.closed)
+        {
+            wq.q.emplace_back();
+            auto& e = wq.q.back();
+            if(! ws.frame_message(buffer(
+                n->data(), n->size), e, wq.ec))
+            {
+                // Discarded, another write
+                // operation is sending a message
+                wq.q.pop_back();
+            }
+            else if(wq.ec)
+            {
+                ws.failed_ = true;
+                sq.closed = true;
+                wq.q.pop_back();
+            }
+            else
+            {
+                // Released when the frame is written
+                e.credit = release;
+                release = 0;
+                wq.size += e.data.size() - e.offset;
+            }
+        }
+        if(release > 0)
+            sq.bytes.fetch_sub(release,
+                std::memory_order_relaxed);
+        detail::submit_queue::destroy(n);
+        n = next;
+    }
+    if(! wq.active && ! wq.q.empty())
+    {
+        wq.active = true;
+        queue_op{ws}();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Wait for the outgoing message queue to empty
+//
+template<class NextLayer>
+template<class Handler>
+class stream<NextLayer>::flush_op
+{
+    struct data : op
+    {
+        bool cont;
+        stream<NextLayer>& ws;
+        int state = 0;
+
+        data(Handler& handler, stream<NextLayer>& ws_)
+            : cont(beast_asio_helpers::
+                is_continuation(handler))
+            , ws(ws_)
+        {
+        }
+    };
+
+    handler_ptr<data, Handler> d_;
+
+public:
+    flush_op(flush_op&&) = default;
+    flush_op(flush_op const&) = default;
+
+    template<class DeducedHandler, class... Args>
+    flush_op(DeducedHandler&& h,
+            stream<NextLayer>& ws, Args&&... args)
+        : d_(std::forward<DeducedHandler>(h),
+            ws, std::forward<Args>(args)...)
+    {
+        (*this)(error_code{}, false);
+    }
+
+    void operator()()
+    {
+        (*this)(error_code{});
+    }
+
+    void operator()(error_code ec, bool again = true);
+
+    friend
+    void* asio_handler_allocate(
+        std::size_t size, flush_op* op)
+    {
+        return beast_asio_helpers::
+            allocate(size, op->d_.handler());
+    }
+
+    friend
+    void asio_handler_deallocate(
+        void* p, std::size_t size, flush_op* op)
+    {
+        return beast_asio_helpers::
+            deallocate(p, size, op->d_.handler());
+    }
+
+    friend
+    bool asio_handler_is_continuation(flush_op* op)
+    {
+        return op->d_->cont;
+    }
+
+    template<class Function>
+    friend
+    void asio_handler_invoke(Function&& f, flush_op* op)
+    {
+        return beast_asio_helpers::
+            invoke(f, op->d_.handler());
+    }
+};
+
+template<class NextLayer>
+template<class Handler>
+void
+stream<NextLayer>::
+flush_op<Handler>::
+operator()(error_code ec, bool again)
+{
+    auto& d = *d_;
+    d.cont = d.cont || again;
+    switch(d.state)
+    {
+    case 0:
+        if(d.ws.wq_ && d.ws.wq_->active)
+        {
+            // suspend
+            d.state = 1;
+            d.ws.wq_->flush_op.template emplace<
+                flush_op>(std::move(*this));
+            return;
+        }
+        // [[fallthrough]]
+
+    case 1:
+        // The queue is empty. Call post to make sure
+        // we are invoked the same way as the final
+        // handler for this operation.
+        d.state = 2;
+        d.ws.get_io_service().post(bind_handler(
+            std::move(*this), d.ws.wq_ ?
+                d.ws.wq_->ec : error_code{}));
+        return;
+
+    default:
+        break;
+    }
+    d_.invoke(ec);
+}
+
+template<class NextLayer>
+template<class WriteHandler>
+typename async_completion<
+    WriteHandler, void(error_code)>::result_type
+stream<NextLayer>::
+async_flush(WriteHandler&& handler)
+{
+    static_assert(is_AsyncStream<next_layer_type>::value,
+        "AsyncStream requirements not met");
+    beast::async_completion<
+        WriteHandler, void(error_code)
+            > completion{handler};
+    flush_op<decltype(completion.handler)>{
+        completion.handler, *this};
+    return completion.result.get();
+}
+
+//------------------------------------------------------------------------------
+
+template<class NextLayer>
+template<class ConstBufferSequence>
+bool
+stream<NextLayer>::
+enqueue(ConstBufferSequence const& buffers)
+{
+    static_assert(is_AsyncStream<next_layer_type>::value,
+        "AsyncStream requirements not met");
+    static_assert(beast::is_ConstBufferSequence<
+        ConstBufferSequence>::value,
+            "ConstBufferSequence requirements not met");
+    if(! wq_)
+        wq_.reset(new wq_t);
+    auto& wq = *wq_;
+    if(failed_ || wr_close_ || wq.ec)
+        return false;
+    if(wq.size > 0 && wq.size + boost::asio::buffer_size(
+            buffers) > wq_limit_)
+        return false;
+    wq.q.emplace_back();
+    if(! frame_message(buffers, wq.q.back(), wq.ec))
+    {
+        wq.q.pop_back();
+        return false;
+    }
+    if(wq.ec)
+    {
+        failed_ = true;
+        wq.q.pop_back();
+        return false;
+    }
+    auto const& e = wq.q.back();
+    wq.size += e.data.size() - e.offset;
+    if(! wq.active)
+    {
+        // Start sending after the caller returns, so
+        // that the messages it queues go out together.
+        wq.active = true;
+        strand_->post(queue_op{*this});
+    }
+    return true;
+}
+
+template<class NextLayer>
+template<class ConstBufferSequence>
+bool
+stream<NextLayer>::
+submit(ConstBufferSequence const& buffers)
+{
+    static_assert(is_AsyncStream<next_layer_type>::value,
+        "AsyncStream requirements not met");
+    static_assert(beast::is_ConstBufferSequence<
+        ConstBufferSequence>::value,
+            "ConstBufferSequence requirements not met");
+    using boost::asio::buffer;
+    using boost::asio::buffer_copy;
+    using boost::asio::buffer_size;
+    if(sq_.closed.load(std::memory_order_relaxed))
+        return false;
+    auto const size = buffer_size(buffers);
+    auto const n = detail::submit_queue::make(size);
+    buffer_copy(buffer(n->data(), size), buffers);
+    auto const prev = sq_.bytes.fetch_add(
+        size, std::memory_order_relaxed);
+    if(prev > 0 && prev + size > wq_limit_)
+    {
+        sq_.bytes.fetch_sub(
+            size, std::memory_order_relaxed);
+        detail::submit_queue::destroy(n);
+        return false;
+    }
+    if(sq_.push(n))
+        strand_->post(submit_op{*this});
+    return true;
+}
+
+// Returns `false` if a write operation is sending a message,
+// whose write buffer and deflate stream must not be touched.
+//
+template<class NextLayer>
+template<class ConstBufferSequence>
+bool
+stream<NextLayer>::
+frame_message(ConstBufferSequence const& buffers,
+    wq_t::entry& e, error_code& ec)
+{
+    using boost::asio::buffer;
+    using boost::asio::buffer_cast;
+    using boost::asio::buffer_copy;
+    using boost::asio::buffer_size;
+    // Room for the largest frame header
+    std::size_t constexpr room = 14;
+    if(wr_.active || wr_.cont || wr_.pending)
+        return false;
+    wr_begin(buffers, true);
+    auto& v = e.data;
+    if(wr_.compress)
+    {
+        v.resize(room);
+        consuming_buffers<
+            ConstBufferSequence> cb{buffers};
+        for(;;)
+        {
+            auto b = buffer(
+                wr_.buf.get(), wr_.buf_size);
+            auto const more = detail::deflate(
+                *pmd_->zo, b, cb, true, ec);
+            if(ec)
+                break;
+            auto const p =
+                buffer_cast<std::uint8_t const*>(b);
+            v.insert(v.end(), p, p + buffer_size(b));
+            if(! more)
+                break;
+        }
+    }
+    else
+    {
+        v.resize(room + buffer_size(buffers));
+        buffer_copy(buffer(&v[room],
+            v.size() - room), buffers);
+    }
+    if(! ec)
+    {
+        detail::frame_header fh;
+        fh.op = wr_opcode_;
+        fh.fin = true;
+        fh.rsv1 = wr_.compress;
+        fh.rsv2 = false;
+        fh.rsv3 = false;
+        fh.len = v.size() - room;
+        fh.mask = role_ == detail::role_type::client;
+        if(fh.mask)
+        {
+            fh.key = maskgen_();
+            detail::prepared_key key;
+            detail::prepare_key(key, fh.key);
+            detail::mask_inplace(buffer(
+                &v[room], v.size() - room), key);
+        }
+        detail::fh_streambuf fh_buf;
+        detail::write<static_streambuf>(fh_buf, fh);
+        e.offset = room - buffer_size(fh_buf.data());
+        buffer_copy(buffer(&v[e.offset],
+            room - e.offset), fh_buf.data());
+    }
+    wr_done();
+    return true;
+}
+
+} // websocket
+} // beast
+
+#endif
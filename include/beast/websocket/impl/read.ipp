@@ -9,7 +9,9 @@
 #define BEAST_WEBSOCKET_IMPL_READ_IPP
 
 #include <beast/websocket/teardown.hpp>
+#include <beast/websocket/detail/mask_utf8.hpp>
 #include <beast/core/buffer_concepts.hpp>
+#include <beast/core/consuming_buffers.hpp>
 #include <beast/core/handler_helpers.hpp>
 #include <beast/core/handler_ptr.hpp>
 #include <beast/core/prepare_buffers.hpp>
@@ -29,6 +31,10 @@ namespace websocket {
 // Reads a single message frame,
 // processes any received control frames.
 //
+// If `hdr` is set, only the header of the next message
+// frame is read, and stored there. The payload is left
+// in the next layer for the caller to receive.
+//
 template<class NextLayer>
 template<class DynamicBuffer, class Handler>
 class stream<NextLayer>::read_frame_op
@@ -54,15 +60,18 @@ class stream<NextLayer>::read_frame_op
         detail::prepared_key key;
         boost::optional<dmb_type> dmb;
         boost::optional<fmb_type> fmb;
+        detail::frame_header* hdr;
         int state = 0;
 
         data(Handler& handler, stream<NextLayer>& ws_,
-                frame_info& fi_, DynamicBuffer& sb_)
+                frame_info& fi_, DynamicBuffer& sb_,
+                    detail::frame_header* hdr_ = nullptr)
             : cont(beast_asio_helpers::
                 is_continuation(handler))
             , ws(ws_)
             , fi(fi_)
             , db(sb_)
+            , hdr(hdr_)
         {
         }
     };
@@ -138,6 +147,8 @@ operator()(error_code ec, std::size_t bytes_transferred)
     auto& d = *d_;
     if(ec)
         d.ws.failed_ = true;
+    else if(bytes_transferred > 0)
+        d.ws.idle_.rx = true;
     (*this)(ec, bytes_transferred, true);
 }
 
@@ -187,7 +198,9 @@ operator()(error_code ec,
                             boost::asio::error::operation_aborted, 0));
                     return;
                 }
-                d.state = do_read_fh;
+                // Continue a partly delivered compressed frame
+                d.state = d.ws.rd_.zframe ?
+                    do_inflate_payload + 1 : do_read_fh;
                 break;
 
             //------------------------------------------------------------------
@@ -225,11 +238,12 @@ operator()(error_code ec,
                 d.remain -= bytes_transferred;
                 auto const pb = prepare_buffers(
                     bytes_transferred, *d.dmb);
-                if(d.fh.mask)
-                    detail::mask_inplace(pb, d.key);
                 if(d.ws.rd_.op == opcode::text)
                 {
-                    if(! d.ws.rd_.utf8.write(pb) ||
+                    if(! (d.fh.mask ?
+                        detail::mask_utf8_inplace(
+                            pb, d.key, d.ws.rd_.utf8) :
+                        d.ws.rd_.utf8.write(pb)) ||
                         (d.remain == 0 && d.fh.fin &&
                             ! d.ws.rd_.utf8.finish()))
                     {
@@ -239,6 +253,8 @@ operator()(error_code ec,
                         break;
                     }
                 }
+                else if(d.fh.mask)
+                    detail::mask_inplace(pb, d.key);
                 d.db.commit(bytes_transferred);
                 if(d.remain > 0)
                 {
@@ -252,83 +268,37 @@ operator()(error_code ec,
             //------------------------------------------------------------------
 
             case do_inflate_payload:
-                d.remain = d.fh.len;
-                if(d.fh.len == 0)
-                {
-                    // inflate even if fh.len == 0, otherwise we
-                    // never emit the end-of-stream deflate block.
-                    bytes_transferred = 0;
-                    d.state = do_inflate_payload + 2;
-                    break;
-                }
-                if(d.fh.mask)
-                    detail::prepare_key(d.key, d.fh.key);
+                d.ws.rd_zbegin(d.fh);
                 // fall through
 
             case do_inflate_payload + 1:
-            {
+                code = close_code::none;
+                if(d.ws.rd_inflate(d.db, code, ec))
+                {
+                    // call handler
+                    d.fi.op = d.ws.rd_.op;
+                    d.fi.fin = d.ws.rd_.fin && ! d.ws.rd_.zframe;
+                    goto upcall;
+                }
+                if(ec)
+                    break;
+                if(code != close_code::none)
+                {
+                    d.state = do_fail;
+                    break;
+                }
                 d.state = do_inflate_payload + 2;
                 // Read compressed frame payload data
                 d.ws.stream_.async_read_some(
                     buffer(d.ws.rd_.buf.get(), clamp(
-                        d.remain, d.ws.rd_.buf_size)),
+                        d.ws.rd_.remain, d.ws.rd_.buf_size)),
                             std::move(*this));
                 return;
-            }
 
             case do_inflate_payload + 2:
-            {
-                d.remain -= bytes_transferred;
-                auto const in = buffer(
-                    d.ws.rd_.buf.get(), bytes_transferred);
-                if(d.fh.mask)
-                    detail::mask_inplace(in, d.key);
-                auto const prev = d.db.size();
-                detail::inflate(d.ws.pmd_->zi, d.db, in, ec);
-                d.ws.failed_ = ec != 0;
-                if(d.ws.failed_)
-                    break;
-                if(d.remain == 0 && d.fh.fin)
-                {
-                    static std::uint8_t constexpr
-                        empty_block[4] = {
-                            0x00, 0x00, 0xff, 0xff };
-                    detail::inflate(d.ws.pmd_->zi, d.db,
-                        buffer(&empty_block[0], 4), ec);
-                    d.ws.failed_ = ec != 0;
-                    if(d.ws.failed_)
-                        break;
-                }
-                if(d.ws.rd_.op == opcode::text)
-                {
-                    consuming_buffers<typename
-                        DynamicBuffer::const_buffers_type
-                            > cb{d.db.data()};
-                    cb.consume(prev);
-                    if(! d.ws.rd_.utf8.write(cb) ||
-                        (d.remain == 0 && d.fh.fin &&
-                            ! d.ws.rd_.utf8.finish()))
-                    {
-                        // invalid utf8
-                        code = close_code::bad_payload;
-                        d.state = do_fail;
-                        break;
-                    }
-                }
-                if(d.remain > 0)
-                {
-                    d.state = do_inflate_payload + 1;
-                    break;
-                }
-                if(d.fh.fin && (
-                    (d.ws.role_ == detail::role_type::client &&
-                        d.ws.pmd_config_.server_no_context_takeover) ||
-                    (d.ws.role_ == detail::role_type::server &&
-                        d.ws.pmd_config_.client_no_context_takeover)))
-                    d.ws.pmd_->zi.reset();
-                d.state = do_frame_done;
+                d.ws.rd_zinput(bytes_transferred);
+                d.state = do_inflate_payload + 1;
                 break;
-            }
 
             //------------------------------------------------------------------
 
@@ -395,6 +365,14 @@ operator()(error_code ec,
                     d.state = do_control;
                     break;
                 }
+                if(d.hdr)
+                {
+                    // The caller receives the payload
+                    *d.hdr = d.fh;
+                    d.fi.op = d.ws.rd_.op;
+                    d.fi.fin = d.fh.fin;
+                    goto upcall;
+                }
                 if(d.fh.op == opcode::text ||
                         d.fh.op == opcode::binary)
                     d.ws.rd_begin();
@@ -673,8 +651,13 @@ operator()(error_code ec,
 upcall:
     if(d.ws.wr_block_ == &d)
         d.ws.wr_block_ = nullptr;
-    d.ws.ping_op_.maybe_invoke() ||
-        d.ws.wr_op_.maybe_invoke();
+    // Nothing more will be received
+    if(ec)
+        d.ws.idle_stop();
+    // A parked op can't run while another writes
+    if(! d.ws.wr_block_)
+        d.ws.ping_op_.maybe_invoke() ||
+            d.ws.wr_op_.maybe_invoke();
     d_.invoke(ec);
 }
 
@@ -724,41 +707,132 @@ read_frame(frame_info& fi, DynamicBuffer& dynabuf, error_code& ec)
     static_assert(beast::is_DynamicBuffer<DynamicBuffer>::value,
         "DynamicBuffer requirements not met");
     using beast::detail::clamp;
-    using boost::asio::buffer;
-    using boost::asio::buffer_cast;
-    using boost::asio::buffer_size;
     close_code::value code{};
+    if(rd_.zframe)
+    {
+        // Continue a partly delivered compressed frame
+        read_inflate(dynabuf, code, ec);
+        if(ec)
+            return;
+        if(code != close_code::none)
+            return read_close(code, ec);
+        fi.op = rd_.op;
+        fi.fin = rd_.fin && ! rd_.zframe;
+        return;
+    }
     for(;;)
     {
-        // Read frame header
         detail::frame_header fh;
+        if(! read_data_fh(fh, code, ec))
+        {
+            if(! ec)
+                read_close(code, ec);
+            return;
+        }
+        if(fh.op != opcode::cont)
+            rd_begin();
+        if(fh.len == 0 && ! fh.fin)
+        {
+            // empty frame
+            continue;
+        }
+        auto remain = fh.len;
+        detail::prepared_key key;
+        if(fh.mask)
+            detail::prepare_key(key, fh.key);
+        if(! pmd_ || ! pmd_->rd_set)
+        {
+            // Enforce message size limit
+            if(rd_msg_max_ && fh.len >
+                rd_msg_max_ - rd_.size)
+                return read_close(close_code::too_big, ec);
+            rd_.size += fh.len;
+            // Read message frame payload
+            while(remain > 0)
+            {
+                auto b =
+                    dynabuf.prepare(clamp(remain));
+                auto const bytes_transferred =
+                    stream_.read_some(b, ec);
+                failed_ = ec != 0;
+                if(failed_)
+                    return;
+                BOOST_ASSERT(bytes_transferred > 0);
+                remain -= bytes_transferred;
+                auto const pb = prepare_buffers(
+                    bytes_transferred, b);
+                if(rd_.op == opcode::text)
+                {
+                    if(! (fh.mask ?
+                        detail::mask_utf8_inplace(
+                            pb, key, rd_.utf8) :
+                        rd_.utf8.write(pb)) ||
+                        (remain == 0 && fh.fin &&
+                            ! rd_.utf8.finish()))
+                        return read_close(
+                            close_code::bad_payload, ec);
+                }
+                else if(fh.mask)
+                    detail::mask_inplace(pb, key);
+                dynabuf.commit(bytes_transferred);
+            }
+        }
+        else
+        {
+            rd_zbegin(fh);
+            read_inflate(dynabuf, code, ec);
+            if(ec)
+                return;
+            if(code != close_code::none)
+                return read_close(code, ec);
+        }
+        fi.op = rd_.op;
+        fi.fin = fh.fin && ! rd_.zframe;
+        return;
+    }
+}
+
+// Read frame headers until one starts or continues a message,
+// processing any control frames. Returns `false` upon error, or
+// when the connection is to be closed with `code`.
+//
+template<class NextLayer>
+template<class>
+bool
+stream<NextLayer>::
+read_data_fh(detail::frame_header& fh,
+    close_code::value& code, error_code& ec)
+{
+    for(;;)
+    {
+        // Read frame header
         detail::frame_streambuf fb;
         {
             fb.commit(boost::asio::read(
                 stream_, fb.prepare(2), ec));
             failed_ = ec != 0;
             if(failed_)
-                return;
+                return false;
             {
                 auto const n = read_fh1(fh, fb, code);
                 if(code != close_code::none)
-                    goto do_close;
+                    return false;
                 if(n > 0)
                 {
                     fb.commit(boost::asio::read(
                         stream_, fb.prepare(n), ec));
                     failed_ = ec != 0;
                     if(failed_)
-                        return;
+                        return false;
                 }
             }
             read_fh2(fh, fb, code);
 
             failed_ = ec != 0;
             if(failed_)
-                return;
+                return false;
             if(code != close_code::none)
-                goto do_close;
+                return false;
         }
         if(detail::is_control(fh.op))
         {
@@ -770,7 +844,7 @@ read_frame(frame_info& fi, DynamicBuffer& dynabuf, error_code& ec)
                 fb.commit(boost::asio::read(stream_, mb, ec));
                 failed_ = ec != 0;
                 if(failed_)
-                    return;
+                    return false;
                 if(fh.mask)
                 {
                     detail::prepared_key key;
@@ -792,7 +866,7 @@ read_frame(frame_info& fi, DynamicBuffer& dynabuf, error_code& ec)
                 boost::asio::write(stream_, fb.data(), ec);
                 failed_ = ec != 0;
                 if(failed_)
-                    return;
+                    return false;
                 continue;
             }
             else if(fh.op == opcode::pong)
@@ -807,7 +881,7 @@ read_frame(frame_info& fi, DynamicBuffer& dynabuf, error_code& ec)
             {
                 detail::read(cr_, fb.data(), code);
                 if(code != close_code::none)
-                    goto do_close;
+                    return false;
                 if(! wr_close_)
                 {
                     auto cr = cr_;
@@ -819,125 +893,23 @@ read_frame(frame_info& fi, DynamicBuffer& dynabuf, error_code& ec)
                     write_close<static_streambuf>(fb, cr);
                     boost::asio::write(stream_, fb.data(), ec);
                     failed_ = ec != 0;
-                    if(failed_)
-                        return;
                 }
-                goto do_close;
+                return false;
             }
         }
-        if(fh.op != opcode::cont)
-            rd_begin();
-        if(fh.len == 0 && ! fh.fin)
-        {
-            // empty frame
-            continue;
-        }
-        auto remain = fh.len;
-        detail::prepared_key key;
-        if(fh.mask)
-            detail::prepare_key(key, fh.key);
-        if(! pmd_ || ! pmd_->rd_set)
-        {
-            // Enforce message size limit
-            if(rd_msg_max_ && fh.len >
-                rd_msg_max_ - rd_.size)
-            {
-                code = close_code::too_big;
-                goto do_close;
-            }
-            rd_.size += fh.len;
-            // Read message frame payload
-            while(remain > 0)
-            {
-                auto b =
-                    dynabuf.prepare(clamp(remain));
-                auto const bytes_transferred =
-                    stream_.read_some(b, ec);
-                failed_ = ec != 0;
-                if(failed_)
-                    return;
-                BOOST_ASSERT(bytes_transferred > 0);
-                remain -= bytes_transferred;
-                auto const pb = prepare_buffers(
-                    bytes_transferred, b);
-                if(fh.mask)
-                    detail::mask_inplace(pb, key);
-                if(rd_.op == opcode::text)
-                {
-                    if(! rd_.utf8.write(pb) ||
-                        (remain == 0 && fh.fin &&
-                            ! rd_.utf8.finish()))
-                    {
-                        code = close_code::bad_payload;
-                        goto do_close;
-                    }
-                }
-                dynabuf.commit(bytes_transferred);
-            }
-        }
-        else
-        {
-            // Read compressed message frame payload:
-            // inflate even if fh.len == 0, otherwise we
-            // never emit the end-of-stream deflate block.
-            for(;;)
-            {
-                auto const bytes_transferred =
-                    stream_.read_some(buffer(rd_.buf.get(),
-                        clamp(remain, rd_.buf_size)), ec);
-                failed_ = ec != 0;
-                if(failed_)
-                    return;
-                remain -= bytes_transferred;
-                auto const in = buffer(
-                    rd_.buf.get(), bytes_transferred);
-                if(fh.mask)
-                    detail::mask_inplace(in, key);
-                auto const prev = dynabuf.size();
-                detail::inflate(pmd_->zi, dynabuf, in, ec);
-                failed_ = ec != 0;
-                if(failed_)
-                    return;
-                if(remain == 0 && fh.fin)
-                {
-                    static std::uint8_t constexpr
-                        empty_block[4] = {
-                            0x00, 0x00, 0xff, 0xff };
-                    detail::inflate(pmd_->zi, dynabuf,
-                        buffer(&empty_block[0], 4), ec);
-                    failed_ = ec != 0;
-                    if(failed_)
-                        return;
-                }
-                if(rd_.op == opcode::text)
-                {
-                    consuming_buffers<typename
-                        DynamicBuffer::const_buffers_type
-                            > cb{dynabuf.data()};
-                    cb.consume(prev);
-                    if(! rd_.utf8.write(cb) || (
-                        remain == 0 && fh.fin &&
-                            ! rd_.utf8.finish()))
-                    {
-                        code = close_code::bad_payload;
-                        goto do_close;
-                    }
-                }
-                if(remain == 0)
-                    break;
-            }
-            if(fh.fin && (
-                (role_ == detail::role_type::client &&
-                    pmd_config_.server_no_context_takeover) ||
-                (role_ == detail::role_type::server &&
-                    pmd_config_.client_no_context_takeover)))
-                pmd_->zi.reset();
-        }
-        fi.op = rd_.op;
-        fi.fin = fh.fin;
-        return;
+        return true;
     }
-do_close:
+}
+
+// Close the connection after a read, failing it
+// with `code` if this is not the closing handshake.
+//
+template<class NextLayer>
+template<class>
+void
+stream<NextLayer>::
+read_close(close_code::value code, error_code& ec)
+{
     if(code != close_code::none)
     {
         // Fail the connection (per rfc6455)
@@ -1143,6 +1115,364 @@ read(opcode& op, DynamicBuffer& dynabuf, error_code& ec)
 
 //------------------------------------------------------------------------------
 
+// Receive and inflate the current compressed frame until
+// some of the message is ready for the caller.
+//
+template<class NextLayer>
+template<class DynamicBuffer>
+void
+stream<NextLayer>::
+read_inflate(DynamicBuffer& dynabuf,
+    close_code::value& code, error_code& ec)
+{
+    using beast::detail::clamp;
+    using boost::asio::buffer;
+    while(! rd_inflate(dynabuf, code, ec))
+    {
+        if(ec || code != close_code::none)
+            return;
+        auto const bytes_transferred =
+            stream_.read_some(buffer(rd_.buf.get(),
+                clamp(rd_.remain, rd_.buf_size)), ec);
+        failed_ = ec != 0;
+        if(failed_)
+            return;
+        rd_zinput(bytes_transferred);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Parse whole messages held in the read buffer, returns
+// `true` if the next frame needs the regular read path.
+//
+template<class NextLayer>
+template<class DynamicBuffer>
+bool
+stream<NextLayer>::
+read_buffered(std::vector<message_info>& messages,
+    DynamicBuffer& dynabuf)
+{
+    using boost::asio::buffer;
+    using boost::asio::buffer_copy;
+    auto& sb = stream_.buffer();
+    for(;;)
+    {
+        if(sb.size() < 2)
+            return false;
+        std::uint8_t b[2];
+        buffer_copy(buffer(b), sb.data());
+        // Only unfragmented, uncompressed data frames
+        // are parsed here, everything else is slow.
+        auto const op = static_cast<opcode>(b[0] & 0x0f);
+        if((b[0] & 0xf0) != 0x80 || rd_.cont || rd_.zframe || (
+                op != opcode::text && op != opcode::binary))
+            return true;
+        detail::fh_streambuf fb;
+        fb.commit(buffer_copy(fb.prepare((std::min)(
+            sb.size(), fb.max_size())), sb.data()));
+        detail::frame_header fh;
+        close_code::value code;
+        auto const n = read_fh1(fh, fb, code);
+        if(code != close_code::none)
+            return true;
+        if(fb.size() < n)
+            return false;
+        read_fh2(fh, fb, code);
+        if(code != close_code::none)
+            return true;
+        if(rd_msg_max_ && fh.len > rd_msg_max_)
+            return true;
+        auto const header = 2 + n;
+        if(fh.len > sb.size() - header)
+            // Large frames are read directly
+            return fh.len > rd_buf_size_ ||
+                header + fh.len > rd_buf_size_;
+        auto const len = static_cast<std::size_t>(fh.len);
+        consuming_buffers<typename
+            streambuf::const_buffers_type> cb{sb.data()};
+        cb.consume(header);
+        auto const mb = dynabuf.prepare(len);
+        buffer_copy(mb, cb, len);
+        detail::prepared_key key;
+        if(fh.mask)
+            detail::prepare_key(key, fh.key);
+        if(op == opcode::text)
+        {
+            if(! (fh.mask ?
+                detail::mask_utf8_inplace(mb, key, rd_.utf8) :
+                rd_.utf8.write(mb)) || ! rd_.utf8.finish())
+            {
+                // Leave it for the regular
+                // read path to fail the stream.
+                rd_.utf8.reset();
+                return true;
+            }
+        }
+        else if(fh.mask)
+            detail::mask_inplace(mb, key);
+        dynabuf.commit(len);
+        sb.consume(header + len);
+        rd_.size = len;
+        messages.push_back({op, len});
+    }
+}
+
+// Read all the messages that arrive together
+//
+template<class NextLayer>
+template<class DynamicBuffer, class Handler>
+class stream<NextLayer>::read_batch_op
+{
+    struct data
+    {
+        bool cont;
+        stream<NextLayer>& ws;
+        std::vector<message_info>& messages;
+        DynamicBuffer& db;
+        std::size_t count;
+        std::size_t size = 0;
+        opcode op;
+        int state = 0;
+
+        data(Handler& handler, stream<NextLayer>& ws_,
+                std::vector<message_info>& messages_,
+                    DynamicBuffer& sb_)
+            : cont(beast_asio_helpers::
+                is_continuation(handler))
+            , ws(ws_)
+            , messages(messages_)
+            , db(sb_)
+            , count(messages_.size())
+        {
+        }
+    };
+
+    handler_ptr<data, Handler> d_;
+
+public:
+    read_batch_op(read_batch_op&&) = default;
+    read_batch_op(read_batch_op const&) = default;
+
+    template<class DeducedHandler, class... Args>
+    read_batch_op(DeducedHandler&& h,
+            stream<NextLayer>& ws, Args&&... args)
+        : d_(std::forward<DeducedHandler>(h),
+            ws, std::forward<Args>(args)...)
+    {
+        (*this)(error_code{}, 0, false);
+    }
+
+    void operator()(error_code const& ec)
+    {
+        (*this)(ec, 0, true);
+    }
+
+    void operator()(error_code ec,
+        std::size_t bytes_transferred, bool again = true);
+
+    friend
+    void* asio_handler_allocate(
+        std::size_t size, read_batch_op* op)
+    {
+        return beast_asio_helpers::
+            allocate(size, op->d_.handler());
+    }
+
+    friend
+    void asio_handler_deallocate(
+        void* p, std::size_t size, read_batch_op* op)
+    {
+        return beast_asio_helpers::
+            deallocate(p, size, op->d_.handler());
+    }
+
+    friend
+    bool asio_handler_is_continuation(read_batch_op* op)
+    {
+        return op->d_->cont;
+    }
+
+    template<class Function>
+    friend
+    void asio_handler_invoke(Function&& f, read_batch_op* op)
+    {
+        return beast_asio_helpers::
+            invoke(f, op->d_.handler());
+    }
+};
+
+template<class NextLayer>
+template<class DynamicBuffer, class Handler>
+void
+stream<NextLayer>::read_batch_op<DynamicBuffer, Handler>::
+operator()(error_code ec,
+    std::size_t bytes_transferred, bool again)
+{
+    enum
+    {
+        do_start = 0,
+        do_parse = 1,
+        do_read = 2,
+        do_read_message = 4,
+
+        do_call_handler = 99
+    };
+
+    auto& d = *d_;
+    d.cont = d.cont || again;
+    while(! ec)
+    {
+        switch(d.state)
+        {
+        case do_start:
+            if(d.ws.failed_)
+            {
+                d.state = do_call_handler;
+                d.ws.get_io_service().post(
+                    bind_handler(std::move(*this),
+                        boost::asio::error::operation_aborted, 0));
+                return;
+            }
+            if(d.ws.stream_.buffer().size() > 0)
+            {
+                // Messages may be waiting already
+                d.state = do_parse;
+                d.ws.get_io_service().post(
+                    bind_handler(std::move(*this), ec, 0));
+                return;
+            }
+            d.state = do_read;
+            break;
+
+        case do_parse:
+            if(d.ws.read_buffered(d.messages, d.db))
+            {
+                if(d.messages.size() > d.count)
+                    goto upcall;
+                d.state = do_read_message;
+                d.size = d.db.size();
+                d.ws.async_read(d.op, d.db, *this);
+                return;
+            }
+            if(d.messages.size() > d.count)
+                goto upcall;
+            d.state = do_read;
+            break;
+
+        case do_read:
+            d.state = do_read + 1;
+            d.ws.stream_.next_layer().async_read_some(
+                d.ws.stream_.buffer().prepare(
+                    d.ws.rd_buf_size_), std::move(*this));
+            return;
+
+        case do_read + 1:
+            if(bytes_transferred > 0)
+                d.ws.idle_.rx = true;
+            d.ws.stream_.buffer().commit(bytes_transferred);
+            d.state = do_parse;
+            break;
+
+        case do_read_message:
+            d.messages.push_back(
+                {d.op, d.db.size() - d.size});
+            // Deliver what arrived with it
+            d.ws.read_buffered(d.messages, d.db);
+            goto upcall;
+
+        case do_call_handler:
+            goto upcall;
+        }
+    }
+    if(d.state == do_read + 1)
+    {
+        d.ws.failed_ = true;
+        d.ws.idle_stop();
+    }
+upcall:
+    d_.invoke(ec);
+}
+
+template<class NextLayer>
+template<class DynamicBuffer, class ReadHandler>
+typename async_completion<
+    ReadHandler, void(error_code)>::result_type
+stream<NextLayer>::
+async_read_batch(std::vector<message_info>& messages,
+    DynamicBuffer& dynabuf, ReadHandler&& handler)
+{
+    static_assert(is_AsyncStream<next_layer_type>::value,
+        "AsyncStream requirements requirements not met");
+    static_assert(beast::is_DynamicBuffer<DynamicBuffer>::value,
+        "DynamicBuffer requirements not met");
+    beast::async_completion<
+        ReadHandler, void(error_code)
+            > completion{handler};
+    read_batch_op<DynamicBuffer, decltype(completion.handler)>{
+        completion.handler, *this, messages, dynabuf};
+    return completion.result.get();
+}
+
+template<class NextLayer>
+template<class DynamicBuffer>
+void
+stream<NextLayer>::
+read_batch(std::vector<message_info>& messages,
+    DynamicBuffer& dynabuf)
+{
+    static_assert(is_SyncStream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(beast::is_DynamicBuffer<DynamicBuffer>::value,
+        "DynamicBuffer requirements not met");
+    error_code ec;
+    read_batch(messages, dynabuf, ec);
+    if(ec)
+        throw system_error{ec};
+}
+
+template<class NextLayer>
+template<class DynamicBuffer>
+void
+stream<NextLayer>::
+read_batch(std::vector<message_info>& messages,
+    DynamicBuffer& dynabuf, error_code& ec)
+{
+    static_assert(is_SyncStream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(beast::is_DynamicBuffer<DynamicBuffer>::value,
+        "DynamicBuffer requirements not met");
+    auto const count = messages.size();
+    for(;;)
+    {
+        if(read_buffered(messages, dynabuf))
+        {
+            if(messages.size() > count)
+                return;
+            opcode op;
+            auto const size = dynabuf.size();
+            read(op, dynabuf, ec);
+            if(ec)
+                return;
+            messages.push_back({op, dynabuf.size() - size});
+            // Deliver what arrived with it
+            read_buffered(messages, dynabuf);
+            return;
+        }
+        if(messages.size() > count)
+            return;
+        auto const bytes_transferred =
+            stream_.next_layer().read_some(
+                stream_.buffer().prepare(rd_buf_size_), ec);
+        failed_ = ec != 0;
+        if(failed_)
+            return;
+        stream_.buffer().commit(bytes_transferred);
+    }
+}
+
+//------------------------------------------------------------------------------
+
 } // websocket
 } // beast
 
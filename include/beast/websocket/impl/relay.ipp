@@ -0,0 +1,483 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_IMPL_RELAY_IPP
+#define BEAST_WEBSOCKET_IMPL_RELAY_IPP
+
+#include <beast/core/bind_handler.hpp>
+#include <beast/core/buffer_cat.hpp>
+#include <beast/core/handler_helpers.hpp>
+#include <beast/core/handler_ptr.hpp>
+#include <beast/core/static_streambuf.hpp>
+#include <beast/core/stream_concepts.hpp>
+#include <beast/core/streambuf.hpp>
+#include <beast/core/detail/clamp.hpp>
+#include <beast/websocket/detail/frame.hpp>
+#include <boost/assert.hpp>
+#include <cstdint>
+
+namespace beast {
+namespace websocket {
+
+//------------------------------------------------------------------------------
+
+// Relay one message frame to another stream
+//
+// The frame header is read by a read_frame_op, which also handles
+// control frames. Unless the payload must be inflated, it is then
+// moved to the other stream one piece at a time, using a buffer no
+// larger than the read buffer, without storing the frame.
+//
+template<class NextLayer>
+template<class OtherLayer, class Handler>
+class stream<NextLayer>::relay_op
+{
+    struct data : op
+    {
+        bool cont;
+        stream<NextLayer>& ws;
+        frame_info& fi;
+        stream<OtherLayer>& dst;
+        detail::frame_header fh;        // frame received
+        detail::frame_header wfh;       // frame sent
+        detail::fh_streambuf fh_buf;
+        detail::prepared_key key;
+        bool mask = false;
+        bool rd_open = false;           // payload not all received
+        bool wr_open = false;           // payload not all sent
+        std::uint64_t remain;
+        std::size_t buf_size;
+        detail::pooled_buffer buf;
+        streambuf db;                   // inflated payload
+        int state = 0;
+
+        data(Handler& handler, stream<NextLayer>& ws_,
+                frame_info& fi_, stream<OtherLayer>& dst_)
+            : cont(beast_asio_helpers::
+                is_continuation(handler))
+            , ws(ws_)
+            , fi(fi_)
+            , dst(dst_)
+        {
+        }
+    };
+
+    handler_ptr<data, Handler> d_;
+
+public:
+    relay_op(relay_op&&) = default;
+    relay_op(relay_op const&) = default;
+
+    template<class DeducedHandler, class... Args>
+    relay_op(DeducedHandler&& h,
+            stream<NextLayer>& ws, Args&&... args)
+        : d_(std::forward<DeducedHandler>(h),
+            ws, std::forward<Args>(args)...)
+    {
+        (*this)(error_code{}, 0, false);
+    }
+
+    void operator()()
+    {
+        (*this)(error_code{}, 0, true);
+    }
+
+    void operator()(error_code const& ec)
+    {
+        (*this)(ec, 0, true);
+    }
+
+    void operator()(error_code ec,
+        std::size_t bytes_transferred)
+    {
+        (*this)(ec, bytes_transferred, true);
+    }
+
+    void operator()(error_code ec,
+        std::size_t bytes_transferred, bool again);
+
+    friend
+    void* asio_handler_allocate(
+        std::size_t size, relay_op* op)
+    {
+        return beast_asio_helpers::
+            allocate(size, op->d_.handler());
+    }
+
+    friend
+    void asio_handler_deallocate(
+        void* p, std::size_t size, relay_op* op)
+    {
+        return beast_asio_helpers::
+            deallocate(p, size, op->d_.handler());
+    }
+
+    friend
+    bool asio_handler_is_continuation(relay_op* op)
+    {
+        return op->d_->cont;
+    }
+
+    template<class Function>
+    friend
+    void asio_handler_invoke(Function&& f, relay_op* op)
+    {
+        return beast_asio_helpers::
+            invoke(f, op->d_.handler());
+    }
+};
+
+template<class NextLayer>
+template<class OtherLayer, class Handler>
+void
+stream<NextLayer>::
+relay_op<OtherLayer, Handler>::
+operator()(error_code ec,
+    std::size_t bytes_transferred, bool again)
+{
+    using beast::detail::clamp;
+    using boost::asio::buffer;
+    enum
+    {
+        do_start = 0,
+        do_header = 10,
+        do_maybe_suspend = 20,
+        do_payload = 30,
+        do_inflate = 40,
+        do_upcall = 99
+    };
+    auto& d = *d_;
+    d.cont = d.cont || again;
+    if(ec)
+        goto upcall;
+    for(;;)
+    {
+        switch(d.state)
+        {
+        case do_start:
+            if(d.ws.rd_.zframe)
+            {
+                // Continue a partly delivered compressed frame
+                d.state = do_inflate;
+                break;
+            }
+            d.state = do_header;
+            read_frame_op<streambuf, relay_op>{
+                *this, d.ws, d.fi, d.db, &d.fh};
+            return;
+
+        case do_header:
+            if(d.ws.pmd_ && d.ws.pmd_->rd_set &&
+                ! d.dst.pmd_relay(d.ws))
+            {
+                // Inflate the payload, and send it as a
+                // message of the other stream, in pieces
+                if(d.fh.op != opcode::cont)
+                    d.ws.rd_begin();
+                d.ws.rd_zbegin(d.fh);
+                d.ws.rd_.zlimit = d.ws.rd_buf_size_;
+                d.state = do_inflate;
+                break;
+            }
+            d.rd_open = d.fh.len > 0;
+            d.remain = d.fh.len;
+            d.state = do_maybe_suspend;
+            break;
+
+        //----------------------------------------------------------------------
+
+        case do_maybe_suspend:
+            if(d.dst.wr_block_)
+            {
+                // suspend
+                d.state = do_maybe_suspend + 1;
+                d.dst.wr_op_.template emplace<
+                    relay_op>(std::move(*this));
+                return;
+            }
+            if(d.dst.failed_ || d.dst.wr_close_)
+            {
+                // call handler
+                d.state = do_upcall;
+                d.ws.get_io_service().post(
+                    bind_handler(std::move(*this),
+                        boost::asio::error::operation_aborted));
+                return;
+            }
+            d.dst.wr_block_ = &d;
+            d.state = do_payload;
+            break;
+
+        case do_maybe_suspend + 1:
+            BOOST_ASSERT(! d.dst.wr_block_);
+            d.dst.wr_block_ = &d;
+            d.state = do_maybe_suspend + 2;
+            // Resumed by an operation on the other
+            // stream, so post to be invoked the same
+            // way as the final handler.
+            d.ws.get_io_service().post(bind_handler(
+                std::move(*this), ec));
+            return;
+
+        case do_maybe_suspend + 2:
+            BOOST_ASSERT(d.dst.wr_block_ == &d);
+            if(d.dst.failed_ || d.dst.wr_close_)
+            {
+                // call handler
+                ec = boost::asio::error::operation_aborted;
+                goto upcall;
+            }
+            d.state = do_payload;
+            break;
+
+        //----------------------------------------------------------------------
+
+        case do_payload:
+            BOOST_ASSERT(d.dst.wr_block_ == &d);
+            d.mask = d.dst.wr_relay(d.fh, d.wfh, d.key);
+            detail::write<static_streambuf>(
+                d.fh_buf, d.wfh);
+            d.wr_open = true;
+            if(d.remain == 0)
+            {
+                // Send frame header
+                d.state = do_payload + 3;
+                boost::asio::async_write(d.dst.stream_,
+                    d.fh_buf.data(), std::move(*this));
+                return;
+            }
+            d.buf_size = clamp(d.remain, d.ws.rd_buf_size_);
+            d.buf = detail::make_pooled_buffer(d.buf_size);
+            // [[fallthrough]]
+
+        case do_payload + 1:
+            d.state = do_payload + 2;
+            d.ws.stream_.async_read_some(buffer(d.buf.get(),
+                clamp(d.remain, d.buf_size)), std::move(*this));
+            return;
+
+        case do_payload + 2:
+        {
+            d.ws.idle_.rx = true;
+            d.remain -= bytes_transferred;
+            if(d.remain == 0)
+                d.rd_open = false;
+            auto const b = buffer(
+                d.buf.get(), bytes_transferred);
+            if(d.mask)
+                detail::mask_inplace(b, d.key);
+            // Send frame header and partial payload
+            d.state = do_payload + 3;
+            boost::asio::async_write(d.dst.stream_,
+                buffer_cat(d.fh_buf.data(), b),
+                    std::move(*this));
+            return;
+        }
+
+        case do_payload + 3:
+            d.fh_buf.reset();
+            if(d.remain > 0)
+            {
+                d.state = do_payload + 1;
+                break;
+            }
+            d.wr_open = false;
+            d.buf.reset();
+            goto upcall;
+
+        //----------------------------------------------------------------------
+
+        case do_inflate:
+            if(! d.dst.wr_.cont && ! d.dst.wr_.pending)
+                d.dst.wr_opcode_ = d.ws.rd_.op;
+            // [[fallthrough]]
+
+        case do_inflate + 1:
+            d.state = do_inflate + 2;
+            d.ws.async_read_frame(d.fi, d.db, *this);
+            return;
+
+        case do_inflate + 2:
+            if(d.db.size() == 0 && ! d.fi.fin)
+            {
+                // Nothing to send yet
+                d.state = do_inflate + 3;
+                break;
+            }
+            d.state = do_inflate + 3;
+            d.dst.async_write_frame(
+                d.fi.fin, d.db.data(), *this);
+            return;
+
+        case do_inflate + 3:
+            d.db.consume(d.db.size());
+            if(d.ws.rd_.zframe)
+            {
+                d.state = do_inflate + 1;
+                break;
+            }
+            goto upcall;
+
+        //----------------------------------------------------------------------
+
+        case do_upcall:
+            goto upcall;
+        }
+    }
+upcall:
+    if(ec)
+    {
+        // A frame left unfinished can't be continued
+        if(d.rd_open)
+            d.ws.failed_ = true;
+        if(d.wr_open)
+            d.dst.failed_ = true;
+    }
+    if(d.dst.wr_block_ == &d)
+        d.dst.wr_block_ = nullptr;
+    d.dst.rd_op_.maybe_invoke() ||
+        d.dst.ping_op_.maybe_invoke();
+    d_.invoke(ec);
+}
+
+template<class NextLayer>
+template<class OtherLayer, class RelayHandler>
+typename async_completion<
+    RelayHandler, void(error_code)>::result_type
+stream<NextLayer>::
+async_relay_frame(frame_info& fi,
+    stream<OtherLayer>& dst, RelayHandler&& handler)
+{
+    static_assert(is_AsyncStream<next_layer_type>::value,
+        "AsyncStream requirements not met");
+    static_assert(is_AsyncStream<typename stream<
+        OtherLayer>::next_layer_type>::value,
+            "AsyncStream requirements not met");
+    beast::async_completion<
+        RelayHandler, void(error_code)> completion{handler};
+    relay_op<OtherLayer, decltype(completion.handler)>{
+        completion.handler, *this, fi, dst};
+    return completion.result.get();
+}
+
+template<class NextLayer>
+template<class OtherLayer>
+void
+stream<NextLayer>::
+relay_frame(frame_info& fi, stream<OtherLayer>& dst)
+{
+    static_assert(is_SyncStream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(is_SyncStream<typename stream<
+        OtherLayer>::next_layer_type>::value,
+            "SyncStream requirements not met");
+    error_code ec;
+    relay_frame(fi, dst, ec);
+    if(ec)
+        throw system_error{ec};
+}
+
+template<class NextLayer>
+template<class OtherLayer>
+void
+stream<NextLayer>::
+relay_frame(frame_info& fi,
+    stream<OtherLayer>& dst, error_code& ec)
+{
+    static_assert(is_SyncStream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(is_SyncStream<typename stream<
+        OtherLayer>::next_layer_type>::value,
+            "SyncStream requirements not met");
+    using beast::detail::clamp;
+    using boost::asio::buffer;
+    close_code::value code{};
+    if(! rd_.zframe)
+    {
+        detail::frame_header fh;
+        if(! read_data_fh(fh, code, ec))
+        {
+            if(! ec)
+                read_close(code, ec);
+            return;
+        }
+        fi.op = rd_.op;
+        fi.fin = fh.fin;
+        if(! pmd_ || ! pmd_->rd_set || dst.pmd_relay(*this))
+        {
+            detail::frame_header wfh;
+            detail::prepared_key key;
+            auto const mask = dst.wr_relay(fh, wfh, key);
+            detail::fh_streambuf fh_buf;
+            detail::write<static_streambuf>(fh_buf, wfh);
+            auto remain = fh.len;
+            if(remain == 0)
+            {
+                boost::asio::write(
+                    dst.stream_, fh_buf.data(), ec);
+                dst.failed_ = ec != 0;
+                return;
+            }
+            auto const size = clamp(remain, rd_buf_size_);
+            auto const buf = detail::make_pooled_buffer(size);
+            while(remain > 0)
+            {
+                auto const n = stream_.read_some(
+                    buffer(buf.get(), clamp(remain, size)), ec);
+                if(! ec)
+                {
+                    remain -= n;
+                    auto const b = buffer(buf.get(), n);
+                    if(mask)
+                        detail::mask_inplace(b, key);
+                    boost::asio::write(dst.stream_,
+                        buffer_cat(fh_buf.data(), b), ec);
+                }
+                if(ec)
+                {
+                    // A frame left unfinished can't be continued
+                    failed_ = true;
+                    dst.failed_ = true;
+                    return;
+                }
+                fh_buf.reset();
+            }
+            return;
+        }
+        // Inflate the payload, and send it as a
+        // message of the other stream, in pieces
+        if(fh.op != opcode::cont)
+            rd_begin();
+        rd_zbegin(fh);
+        rd_.zlimit = rd_buf_size_;
+    }
+    if(! dst.wr_.cont && ! dst.wr_.pending)
+        dst.wr_opcode_ = rd_.op;
+    streambuf db;
+    while(rd_.zframe)
+    {
+        read_inflate(db, code, ec);
+        if(ec)
+            return;
+        if(code != close_code::none)
+            return read_close(code, ec);
+        fi.op = rd_.op;
+        fi.fin = rd_.fin && ! rd_.zframe;
+        if(db.size() > 0 || fi.fin)
+        {
+            dst.write_frame(fi.fin, db.data(), ec);
+            if(ec)
+                return;
+            db.consume(db.size());
+        }
+    }
+}
+
+} // websocket
+} // beast
+
+#endif
@@ -38,6 +38,9 @@ stream<NextLayer>::
 stream(Args&&... args)
     : stream_(std::forward<Args>(args)...)
 {
+    // The strand needs an io_service
+    strand_init(std::integral_constant<bool,
+        is_AsyncStream<next_layer_type>::value>{});
 }
 
 template<class NextLayer>
@@ -73,8 +76,11 @@ reset()
 {
     failed_ = false;
     rd_.cont = false;
+    rd_.zframe = false;
     wr_close_ = false;
     wr_.cont = false;
+    wr_.pending = false;
+    wr_.active = false;
     wr_block_ = nullptr;    // should be nullptr on close anyway
     ping_data_ = nullptr;   // should be nullptr on close anyway
 
@@ -82,6 +88,18 @@ reset()
         stream_.buffer().size());
 }
 
+template<class NextLayer>
+void
+stream<NextLayer>::
+open(detail::role_type role)
+{
+    stream_base::open(role);
+    // The timer needs an io_service
+    if(idle_timeout_.count() > 0)
+        idle_start(std::integral_constant<bool,
+            is_AsyncStream<next_layer_type>::value>{});
+}
+
 template<class NextLayer>
 http::request<http::empty_body>
 stream<NextLayer>::
@@ -218,9 +236,9 @@ do_response(http::response<Body, Fields> const& res,
         return fail();
     detail::pmd_offer offer;
     pmd_read(offer, res.fields);
-    // VFALCO see if offer satisfies pmd_config_,
-    //        return an error if not.
-    pmd_config_ = offer; // overwrite for now
+    if(! detail::pmd_check(offer, pmd_opts_))
+        return fail();
+    pmd_config_ = offer;
     open(detail::role_type::client);
 }
 
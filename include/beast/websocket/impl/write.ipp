@@ -19,9 +19,14 @@
 #include <beast/core/stream_concepts.hpp>
 #include <beast/core/detail/clamp.hpp>
 #include <beast/websocket/detail/frame.hpp>
+#include <beast/websocket/detail/worker_pool.hpp>
 #include <boost/assert.hpp>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <new>
+#include <vector>
 
 namespace beast {
 namespace websocket {
@@ -37,27 +42,59 @@ class stream<NextLayer>::write_frame_op
         stream<NextLayer>& ws;
         consuming_buffers<Buffers> cb;
         bool fin;
+        bool inplace;
         detail::frame_header fh;
         detail::fh_streambuf fh_buf;
         detail::prepared_key key;
         std::uint64_t remain;
+        std::chrono::steady_clock::time_point when;
+        std::vector<std::uint8_t> zbuf;
+        std::size_t zoff = 0;
+        bool compressed = false;
+        error_code zec;
         int state = 0;
         int entry_state;
 
         data(Handler& handler_, stream<NextLayer>& ws_,
-                bool fin_, Buffers const& bs)
+                bool fin_, Buffers const& bs,
+                    bool inplace_ = false)
             : handler(handler_)
             , cont(beast_asio_helpers::
                 is_continuation(handler))
             , ws(ws_)
             , cb(bs)
             , fin(fin_)
+            , inplace(inplace_)
         {
         }
     };
 
     handler_ptr<data, Handler> d_;
 
+    // Compresses the message on a worker thread, then
+    // resumes the operation on the stream's io_service.
+    class offload_job
+    {
+        write_frame_op op_;
+        boost::asio::io_service::work work_;
+
+    public:
+        explicit
+        offload_job(write_frame_op&& op)
+            : op_(std::move(op))
+            , work_(op_.d_->ws.get_io_service())
+        {
+        }
+
+        void
+        operator()()
+        {
+            op_.deflate_all();
+            auto& ios = op_.d_->ws.get_io_service();
+            ios.post(std::move(op_));
+        }
+    };
+
 public:
     write_frame_op(write_frame_op&&) = default;
     write_frame_op(write_frame_op const&) = default;
@@ -87,6 +124,10 @@ public:
     void operator()(error_code ec,
         std::size_t bytes_transferred, bool again);
 
+private:
+    void deflate_all();
+
+public:
     friend
     void* asio_handler_allocate(
         std::size_t size, write_frame_op* op)
@@ -118,6 +159,44 @@ public:
     }
 };
 
+template<class NextLayer>
+template<class Buffers, class Handler>
+void
+stream<NextLayer>::
+write_frame_op<Buffers, Handler>::
+deflate_all()
+{
+    using boost::asio::buffer_size;
+    auto& d = *d_;
+    // The output buffer grows geometrically, starting from
+    // a guess at the compressed size of the whole message.
+    std::size_t size = (std::max<std::size_t>)(
+        4096, buffer_size(d.cb) / 4);
+    // This runs on a worker thread, where an exception
+    // cannot reach the caller, so it becomes the error.
+    try
+    {
+        for(;;)
+        {
+            auto const n = d.zbuf.size();
+            d.zbuf.resize(size);
+            boost::asio::mutable_buffer b{
+                &d.zbuf[n], size - n};
+            auto const more = detail::deflate(
+                *d.ws.pmd_->zo, b, d.cb, true, d.zec);
+            d.zbuf.resize(n + buffer_size(b));
+            if(d.zec || ! more)
+                break;
+            size = 2 * size;
+        }
+    }
+    catch(std::bad_alloc const&)
+    {
+        d.zec = errc::make_error_code(
+            errc::not_enough_memory);
+    }
+}
+
 template<class NextLayer>
 template<class Buffers, class Handler>
 void
@@ -151,6 +230,7 @@ operator()(error_code ec,
         do_mask_nofrag = 40,
         do_mask_frag = 50,
         do_deflate = 60,
+        do_offload = 70,
         do_maybe_suspend = 80,
         do_upcall = 99
     };
@@ -165,7 +245,8 @@ operator()(error_code ec,
         case do_init:
             if(! d.ws.wr_.cont)
             {
-                d.ws.wr_begin();
+                if(! d.ws.wr_.pending)
+                    d.ws.wr_begin(d.cb, d.fin, d.inplace);
                 d.fh.rsv1 = d.ws.wr_.compress;
             }
             else
@@ -185,10 +266,21 @@ operator()(error_code ec,
             // the resume.
             if(d.ws.wr_.compress)
             {
-                d.entry_state = do_deflate;
+                // Large messages sent whole are
+                // compressed on a worker thread.
+                auto const threshold =
+                    d.ws.pmd_opts_.offload_threshold;
+                if(threshold != 0 && d.fin &&
+                    ! d.ws.wr_.cont && ! d.ws.wr_.pending &&
+                        buffer_size(d.cb) >= threshold)
+                    d.entry_state = do_offload;
+                else
+                    d.entry_state = do_deflate;
             }
-            else if(! d.fh.mask)
+            else if(! d.fh.mask || d.inplace)
             {
+                // Payloads masked in place
+                // are sent like unmasked ones.
                 if(! d.ws.wr_.autofrag)
                 {
                     d.entry_state = do_nomask_nofrag;
@@ -197,7 +289,7 @@ operator()(error_code ec,
                 {
                     BOOST_ASSERT(d.ws.wr_.buf_size != 0);
                     d.remain = buffer_size(d.cb);
-                    if(d.remain > d.ws.wr_.buf_size)
+                    if(d.remain > d.ws.wr_frag_size())
                         d.entry_state = do_nomask_frag;
                     else
                         d.entry_state = do_nomask_nofrag;
@@ -213,7 +305,7 @@ operator()(error_code ec,
                 {
                     BOOST_ASSERT(d.ws.wr_.buf_size != 0);
                     d.remain = buffer_size(d.cb);
-                    if(d.remain > d.ws.wr_.buf_size)
+                    if(d.remain > d.ws.wr_frag_size())
                         d.entry_state = do_mask_frag;
                     else
                         d.entry_state = do_mask_nofrag;
@@ -234,6 +326,13 @@ operator()(error_code ec,
             BOOST_ASSERT(d.ws.wr_block_ == &d);
             d.fh.fin = d.fin;
             d.fh.len = buffer_size(d.cb);
+            if(d.fh.mask)
+            {
+                d.fh.key = d.ws.maskgen_();
+                detail::prepare_key(d.key, d.fh.key);
+                detail::mask_inplace(d.cb, d.key,
+                    is_MutableBufferSequence<Buffers>{});
+            }
             detail::write<static_streambuf>(
                 d.fh_buf, d.fh);
             d.ws.wr_.cont = ! d.fin;
@@ -256,13 +355,21 @@ operator()(error_code ec,
         {
             BOOST_ASSERT(d.ws.wr_block_ == &d);
             auto const n = clamp(
-                d.remain, d.ws.wr_.buf_size);
+                d.remain, d.ws.wr_frag_size());
             d.remain -= n;
             d.fh.len = n;
             d.fh.fin = d.fin ? d.remain == 0 : false;
+            if(d.fh.mask)
+            {
+                d.fh.key = d.ws.maskgen_();
+                detail::prepare_key(d.key, d.fh.key);
+                detail::mask_inplace(prepare_buffers(n, d.cb),
+                    d.key, is_MutableBufferSequence<Buffers>{});
+            }
             detail::write<static_streambuf>(
                 d.fh_buf, d.fh);
             d.ws.wr_.cont = ! d.fin;
+            d.when = std::chrono::steady_clock::now();
             // Send frame
             d.state = d.remain == 0 ?
                 do_upcall : do_nomask_frag + 2;
@@ -276,6 +383,9 @@ operator()(error_code ec,
         case do_nomask_frag + 2:
             d.cb.consume(
                 bytes_transferred - d.fh_buf.size());
+            if(d.ws.wr_latency_.count() > 0)
+                d.ws.wr_adapt(bytes_transferred,
+                    std::chrono::steady_clock::now() - d.when);
             d.fh_buf.reset();
             d.fh.op = opcode::cont;
             if(d.ws.wr_block_ == &d)
@@ -356,7 +466,7 @@ operator()(error_code ec,
         {
             BOOST_ASSERT(d.ws.wr_block_ == &d);
             auto const n = clamp(
-                d.remain, d.ws.wr_.buf_size);
+                d.remain, d.ws.wr_frag_size());
             d.remain -= n;
             d.fh.len = n;
             d.fh.key = d.ws.maskgen_();
@@ -369,6 +479,7 @@ operator()(error_code ec,
             detail::write<static_streambuf>(
                 d.fh_buf, d.fh);
             d.ws.wr_.cont = ! d.fin;
+            d.when = std::chrono::steady_clock::now();
             // Send frame
             d.state = d.remain == 0 ?
                 do_upcall : do_mask_frag + 2;
@@ -381,6 +492,9 @@ operator()(error_code ec,
         case do_mask_frag + 2:
             d.cb.consume(
                 bytes_transferred - d.fh_buf.size());
+            if(d.ws.wr_latency_.count() > 0)
+                d.ws.wr_adapt(bytes_transferred,
+                    std::chrono::steady_clock::now() - d.when);
             d.fh_buf.reset();
             d.fh.op = opcode::cont;
             BOOST_ASSERT(d.ws.wr_block_ == &d);
@@ -411,7 +525,7 @@ operator()(error_code ec,
             auto b = buffer(d.ws.wr_.buf.get(),
                 d.ws.wr_.buf_size);
             auto const more = detail::deflate(
-                d.ws.pmd_->zo, b, d.cb, d.fin, ec);
+                *d.ws.pmd_->zo, b, d.cb, d.fin, ec);
             d.ws.failed_ = ec != 0;
             if(d.ws.failed_)
                 goto upcall;
@@ -423,6 +537,7 @@ operator()(error_code ec,
                 // latency.
                 BOOST_ASSERT(! d.fin);
                 BOOST_ASSERT(buffer_size(d.cb) == 0);
+                d.ws.wr_.pending = ! d.ws.wr_.cont;
 
                 // We can skip the dispatch if the
                 // asynchronous initiation function is
@@ -444,9 +559,10 @@ operator()(error_code ec,
             detail::fh_streambuf fh_buf;
             detail::write<static_streambuf>(fh_buf, d.fh);
             d.ws.wr_.cont = ! d.fin;
+            d.ws.wr_.pending = false;
             // Send frame
             d.state = more ?
-                do_deflate + 2 : do_deflate + 3;
+                do_deflate + 2 : do_upcall;
             boost::asio::async_write(d.ws.stream_,
                 buffer_cat(fh_buf.data(), b),
                     std::move(*this));
@@ -471,14 +587,86 @@ operator()(error_code ec,
             d.state = d.entry_state;
             break;
 
-        case do_deflate + 3:
-            if(d.fh.fin && (
-                (d.ws.role_ == detail::role_type::client &&
-                    d.ws.pmd_config_.client_no_context_takeover) ||
-                (d.ws.role_ == detail::role_type::server &&
-                    d.ws.pmd_config_.server_no_context_takeover)))
-                d.ws.pmd_->zo.reset();
-            goto upcall;
+        //----------------------------------------------------------------------
+
+        case do_offload:
+            BOOST_ASSERT(! d.ws.wr_block_);
+            d.ws.wr_block_ = &d;
+            // [[fallthrough]]
+
+        case do_offload + 1:
+        {
+            BOOST_ASSERT(d.ws.wr_block_ == &d);
+            if(! d.compressed)
+            {
+                // The stream stays blocked for writing
+                // while the message is compressed, which
+                // keeps messages and the deflate state
+                // in order.
+                d.state = do_offload + 2;
+                detail::worker_pool::instance().post(
+                    offload_job{std::move(*this)});
+                return;
+            }
+            auto const remain = d.zbuf.size() - d.zoff;
+            auto const n = d.ws.wr_.autofrag ?
+                clamp(remain, d.ws.wr_frag_size()) : remain;
+            auto const b = buffer(&d.zbuf[d.zoff], n);
+            d.zoff += n;
+            if(d.fh.mask)
+            {
+                d.fh.key = d.ws.maskgen_();
+                detail::prepare_key(d.key, d.fh.key);
+                detail::mask_inplace(b, d.key);
+            }
+            d.fh.fin = d.zoff == d.zbuf.size();
+            d.fh.len = n;
+            detail::write<static_streambuf>(
+                d.fh_buf, d.fh);
+            d.ws.wr_.cont = false;
+            d.when = std::chrono::steady_clock::now();
+            // Send frame
+            d.state = d.fh.fin ?
+                do_upcall : do_offload + 3;
+            boost::asio::async_write(d.ws.stream_,
+                buffer_cat(d.fh_buf.data(), b),
+                    std::move(*this));
+            return;
+        }
+
+        case do_offload + 2:
+            // Back on the io_service
+            d.compressed = true;
+            if(d.zec)
+            {
+                d.ws.failed_ = true;
+                ec = d.zec;
+                goto upcall;
+            }
+            d.state = do_offload + 1;
+            break;
+
+        case do_offload + 3:
+            if(d.ws.wr_latency_.count() > 0)
+                d.ws.wr_adapt(bytes_transferred,
+                    std::chrono::steady_clock::now() - d.when);
+            d.fh_buf.reset();
+            d.fh.op = opcode::cont;
+            d.fh.rsv1 = false;
+            BOOST_ASSERT(d.ws.wr_block_ == &d);
+            d.ws.wr_block_ = nullptr;
+            // Allow outgoing control frames to
+            // be sent in between message frames:
+            if(d.ws.rd_op_.maybe_invoke() ||
+                d.ws.ping_op_.maybe_invoke())
+            {
+                d.state = do_maybe_suspend;
+                d.ws.get_io_service().post(
+                    std::move(*this));
+                return;
+            }
+            d.state = d.entry_state;
+            break;
 
         //----------------------------------------------------------------------
 
@@ -538,6 +726,8 @@ operator()(error_code ec,
 upcall:
     if(d.ws.wr_block_ == &d)
         d.ws.wr_block_ = nullptr;
+    if(d.fin)
+        d.ws.wr_done();
     d.ws.rd_op_.maybe_invoke() ||
         d.ws.ping_op_.maybe_invoke();
     d_.invoke(ec);
@@ -601,7 +791,8 @@ write_frame(bool fin,
     detail::frame_header fh;
     if(! wr_.cont)
     {
-        wr_begin();
+        if(! wr_.pending)
+            wr_begin(buffers, fin);
         fh.rsv1 = wr_.compress;
     }
     else
@@ -622,7 +813,7 @@ write_frame(bool fin,
             auto b = buffer(
                 wr_.buf.get(), wr_.buf_size);
             auto const more = detail::deflate(
-                pmd_->zo, b, cb, fin, ec);
+                *pmd_->zo, b, cb, fin, ec);
             failed_ = ec != 0;
             if(failed_)
                 return;
@@ -634,6 +825,7 @@ write_frame(bool fin,
                 // latency.
                 BOOST_ASSERT(! fin);
                 BOOST_ASSERT(buffer_size(cb) == 0);
+                wr_.pending = ! wr_.cont;
                 fh.fin = false;
                 break;
             }
@@ -649,6 +841,7 @@ write_frame(bool fin,
             detail::fh_streambuf fh_buf;
             detail::write<static_streambuf>(fh_buf, fh);
             wr_.cont = ! fin;
+            wr_.pending = false;
             boost::asio::write(stream_,
                 buffer_cat(fh_buf.data(), b), ec);
             failed_ = ec != 0;
@@ -659,12 +852,8 @@ write_frame(bool fin,
             fh.op = opcode::cont;
             fh.rsv1 = false;
         }
-        if(fh.fin && (
-            (role_ == detail::role_type::client &&
-                pmd_config_.client_no_context_takeover) ||
-            (role_ == detail::role_type::server &&
-                pmd_config_.server_no_context_takeover)))
-            pmd_->zo.reset();
+        if(fin)
+            wr_done();
         return;
     }
     if(! fh.mask)
@@ -751,6 +940,8 @@ write_frame(bool fin,
             if(failed_)
                 return;
         }
+        if(fin)
+            wr_done();
         return;
     }
     {
@@ -772,6 +963,7 @@ write_frame(bool fin,
             fh.fin = fin ? remain == 0 : false;
             detail::fh_streambuf fh_buf;
             detail::write<static_streambuf>(fh_buf, fh);
+            wr_.cont = ! fin;
             boost::asio::write(stream_,
                 buffer_cat(fh_buf.data(), b), ec);
             failed_ = ec != 0;
@@ -782,6 +974,8 @@ write_frame(bool fin,
             fh.op = opcode::cont;
             cb.consume(n);
         }
+        if(fin)
+            wr_done();
         return;
     }
 }
@@ -912,6 +1106,26 @@ async_write(ConstBufferSequence const& bs, WriteHandler&& handler)
     return completion.result.get();
 }
 
+template<class NextLayer>
+template<class ConstBufferSequence, class WriteHandler>
+typename async_completion<
+    WriteHandler, void(error_code)>::result_type
+stream<NextLayer>::
+async_write(ConstBufferSequence const& bs,
+    compression c, WriteHandler&& handler)
+{
+    static_assert(is_AsyncStream<next_layer_type>::value,
+        "AsyncStream requirements not met");
+    static_assert(beast::is_ConstBufferSequence<
+        ConstBufferSequence>::value,
+            "ConstBufferSequence requirements not met");
+    // Consumed when the operation begins the message
+    if(! wr_.cont && ! wr_.pending)
+        wr_compress_ = c;
+    return async_write(bs,
+        std::forward<WriteHandler>(handler));
+}
+
 template<class NextLayer>
 template<class ConstBufferSequence>
 void
@@ -943,6 +1157,408 @@ write(ConstBufferSequence const& buffers, error_code& ec)
     write_frame(true, buffers, ec);
 }
 
+template<class NextLayer>
+template<class ConstBufferSequence>
+void
+stream<NextLayer>::
+write(ConstBufferSequence const& buffers, compression c)
+{
+    static_assert(is_SyncStream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(beast::is_ConstBufferSequence<
+        ConstBufferSequence>::value,
+            "ConstBufferSequence requirements not met");
+    error_code ec;
+    write(buffers, c, ec);
+    if(ec)
+        throw system_error{ec};
+}
+
+template<class NextLayer>
+template<class ConstBufferSequence>
+void
+stream<NextLayer>::
+write(ConstBufferSequence const& buffers,
+    compression c, error_code& ec)
+{
+    static_assert(is_SyncStream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(beast::is_ConstBufferSequence<
+        ConstBufferSequence>::value,
+            "ConstBufferSequence requirements not met");
+    // Consumed when the message begins
+    if(! wr_.cont && ! wr_.pending)
+        wr_compress_ = c;
+    write_frame(true, buffers, ec);
+}
+
+template<class NextLayer>
+template<class MutableBufferSequence>
+void
+stream<NextLayer>::
+write_inplace(MutableBufferSequence const& buffers)
+{
+    static_assert(is_SyncStream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(beast::is_MutableBufferSequence<
+        MutableBufferSequence>::value,
+            "MutableBufferSequence requirements not met");
+    error_code ec;
+    write_inplace(buffers, ec);
+    if(ec)
+        throw system_error{ec};
+}
+
+template<class NextLayer>
+template<class MutableBufferSequence>
+void
+stream<NextLayer>::
+write_inplace(MutableBufferSequence const& buffers,
+    error_code& ec)
+{
+    static_assert(is_SyncStream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(beast::is_MutableBufferSequence<
+        MutableBufferSequence>::value,
+            "MutableBufferSequence requirements not met");
+    using beast::detail::clamp;
+    using boost::asio::buffer_size;
+    if(role_ != detail::role_type::client ||
+        wr_.cont || wr_.pending)
+    {
+        write_frame(true, buffers, ec);
+        return;
+    }
+    wr_begin(buffers, true, true);
+    if(! wr_.inplace)
+    {
+        // The compressed message has begun,
+        // as if its first frame were held back.
+        wr_.pending = true;
+        write_frame(true, buffers, ec);
+        return;
+    }
+    detail::frame_header fh;
+    fh.op = wr_opcode_;
+    fh.rsv1 = false;
+    fh.rsv2 = false;
+    fh.rsv3 = false;
+    fh.mask = true;
+    auto remain = buffer_size(buffers);
+    consuming_buffers<
+        MutableBufferSequence> cb{buffers};
+    for(;;)
+    {
+        auto const n = wr_.autofrag ?
+            clamp(remain, wr_.buf_size) : remain;
+        remain -= n;
+        fh.len = n;
+        fh.fin = remain == 0;
+        fh.key = maskgen_();
+        detail::prepared_key key;
+        detail::prepare_key(key, fh.key);
+        auto const pb = prepare_buffers(n, cb);
+        detail::mask_inplace(pb, key);
+        detail::fh_streambuf fh_buf;
+        detail::write<static_streambuf>(fh_buf, fh);
+        wr_.cont = ! fh.fin;
+        boost::asio::write(stream_,
+            buffer_cat(fh_buf.data(), pb), ec);
+        failed_ = ec != 0;
+        if(failed_)
+            return;
+        if(remain == 0)
+            break;
+        fh.op = opcode::cont;
+        cb.consume(n);
+    }
+    wr_done();
+}
+
+template<class NextLayer>
+template<class MutableBufferSequence, class WriteHandler>
+typename async_completion<
+    WriteHandler, void(error_code)>::result_type
+stream<NextLayer>::
+async_write_inplace(MutableBufferSequence const& bs,
+    WriteHandler&& handler)
+{
+    static_assert(is_AsyncStream<next_layer_type>::value,
+        "AsyncStream requirements not met");
+    static_assert(beast::is_MutableBufferSequence<
+        MutableBufferSequence>::value,
+            "MutableBufferSequence requirements not met");
+    beast::async_completion<
+        WriteHandler, void(error_code)> completion{handler};
+    write_frame_op<MutableBufferSequence, decltype(
+        completion.handler)>{completion.handler,
+            *this, true, bs, true};
+    return completion.result.get();
+}
+
+//------------------------------------------------------------------------------
+
+// write a prepared message
+//
+template<class NextLayer>
+template<class Handler>
+class stream<NextLayer>::write_prepared_op
+{
+    struct data : op
+    {
+        bool cont;
+        stream<NextLayer>& ws;
+        prepared_message msg;
+        detail::fh_streambuf fh_buf;
+        detail::pooled_buffer buf;
+        prepared_message::const_buffers_type bs;
+        int state = 0;
+
+        data(Handler& handler, stream<NextLayer>& ws_,
+                prepared_message const& msg_)
+            : cont(beast_asio_helpers::
+                is_continuation(handler))
+            , ws(ws_)
+            , msg(msg_)
+            , bs(ws.prepare_frame(msg, fh_buf, buf))
+        {
+        }
+    };
+
+    handler_ptr<data, Handler> d_;
+
+public:
+    write_prepared_op(write_prepared_op&&) = default;
+    write_prepared_op(write_prepared_op const&) = default;
+
+    template<class DeducedHandler, class... Args>
+    write_prepared_op(DeducedHandler&& h,
+            stream<NextLayer>& ws, Args&&... args)
+        : d_(std::forward<DeducedHandler>(h),
+            ws, std::forward<Args>(args)...)
+    {
+        (*this)(error_code{}, false);
+    }
+
+    void operator()()
+    {
+        (*this)(error_code{});
+    }
+
+    void operator()(error_code ec, std::size_t);
+
+    void operator()(error_code ec, bool again = true);
+
+    friend
+    void* asio_handler_allocate(
+        std::size_t size, write_prepared_op* op)
+    {
+        return beast_asio_helpers::
+            allocate(size, op->d_.handler());
+    }
+
+    friend
+    void asio_handler_deallocate(
+        void* p, std::size_t size, write_prepared_op* op)
+    {
+        return beast_asio_helpers::
+            deallocate(p, size, op->d_.handler());
+    }
+
+    friend
+    bool asio_handler_is_continuation(write_prepared_op* op)
+    {
+        return op->d_->cont;
+    }
+
+    template<class Function>
+    friend
+    void asio_handler_invoke(Function&& f, write_prepared_op* op)
+    {
+        return beast_asio_helpers::
+            invoke(f, op->d_.handler());
+    }
+};
+
+template<class NextLayer>
+template<class Handler>
+void
+stream<NextLayer>::write_prepared_op<Handler>::
+operator()(error_code ec, std::size_t)
+{
+    auto& d = *d_;
+    if(ec)
+        d.ws.failed_ = true;
+    (*this)(ec);
+}
+
+template<class NextLayer>
+template<class Handler>
+void
+stream<NextLayer>::
+write_prepared_op<Handler>::
+operator()(error_code ec, bool again)
+{
+    auto& d = *d_;
+    d.cont = d.cont || again;
+    if(ec)
+        goto upcall;
+    for(;;)
+    {
+        switch(d.state)
+        {
+        case 0:
+            if(d.ws.wr_block_)
+            {
+                // suspend
+                d.state = 2;
+                d.ws.wr_op_.template emplace<
+                    write_prepared_op>(std::move(*this));
+                return;
+            }
+            if(d.ws.failed_ || d.ws.wr_close_)
+            {
+                // call handler
+                d.state = 99;
+                d.ws.get_io_service().post(
+                    bind_handler(std::move(*this),
+                        boost::asio::error::operation_aborted));
+                return;
+            }
+            d.ws.wr_block_ = &d;
+            // [[fallthrough]]
+
+        case 1:
+            // send the frame
+            BOOST_ASSERT(d.ws.wr_block_ == &d);
+            d.state = 99;
+            boost::asio::async_write(d.ws.stream_,
+                d.bs, std::move(*this));
+            return;
+
+        case 2:
+            BOOST_ASSERT(! d.ws.wr_block_);
+            d.ws.wr_block_ = &d;
+            d.state = 3;
+            // The current context is safe but might not be
+            // the same as the one for this operation (since
+            // we are being called from a write operation).
+            // Call post to make sure we are invoked the same
+            // way as the final handler for this operation.
+            d.ws.get_io_service().post(
+                bind_handler(std::move(*this), ec));
+            return;
+
+        case 3:
+            BOOST_ASSERT(d.ws.wr_block_ == &d);
+            if(d.ws.failed_ || d.ws.wr_close_)
+            {
+                // call handler
+                ec = boost::asio::error::operation_aborted;
+                goto upcall;
+            }
+            d.state = 1;
+            break;
+
+        case 99:
+            goto upcall;
+        }
+    }
+upcall:
+    if(d.ws.wr_block_ == &d)
+        d.ws.wr_block_ = nullptr;
+    d.ws.rd_op_.maybe_invoke() ||
+        d.ws.ping_op_.maybe_invoke();
+    d_.invoke(ec);
+}
+
+template<class NextLayer>
+template<class WriteHandler>
+typename async_completion<
+    WriteHandler, void(error_code)>::result_type
+stream<NextLayer>::
+async_write_prepared(prepared_message const& msg,
+    WriteHandler&& handler)
+{
+    static_assert(is_AsyncStream<next_layer_type>::value,
+        "AsyncStream requirements not met");
+    beast::async_completion<
+        WriteHandler, void(error_code)
+            > completion{handler};
+    write_prepared_op<decltype(completion.handler)>{
+        completion.handler, *this, msg};
+    return completion.result.get();
+}
+
+template<class NextLayer>
+void
+stream<NextLayer>::
+write_prepared(prepared_message const& msg)
+{
+    static_assert(is_SyncStream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    error_code ec;
+    write_prepared(msg, ec);
+    if(ec)
+        throw system_error{ec};
+}
+
+template<class NextLayer>
+void
+stream<NextLayer>::
+write_prepared(prepared_message const& msg, error_code& ec)
+{
+    static_assert(is_SyncStream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    detail::fh_streambuf fh_buf;
+    detail::pooled_buffer buf;
+    boost::asio::write(stream_,
+        prepare_frame(msg, fh_buf, buf), ec);
+    failed_ = ec != 0;
+}
+
+template<class NextLayer>
+auto
+stream<NextLayer>::
+prepare_frame(prepared_message const& msg,
+    detail::fh_streambuf& fh_buf, detail::pooled_buffer& buf) ->
+        prepared_message::const_buffers_type
+{
+    using boost::asio::buffer;
+    using boost::asio::buffer_copy;
+    using boost::asio::buffer_size;
+    // A prepared message is always a whole message
+    BOOST_ASSERT(! wr_.cont && ! wr_.pending);
+    // The compressed form refers to no earlier messages,
+    // so it can only be used without context takeover.
+    bool const deflated = msg.compressed() && pmd_ &&
+        pmd_wr_no_context_takeover() &&
+            msg.window_bits() <= pmd_wr_window_bits();
+    auto const bs = msg.frame(deflated);
+    if(role_ == detail::role_type::server)
+        return bs;
+
+    // Clients mask a copy of the payload
+    detail::frame_header fh;
+    fh.op = msg.type();
+    fh.fin = true;
+    fh.mask = true;
+    fh.rsv1 = deflated;
+    fh.rsv2 = false;
+    fh.rsv3 = false;
+    fh.len = buffer_size(bs[1]);
+    fh.key = maskgen_();
+    detail::write<static_streambuf>(fh_buf, fh);
+    auto const n = buffer_size(bs[1]);
+    buf = detail::make_pooled_buffer(n);
+    auto const b = buffer(buf.get(), n);
+    buffer_copy(b, bs[1]);
+    detail::prepared_key key;
+    detail::prepare_key(key, fh.key);
+    detail::mask_inplace(b, key);
+    return {{*fh_buf.data().begin(), b}};
+}
+
 } // websocket
 } // beast
 
@@ -12,6 +12,7 @@
 #include <beast/websocket/detail/decorator.hpp>
 #include <beast/core/detail/type_traits.hpp>
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <stdexcept>
@@ -58,6 +59,48 @@ struct auto_fragment
 };
 #endif
 
+/** Control frame latency option.
+
+    Sets the longest time a ping, pong, or close frame should wait
+    behind a message being sent asynchronously. Control frames are
+    sent between the fragments of a message, so when this option is
+    set, outgoing messages are always fragmented. The fragment size
+    adapts to the rate at which the previous fragment was sent, so
+    that each fragment is expected to take no longer than the limit.
+    Fast connections get large fragments with little framing
+    overhead, and slow connections get small ones. Fragments of
+    masked payloads are no larger than the write buffer size.
+
+    The default setting is zero, which fragments messages, if the
+    @ref auto_fragment option is set, into pieces no larger than the
+    write buffer size.
+
+    @note Objects of this type are used with
+          @ref beast::websocket::stream::set_option.
+
+    @par Example
+    Setting the control frame latency option:
+    @code
+    ...
+    websocket::stream<ip::tcp::socket> stream(ios);
+    stream.set_option(control_latency{std::chrono::milliseconds(5)});
+    @endcode
+*/
+#if GENERATING_DOCS
+using control_latency = implementation_defined;
+#else
+struct control_latency
+{
+    std::chrono::microseconds value;
+
+    explicit
+    control_latency(std::chrono::microseconds v)
+        : value(v)
+    {
+    }
+};
+#endif
+
 /** HTTP decorator option.
 
     The decorator transforms the HTTP requests and responses used
@@ -108,6 +151,60 @@ using decorate = implementation_defined;
 using decorate = detail::decorator_type;
 #endif
 
+/** Idle timeout option.
+
+    Sets how long an open stream may go without receiving anything
+    from the remote peer. Half way through a silent period the stream
+    sends a ping, to which a healthy peer answers with a pong. If the
+    silence lasts for the whole timeout, the stream fails and the
+    lowest layer is closed, which completes pending asynchronous
+    operations with an error.
+
+    Every frame received counts as activity, whether or not a read
+    delivers it to the caller, but frames are only received while
+    an asynchronous read is pending. The timer runs on the
+    io_service of the next layer, so this option requires an
+    @b AsyncStream, and it takes effect when the stream is opened
+    by a handshake or accept.
+
+    The stream keeps one timer, which is not restarted for each
+    frame received, and sending the keepalive ping uses no storage
+    beyond that of the stream. The timer and the keepalive ping are
+    not operations started by the caller, so the stream may be
+    destroyed while they are pending, once the caller's own
+    operations have completed. Their handlers run in the strand
+    returned by @ref beast::websocket::stream::get_strand, which
+    the program must also use when the io_service is run by more
+    than one thread.
+
+    The default setting is zero, which disables the timeout.
+
+    @note Objects of this type are used with
+          @ref beast::websocket::stream::set_option.
+
+    @par Example
+    Setting the idle timeout option:
+    @code
+    ...
+    websocket::stream<ip::tcp::socket> stream(ios);
+    stream.set_option(idle_timeout{std::chrono::seconds(30)});
+    @endcode
+*/
+#if GENERATING_DOCS
+using idle_timeout = implementation_defined;
+#else
+struct idle_timeout
+{
+    std::chrono::milliseconds value;
+
+    explicit
+    idle_timeout(std::chrono::milliseconds v)
+        : value(v)
+    {
+    }
+};
+#endif
+
 /** Keep-alive option.
 
     Determines if the connection is closed after a failed upgrade
@@ -210,27 +307,110 @@ struct permessage_deflate
 
     /** Maximum server window bits to offer
 
+        A server compresses with at most this window, and tells the
+        client when it is smaller than 15. A client asks the server
+        to stay within it, and fails the handshake if the server's
+        response does not. If the client asks for a window of 8 bits,
+        the server accepts, but sends its messages uncompressed.
+
+        The memory for each compression state grows with the window.
+        With the default `memLevel`, a deflate stream needs about
+        10KB at 9 bits and 136KB at 15 bits, while an inflate stream
+        needs a window of 512 bytes at 9 bits and 32KB at 15 bits.
+
         @note Due to a bug in ZLib, this value must be greater than 8.
     */
     int server_max_window_bits = 15;
 
     /** Maximum client window bits to offer
 
+        A client compresses with at most this window. A server asks
+        clients to stay within it, which lets it inflate with a
+        smaller window. Clients which do not offer to limit their
+        window are refused the extension unless this is 15.
+
         @note Due to a bug in ZLib, this value must be greater than 8.
     */
     int client_max_window_bits = 15;
 
-    /// `true` if server_no_context_takeover desired
+    /** `true` if server_no_context_takeover desired
+
+        Without context takeover, the compression state for messages
+        sent by the server is only held while a message is in
+        progress, and is otherwise kept in a per-thread pool.
+    */
     bool server_no_context_takeover = false;
 
-    /// `true` if client_no_context_takeover desired
+    /** `true` if client_no_context_takeover desired
+
+        Without context takeover, the compression state for messages
+        sent by the client is only held while a message is in
+        progress, and is otherwise kept in a per-thread pool.
+    */
     bool client_no_context_takeover = false;
 
     /// Deflate compression level 0..9
     int compLevel = 8;
 
-    /// Deflate memory level, 1..9
+    /** Deflate memory level, 1..9
+
+        This bounds the memory used by the hash table and pending
+        output of each deflate state, at the cost of compression.
+    */
     int memLevel = 4;
+
+    /** Messages smaller than this many bytes are sent uncompressed.
+
+        Deflate rarely makes short messages any smaller, so sending
+        them as they are saves the processing. This only applies to
+        messages sent whole, since the size of a message sent in
+        fragments is not known when it begins. Zero compresses every
+        message.
+    */
+    std::size_t msg_size_threshold = 0;
+
+    /** `true` to send messages that look incompressible uncompressed.
+
+        When set, the start of each message is sampled before it is
+        sent, and the message is sent uncompressed if the sample is
+        close to random, as when the payload is already compressed or
+        encrypted.
+    */
+    bool sample_entropy = false;
+
+    /** Messages this many bytes or larger are compressed on a worker thread.
+
+        Compressing a large message can take long enough to delay
+        every other connection served by the same thread. When this
+        is not zero, a compressed message of at least this size sent
+        whole with an asynchronous write is deflated on a process-wide
+        pool of worker threads, and the resulting frames are sent from
+        the stream's io_service. Messages keep their order, and the
+        compression context carries over as usual. Synchronous writes
+        always compress on the calling thread. Zero disables this.
+    */
+    std::size_t offload_threshold = 0;
+};
+
+/** Compression choices for an outgoing message.
+
+    When the permessage-deflate extension is in effect, each message
+    is either compressed or sent as it is. This value may be passed
+    to @ref beast::websocket::stream::write or
+    @ref beast::websocket::stream::async_write to make that choice
+    for a single message. It has no effect when the extension is
+    not in effect.
+*/
+enum class compression : std::uint8_t
+{
+    /// Decide using the @ref permessage_deflate settings
+    automatic,
+
+    /// Compress the message
+    always,
+
+    /// Send the message uncompressed
+    never
 };
 
 /** Ping callback option.
@@ -335,6 +515,10 @@ struct read_buffer_size
     frame fields indicating a size that would bring the total
     message size over this limit will cause a protocol failure.
 
+    The limit applies to the size after decompression. Compressed
+    messages fail as soon as they inflate past the limit, before
+    the rest of the message is received.
+
     The default setting is 16 megabytes. A value of zero indicates
     a limit of the maximum value of a `std::uint64_t`.
 
@@ -364,6 +548,45 @@ struct read_message_max
 };
 #endif
 
+/** Decompressed read size option.
+
+    Sets the largest amount of decompressed data which one call
+    to read a frame delivers. A compressed frame which inflates to
+    more is handed to the caller in pieces of at most this size,
+    each reported with `frame_info::fin` set to `false` except the
+    last piece of the message. Together with the read buffer size,
+    this bounds the memory used to receive compressed messages by
+    callers which consume each piece as it arrives.
+
+    The default setting is zero, which delivers each compressed
+    frame whole.
+
+    @note Objects of this type are used with
+          @ref beast::websocket::stream::set_option.
+
+    @par Example
+    Delivering decompressed data 64KB at a time.
+    @code
+    ...
+    websocket::stream<ip::tcp::socket> ws(ios);
+    ws.set_option(read_inflate_limit{65536});
+    @endcode
+*/
+#if GENERATING_DOCS
+using read_inflate_limit = implementation_defined;
+#else
+struct read_inflate_limit
+{
+    std::size_t value;
+
+    explicit
+    read_inflate_limit(std::size_t n)
+        : value(n)
+    {
+    }
+};
+#endif
+
 /** Write buffer size option.
 
     Sets the size of the write buffer used by the implementation to
@@ -410,6 +633,43 @@ struct write_buffer_size
 };
 #endif
 
+/** Write queue limit option.
+
+    Sets the number of bytes which may wait in the outgoing message
+    queue used by @ref beast::websocket::stream::enqueue. When the
+    queue holds messages, a message which would bring the total over
+    this limit is refused, so that a slow peer can not cause the
+    sender to buffer without bound. A single message is always
+    accepted by an empty queue, whatever its size.
+
+    The default setting is 1 megabyte.
+
+    @note Objects of this type are used with
+          @ref beast::websocket::stream::set_option.
+
+    @par Example
+    Setting the write queue limit.
+    @code
+    ...
+    websocket::stream<ip::tcp::socket> ws(ios);
+    ws.set_option(write_queue_limit{256 * 1024});
+    @endcode
+*/
+#if GENERATING_DOCS
+using write_queue_limit = implementation_defined;
+#else
+struct write_queue_limit
+{
+    std::size_t value;
+
+    explicit
+    write_queue_limit(std::size_t n)
+        : value(n)
+    {
+    }
+};
+#endif
+
 } // websocket
 } // beast
 
@@ -0,0 +1,155 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_PREPARED_MESSAGE_HPP
+#define BEAST_WEBSOCKET_PREPARED_MESSAGE_HPP
+
+#include <beast/websocket/option.hpp>
+#include <beast/websocket/rfc6455.hpp>
+#include <boost/asio/buffer.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace beast {
+namespace websocket {
+
+/** A message framed once, for sending to many streams.
+
+    A prepared message holds a complete, unfragmented WebSocket
+    frame: the frame header followed by the payload. When constructed
+    with @ref permessage_deflate settings it also holds a compressed
+    frame, deflated once with a fresh compression context.
+
+    Sending a prepared message with @ref stream::write_prepared or
+    @ref stream::async_write_prepared gathers these bytes into the
+    socket without copying them, and without compressing them again.
+    A stream sends the compressed frame when the permessage-deflate
+    extension is in effect without context takeover in the direction
+    it sends, and the negotiated window for that direction is at least
+    as large as the one used to compress the message. Otherwise it
+    sends the frame uncompressed.
+
+    Frames sent by clients must be masked with a new key, so clients
+    copy the payload before sending it. Prepared messages are most
+    useful for servers.
+
+    Copies of a prepared message share the same immutable storage,
+    and may be used concurrently from multiple threads.
+*/
+class prepared_message
+{
+    struct impl
+    {
+        opcode op;
+        int window_bits;
+        std::size_t size;           // payload
+        std::size_t deflated_size;  // 0 if not compressed
+        std::uint8_t header[10];
+        std::uint8_t header_size;
+        std::uint8_t deflated_header[10];
+        std::uint8_t deflated_header_size;
+        std::unique_ptr<std::uint8_t[]> data;
+    };
+
+    std::shared_ptr<impl const> impl_;
+
+public:
+    /// The type of buffer sequence holding a frame
+    using const_buffers_type =
+        std::array<boost::asio::const_buffer, 2>;
+
+    /// Copy constructor
+    prepared_message(prepared_message const&) = default;
+
+    /// Copy assignment
+    prepared_message& operator=(prepared_message const&) = default;
+
+    /** Construct an uncompressed prepared message.
+
+        @param op The message opcode, which must be
+        @ref opcode::text or @ref opcode::binary.
+
+        @param buffers The message payload, which is copied.
+
+        @throws std::invalid_argument if the opcode is invalid.
+    */
+    template<class ConstBufferSequence>
+    prepared_message(opcode op,
+        ConstBufferSequence const& buffers);
+
+    /** Construct a prepared message, compressing it if enabled.
+
+        When `pmd.server_enable` is `true` the payload is also
+        compressed using `pmd.server_max_window_bits`, `pmd.compLevel`
+        and `pmd.memLevel`. The compressed form is discarded if it is
+        not smaller than the payload.
+
+        @param op The message opcode, which must be
+        @ref opcode::text or @ref opcode::binary.
+
+        @param buffers The message payload, which is copied.
+
+        @param pmd The compression settings.
+
+        @throws std::invalid_argument if the opcode is invalid.
+    */
+    template<class ConstBufferSequence>
+    prepared_message(opcode op,
+        ConstBufferSequence const& buffers,
+            permessage_deflate const& pmd);
+
+    /// Returns the message opcode
+    opcode
+    type() const
+    {
+        return impl_->op;
+    }
+
+    /// Returns the size of the uncompressed payload
+    std::size_t
+    size() const
+    {
+        return impl_->size;
+    }
+
+    /// Returns `true` if the message has a compressed form
+    bool
+    compressed() const
+    {
+        return impl_->deflated_size != 0;
+    }
+
+    /// Returns the window size used to compress the message
+    int
+    window_bits() const
+    {
+        return impl_->window_bits;
+    }
+
+    /** Returns the buffers holding a complete frame.
+
+        @param deflated `true` for the compressed frame, which
+        must exist.
+    */
+    const_buffers_type
+    frame(bool deflated) const;
+
+private:
+    template<class ConstBufferSequence>
+    void
+    construct(opcode op, ConstBufferSequence const& buffers,
+        permessage_deflate const* pmd);
+};
+
+} // websocket
+} // beast
+
+#include <beast/websocket/impl/prepared_message.ipp>
+
+#endif
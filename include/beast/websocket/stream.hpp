@@ -9,6 +9,7 @@
 #define BEAST_WEBSOCKET_STREAM_HPP
 
 #include <beast/websocket/option.hpp>
+#include <beast/websocket/prepared_message.hpp>
 #include <beast/websocket/detail/stream_base.hpp>
 #include <beast/http/message.hpp>
 #include <beast/http/string_body.hpp>
@@ -18,8 +19,11 @@
 #include <boost/asio.hpp>
 #include <boost/utility/string_ref.hpp>
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <limits>
+#include <memory>
+#include <vector>
 
 namespace beast {
 namespace websocket {
@@ -38,6 +42,20 @@ struct frame_info
     bool fin;
 };
 
+/** Information about a WebSocket message.
+
+    This information is provided to callers during batch
+    read operations, one for each message delivered.
+*/
+struct message_info
+{
+    /// Indicates the type of message (binary or text).
+    opcode op;
+
+    /// The number of bytes of message payload.
+    std::size_t size;
+};
+
 //--------------------------------------------------------------------
 
 /** Provides message-oriented functionality using WebSocket.
@@ -86,8 +104,22 @@ class stream : public detail::stream_base
 {
     friend class stream_test;
 
+    template<class>
+    friend class stream;
+
     dynabuf_readstream<NextLayer, streambuf> stream_;
 
+    using idle_timer_type = boost::asio::basic_waitable_timer<
+        std::chrono::steady_clock>;
+
+    // Created when the idle timeout is first used. Pending idle
+    // operations hold weak references, so that destroying the
+    // stream tells them it is gone.
+    std::shared_ptr<idle_timer_type> idle_timer_;
+
+    // Runs the operations the stream starts on its own
+    std::unique_ptr<boost::asio::io_service::strand> strand_;
+
 public:
     /// The type of the next layer.
     using next_layer_type =
@@ -173,6 +205,13 @@ public:
         wr_autofrag_ = o.value;
     }
 
+    /// Set the control frame latency option
+    void
+    set_option(control_latency const& o)
+    {
+        wr_latency_ = o.value;
+    }
+
     /** Set the decorator used for HTTP messages.
 
         The value for this option is a callable type with two
@@ -200,6 +239,13 @@ public:
         d_ = o;
     }
 
+    /// Set the idle timeout option
+    void
+    set_option(idle_timeout const& o)
+    {
+        idle_timeout_ = o.value;
+    }
+
     /// Set the keep-alive option
     void
     set_option(keep_alive const& o)
@@ -248,6 +294,13 @@ public:
         rd_msg_max_ = o.value;
     }
 
+    /// Set the most decompressed data delivered by one read
+    void
+    set_option(read_inflate_limit const& o)
+    {
+        rd_inflate_limit_ = o.value;
+    }
+
     /// Set the size of the write buffer
     void
     set_option(write_buffer_size const& o)
@@ -255,6 +308,13 @@ public:
         wr_buf_size_ = o.value;
     }
 
+    /// Set the write queue limit
+    void
+    set_option(write_queue_limit const& o)
+    {
+        wq_limit_ = o.value;
+    }
+
     /** Get the io_service associated with the stream.
 
         This function may be used to obtain the io_service object
@@ -271,6 +331,30 @@ public:
         return stream_.get_io_service();
     }
 
+    /** Get the strand used by the stream's own operations.
+
+        Some asynchronous operations are started by the stream
+        rather than by the caller: sending the queue filled by
+        @ref enqueue and @ref submit, and the idle timer with its
+        keepalive pings. Their handlers always run through this
+        strand.
+
+        When the io_service is run by more than one thread, the
+        program's own asynchronous operations on the stream must
+        be performed within this strand as well. That is, their
+        handlers must be wrapped by it, and they must be started
+        from a handler running in it. With a single thread, the
+        strand may be ignored.
+
+        @return A reference to the strand. Ownership is not
+        transferred to the caller.
+    */
+    boost::asio::io_service::strand&
+    get_strand()
+    {
+        return *strand_;
+    }
+
     /** Get a reference to the next layer.
 
         This function returns a reference to the next layer
@@ -360,6 +444,11 @@ public:
         HTTP response is sent indicating the reason and status code
         (typically 400, "Bad Request"). This counts as a failure.
 
+        When no decorator is set, a plain upgrade request whose header
+        fits in 4096 bytes is answered with a fixed response, without
+        parsing the request into a message. Requests carrying a body or
+        an extension offer to negotiate take the general path.
+
         @throws system_error Thrown on failure.
     */
     void
@@ -1417,6 +1506,291 @@ public:
     async_read_frame(frame_info& fi,
         DynamicBuffer& dynabuf, ReadHandler&& handler);
 
+    /** Relay a message frame to another stream.
+
+        This function is used to synchronously receive one message
+        frame of a message from this stream, and send it as a frame of
+        the same message on `dst`. The frame is not stored: the payload
+        is moved between the next layers in pieces no larger than the
+        @ref read_buffer_size of this stream, and it is unmasked and
+        masked again for `dst` in a single pass. This is intended for
+        proxies, whose memory use and latency then no longer depend on
+        the size of the messages they forward. To relay a message,
+        callers should keep relaying frames until `fi.fin == true`.
+
+        Compressed frames are sent as they are when the
+        permessage-deflate settings negotiated by both streams allow
+        the peer of `dst` to inflate what the peer of this stream
+        produced. In that case every compressed message received on
+        this stream must be relayed, and no compressed messages of the
+        program's own may be sent on `dst`, unless both peers discard
+        their compression state after each message. Otherwise, the
+        payload is inflated and sent as the message of `dst`, which
+        compresses it according to its own settings, and the
+        @ref message_type of `dst` is set to the type of the message.
+
+        The payload of frames which are not inflated is not checked
+        for valid utf8, and does not count towards the
+        @ref read_message_max limit; the peer of `dst` checks it.
+        If an error occurs after part of a frame was received or sent,
+        the stream holding the unfinished frame has failed.
+
+        Control frames received on this stream are handled as by
+        @ref read_frame. Control frames are not relayed.
+
+        @param fi An object to store metadata about the message.
+
+        @param dst The stream to send the frame on. The program must
+        ensure that it performs no other writes during the call.
+
+        @throws system_error Thrown on failure.
+    */
+    template<class OtherLayer>
+    void
+    relay_frame(frame_info& fi, stream<OtherLayer>& dst);
+
+    /** Relay a message frame to another stream.
+
+        This function is used to synchronously receive one message
+        frame of a message from this stream, and send it as a frame of
+        the same message on `dst`. The frame is not stored: the payload
+        is moved between the next layers in pieces no larger than the
+        @ref read_buffer_size of this stream, and it is unmasked and
+        masked again for `dst` in a single pass. This is intended for
+        proxies, whose memory use and latency then no longer depend on
+        the size of the messages they forward. To relay a message,
+        callers should keep relaying frames until `fi.fin == true`.
+
+        Compressed frames are sent as they are when the
+        permessage-deflate settings negotiated by both streams allow
+        the peer of `dst` to inflate what the peer of this stream
+        produced. In that case every compressed message received on
+        this stream must be relayed, and no compressed messages of the
+        program's own may be sent on `dst`, unless both peers discard
+        their compression state after each message. Otherwise, the
+        payload is inflated and sent as the message of `dst`, which
+        compresses it according to its own settings, and the
+        @ref message_type of `dst` is set to the type of the message.
+
+        The payload of frames which are not inflated is not checked
+        for valid utf8, and does not count towards the
+        @ref read_message_max limit; the peer of `dst` checks it.
+        If an error occurs after part of a frame was received or sent,
+        the stream holding the unfinished frame has failed.
+
+        Control frames received on this stream are handled as by
+        @ref read_frame. Control frames are not relayed.
+
+        @param fi An object to store metadata about the message.
+
+        @param dst The stream to send the frame on. The program must
+        ensure that it performs no other writes during the call.
+
+        @param ec Set to indicate what error occurred, if any.
+    */
+    template<class OtherLayer>
+    void
+    relay_frame(frame_info& fi,
+        stream<OtherLayer>& dst, error_code& ec);
+
+    /** Start an asynchronous operation to relay a message frame.
+
+        This function is used to asynchronously receive one message
+        frame of a message from this stream, and send it as a frame of
+        the same message on `dst`. The frame is not stored: the payload
+        is moved between the next layers in pieces no larger than the
+        @ref read_buffer_size of this stream, and it is unmasked and
+        masked again for `dst` in a single pass. This is intended for
+        proxies, whose memory use and latency then no longer depend on
+        the size of the messages they forward. To relay a message,
+        callers should keep relaying frames until `fi.fin == true`.
+
+        Compressed frames are sent as they are when the
+        permessage-deflate settings negotiated by both streams allow
+        the peer of `dst` to inflate what the peer of this stream
+        produced. In that case every compressed message received on
+        this stream must be relayed, and no compressed messages of the
+        program's own may be sent on `dst`, unless both peers discard
+        their compression state after each message. Otherwise, the
+        payload is inflated and sent as the message of `dst`, which
+        compresses it according to its own settings, and the
+        @ref message_type of `dst` is set to the type of the message.
+
+        The payload of frames which are not inflated is not checked
+        for valid utf8, and does not count towards the
+        @ref read_message_max limit; the peer of `dst` checks it.
+        If an error occurs after part of a frame was received or sent,
+        the stream holding the unfinished frame has failed.
+
+        Control frames received on this stream are handled as by
+        @ref read_frame. Control frames are not relayed.
+
+        This operation is implemented in terms of one or more calls to
+        the next layer's `async_read_some` and `async_write_some`
+        functions of both streams, and is known as a <em>composed
+        operation</em>. It counts as a read on this stream and as a
+        write on `dst`, and both streams must be used from the same
+        implicit or explicit strand. Control frames sent by `dst` are
+        sent between relayed frames.
+
+        @param fi An object to store metadata about the message.
+        This object must remain valid until the handler is called.
+
+        @param dst The stream to send the frame on. This object must
+        remain valid until the handler is called.
+
+        @param handler The handler to be called when the operation
+        completes. Copies will be made of the handler as required. The
+        function signature of the handler must be:
+        @code
+        void handler(
+            error_code const& error     // Result of operation
+        );
+        @endcode
+        Regardless of whether the asynchronous operation completes
+        immediately or not, the handler will not be invoked from within
+        this function. Invocation of the handler will be performed in a
+        manner equivalent to using boost::asio::io_service::post().
+    */
+    template<class OtherLayer, class RelayHandler>
+#if GENERATING_DOCS
+    void_or_deduced
+#else
+    typename async_completion<
+        RelayHandler, void(error_code)>::result_type
+#endif
+    async_relay_frame(frame_info& fi,
+        stream<OtherLayer>& dst, RelayHandler&& handler);
+
+    /** Read a batch of messages from the stream.
+
+        This function is used to synchronously read one or more
+        messages from the stream. The call blocks until one of the
+        following is true:
+
+        @li At least one complete message is received.
+
+        @li An error occurs on the stream.
+
+        The stream reads from the next layer into an internal buffer,
+        and then delivers every complete message already held in that
+        buffer, so that a single read may deliver many small messages.
+        Messages which are fragmented, compressed, or too large for
+        the internal buffer are read as if by @ref read, one per batch.
+
+        Upon a success, the payloads of the messages are appended to
+        the dynamic buffer in order, and one @ref message_info is
+        appended to `messages` for each message delivered. Control
+        frames are handled as described for @ref read.
+
+        @param messages A container to receive information about each
+        message delivered.
+
+        @param dynabuf A dynamic buffer to hold the message data after
+        any masking or decompression has been applied.
+
+        @throws system_error Thrown on failure.
+    */
+    template<class DynamicBuffer>
+    void
+    read_batch(std::vector<message_info>& messages,
+        DynamicBuffer& dynabuf);
+
+    /** Read a batch of messages from the stream.
+
+        This function is used to synchronously read one or more
+        messages from the stream. The call blocks until one of the
+        following is true:
+
+        @li At least one complete message is received.
+
+        @li An error occurs on the stream.
+
+        The stream reads from the next layer into an internal buffer,
+        and then delivers every complete message already held in that
+        buffer, so that a single read may deliver many small messages.
+        Messages which are fragmented, compressed, or too large for
+        the internal buffer are read as if by @ref read, one per batch.
+
+        Upon a success, the payloads of the messages are appended to
+        the dynamic buffer in order, and one @ref message_info is
+        appended to `messages` for each message delivered. Control
+        frames are handled as described for @ref read.
+
+        @param messages A container to receive information about each
+        message delivered.
+
+        @param dynabuf A dynamic buffer to hold the message data after
+        any masking or decompression has been applied.
+
+        @param ec Set to indicate what error occurred, if any.
+    */
+    template<class DynamicBuffer>
+    void
+    read_batch(std::vector<message_info>& messages,
+        DynamicBuffer& dynabuf, error_code& ec);
+
+    /** Start an asynchronous operation to read a batch of messages.
+
+        This function is used to asynchronously read one or more
+        messages from the stream. The function call always returns
+        immediately. The asynchronous operation will continue until
+        one of the following is true:
+
+        @li At least one complete message is received.
+
+        @li An error occurs on the stream.
+
+        The stream reads from the next layer into an internal buffer,
+        and then delivers every complete message already held in that
+        buffer in one completion. The cost of each additional message
+        is only that of parsing its header and unmasking its payload.
+        Messages which are fragmented, compressed, or too large for
+        the internal buffer, as set by @ref read_buffer_size, are read
+        as if by @ref async_read, one per batch.
+
+        This operation is implemented in terms of one or more calls to
+        the next layer's `async_read_some` and `async_write_some`
+        functions, and is known as a <em>composed operation</em>. The
+        program must ensure that the stream performs no other reads
+        until this operation completes.
+
+        Upon a success, the payloads of the messages are appended to
+        the dynamic buffer in order, and one @ref message_info is
+        appended to `messages` for each message delivered. Control
+        frames are handled as described for @ref async_read.
+
+        @param messages A container to receive information about each
+        message delivered. This object must remain valid until the
+        handler is called.
+
+        @param dynabuf A dynamic buffer to hold the message data after
+        any masking or decompression has been applied. This object must
+        remain valid until the handler is called.
+
+        @param handler The handler to be called when the read operation
+        completes. Copies will be made of the handler as required. The
+        function signature of the handler must be:
+        @code
+        void handler(
+            error_code const& error     // Result of operation
+        );
+        @endcode
+        Regardless of whether the asynchronous operation completes
+        immediately or not, the handler will not be invoked from within
+        this function. Invocation of the handler will be performed in a
+        manner equivalent to using boost::asio::io_service::post().
+    */
+    template<class DynamicBuffer, class ReadHandler>
+#if GENERATING_DOCS
+    void_or_deduced
+#else
+    typename async_completion<
+        ReadHandler, void(error_code)>::result_type
+#endif
+    async_read_batch(std::vector<message_info>& messages,
+        DynamicBuffer& dynabuf, ReadHandler&& handler);
+
     /** Write a message to the stream.
 
         This function is used to synchronously write a message to
@@ -1489,6 +1863,43 @@ public:
     void
     write(ConstBufferSequence const& buffers, error_code& ec);
 
+    /** Write a message to the stream, choosing its compression.
+
+        This function behaves as @ref write, except that `c`
+        decides whether the message is compressed when the
+        permessage-deflate extension is in effect, instead of the
+        @ref permessage_deflate settings.
+
+        @param buffers The buffers containing the entire message
+        payload.
+
+        @param c The compression to use for this message.
+
+        @throws system_error Thrown on failure.
+    */
+    template<class ConstBufferSequence>
+    void
+    write(ConstBufferSequence const& buffers, compression c);
+
+    /** Write a message to the stream, choosing its compression.
+
+        This function behaves as @ref write, except that `c`
+        decides whether the message is compressed when the
+        permessage-deflate extension is in effect, instead of the
+        @ref permessage_deflate settings.
+
+        @param buffers The buffers containing the entire message
+        payload.
+
+        @param c The compression to use for this message.
+
+        @param ec Set to indicate what error occurred, if any.
+    */
+    template<class ConstBufferSequence>
+    void
+    write(ConstBufferSequence const& buffers,
+        compression c, error_code& ec);
+
     /** Start an asynchronous operation to write a message to the stream.
 
         This function is used to asynchronously write a message to
@@ -1543,6 +1954,113 @@ public:
     async_write(ConstBufferSequence const& buffers,
         WriteHandler&& handler);
 
+    /** Start an asynchronous operation to write a message to the stream, choosing its compression.
+
+        This function behaves as @ref async_write, except that `c`
+        decides whether the message is compressed when the
+        permessage-deflate extension is in effect, instead of the
+        @ref permessage_deflate settings.
+
+        @param buffers The buffers containing the entire message
+        payload. The caller is responsible for ensuring that the
+        memory locations pointed to by buffers remains valid until
+        the completion handler is called.
+
+        @param c The compression to use for this message.
+
+        @param handler The handler to be called when the write
+        operation completes. The function signature of the handler
+        must be:
+        @code
+        void handler(
+            error_code const& error     // Result of operation
+        );
+        @endcode
+    */
+    template<class ConstBufferSequence, class WriteHandler>
+#if GENERATING_DOCS
+    void_or_deduced
+#else
+    typename async_completion<
+        WriteHandler, void(error_code)>::result_type
+#endif
+    async_write(ConstBufferSequence const& buffers,
+        compression c, WriteHandler&& handler);
+
+    /** Write a message to the stream, masking the buffers in place.
+
+        This function behaves as @ref write, except that the caller
+        gives up the contents of the buffers. A client masks the
+        payload where it lies and sends it from there, instead of
+        copying it to the write buffer one piece at a time, so the
+        message is not split at the write buffer size unless the
+        @ref auto_fragment option is set. Compressed messages, and
+        messages sent by a server, are written as usual.
+
+        @param buffers The buffers containing the entire message
+        payload. Upon return, their contents are unspecified.
+
+        @throws system_error Thrown on failure.
+    */
+    template<class MutableBufferSequence>
+    void
+    write_inplace(MutableBufferSequence const& buffers);
+
+    /** Write a message to the stream, masking the buffers in place.
+
+        This function behaves as @ref write, except that the caller
+        gives up the contents of the buffers. A client masks the
+        payload where it lies and sends it from there, instead of
+        copying it to the write buffer one piece at a time, so the
+        message is not split at the write buffer size unless the
+        @ref auto_fragment option is set. Compressed messages, and
+        messages sent by a server, are written as usual.
+
+        @param buffers The buffers containing the entire message
+        payload. Upon return, their contents are unspecified.
+
+        @param ec Set to indicate what error occurred, if any.
+    */
+    template<class MutableBufferSequence>
+    void
+    write_inplace(MutableBufferSequence const& buffers,
+        error_code& ec);
+
+    /** Start an asynchronous operation to write a message to the stream, masking the buffers in place.
+
+        This function behaves as @ref async_write, except that the
+        caller gives up the contents of the buffers. A client masks
+        the payload where it lies and sends it from there, instead of
+        copying it to the write buffer one piece at a time, so the
+        message is not split at the write buffer size unless the
+        @ref auto_fragment option is set. Compressed messages, and
+        messages sent by a server, are written as usual.
+
+        @param buffers The buffers containing the entire message
+        payload. The caller is responsible for ensuring that the
+        memory locations pointed to by buffers remains valid until
+        the completion handler is called. When the handler is
+        called, their contents are unspecified.
+
+        @param handler The handler to be called when the write
+        operation completes. The function signature of the handler
+        must be:
+        @code
+        void handler(
+            error_code const& error     // Result of operation
+        );
+        @endcode
+    */
+    template<class MutableBufferSequence, class WriteHandler>
+#if GENERATING_DOCS
+    void_or_deduced
+#else
+    typename async_completion<
+        WriteHandler, void(error_code)>::result_type
+#endif
+    async_write_inplace(MutableBufferSequence const& buffers,
+        WriteHandler&& handler);
+
     /** Write partial message data on the stream.
 
         This function is used to write some or all of a message's
@@ -1659,6 +2177,195 @@ public:
     async_write_frame(bool fin,
         ConstBufferSequence const& buffers, WriteHandler&& handler);
 
+    /** Write a prepared message to the stream.
+
+        This function is used to send a message built once with
+        @ref prepared_message, typically to many streams. The call
+        blocks until the complete frame is sent, or an error occurs.
+        The frame is gathered from the prepared message without
+        copying it, except when the stream is a client, which must
+        mask a copy of the payload.
+
+        The stream must not be in the middle of sending a message
+        with @ref write_frame.
+
+        @param msg The prepared message to send.
+
+        @throws system_error Thrown on failure.
+    */
+    void
+    write_prepared(prepared_message const& msg);
+
+    /** Write a prepared message to the stream.
+
+        This function is used to send a message built once with
+        @ref prepared_message, typically to many streams. The call
+        blocks until the complete frame is sent, or an error occurs.
+        The frame is gathered from the prepared message without
+        copying it, except when the stream is a client, which must
+        mask a copy of the payload.
+
+        The stream must not be in the middle of sending a message
+        with @ref write_frame.
+
+        @param msg The prepared message to send.
+
+        @param ec Set to indicate what error occurred, if any.
+    */
+    void
+    write_prepared(prepared_message const& msg, error_code& ec);
+
+    /** Start an asynchronous operation to write a prepared message to the stream.
+
+        This function is used to asynchronously send a message built
+        once with @ref prepared_message, typically to many streams.
+        This function call always returns immediately. The frame is
+        gathered from the prepared message without copying it, except
+        when the stream is a client, which must mask a copy of the
+        payload. The operation holds a reference to the prepared
+        message, which may be destroyed by the caller at any time.
+
+        The program must ensure that the stream performs no other write
+        operations (such as stream::async_write, stream::async_write_frame,
+        or stream::async_close).
+
+        @param msg The prepared message to send.
+
+        @param handler The handler to be called when the write completes.
+        Copies will be made of the handler as required. The equivalent
+        function signature of the handler must be:
+        @code void handler(
+            error_code const& error // result of operation
+        ); @endcode
+    */
+    template<class WriteHandler>
+#if GENERATING_DOCS
+    void_or_deduced
+#else
+    typename async_completion<
+        WriteHandler, void(error_code)>::result_type
+#endif
+    async_write_prepared(prepared_message const& msg,
+        WriteHandler&& handler);
+
+    /** Queue a message for sending.
+
+        This function frames a complete message, using the current
+        @ref message_type setting and compressing it if required, and
+        appends it to the stream's outgoing message queue. The call
+        always returns immediately. The queue is sent in the
+        background using the next layer's `async_write_some`. Messages
+        queued while a write is in progress are gathered into a single
+        write when it completes, so that many small messages cost few
+        calls to the next layer.
+
+        If the queue holds more than the @ref write_queue_limit, the
+        message is refused. The caller may use @ref async_flush to
+        learn when the queue is empty, and then try again.
+
+        While the queue is in use, the program must ensure that the
+        stream performs no other write operations (such as
+        stream::async_write, stream::async_write_frame, or
+        stream::async_close). Control frames sent by the implementation
+        or by stream::async_ping are sent between writes. A message
+        queued while another write operation is sending a message is
+        refused.
+
+        The queue is sent by handlers running in the strand returned
+        by @ref get_strand, which the program must also use when the
+        io_service is run by more than one thread.
+
+        @param buffers The buffers containing the entire message
+        payload. The payload is copied, so the buffers do not need
+        to remain valid after the call returns.
+
+        @return `true` if the message was queued, or `false` if the
+        queue is full, another message is being sent, or the stream
+        has failed.
+    */
+    template<class ConstBufferSequence>
+    bool
+    enqueue(ConstBufferSequence const& buffers);
+
+    /** Queue a message for sending, from any thread.
+
+        This function copies a complete message payload and hands it
+        to the stream's io_service, which frames it and appends it to
+        the outgoing message queue used by @ref enqueue. Unlike the
+        other member functions, this one may be called concurrently
+        from any number of threads, including threads which are not
+        running the io_service, and the caller needs no strand. The
+        call always returns immediately, and takes no locks.
+
+        The message is framed and sent by handlers running in the
+        strand returned by @ref get_strand. When the io_service is
+        run by more than one thread, the program's own operations on
+        the stream must run in that strand too.
+
+        Messages submitted by one thread are sent in the order they
+        were submitted. Messages which arrive while the io_service is
+        busy are framed together in one handler and gathered into
+        the same writes, so that a burst costs one `post`.
+
+        The message is framed when the io_service reaches it, using
+        the @ref message_type setting in effect at that time, so the
+        options must not change while messages are being submitted.
+        The payload bytes submitted but not yet written to the next
+        layer are counted against the @ref write_queue_limit, and a
+        message which would exceed it is refused. Once the stream
+        fails or is closed, every message is refused, and those not
+        yet sent are discarded.
+
+        Messages may only be submitted once the handshake has
+        completed, and the stream must not be destroyed until every
+        submitted message has been sent or discarded. The same rules
+        as for @ref enqueue apply to other write operations, and a
+        message framed while another write operation is sending a
+        message is discarded.
+
+        @param buffers The buffers containing the entire message
+        payload. The payload is copied, so the buffers do not need
+        to remain valid after the call returns.
+
+        @return `true` if the message was submitted, or `false` if
+        the limit would be exceeded or the stream has failed.
+    */
+    template<class ConstBufferSequence>
+    bool
+    submit(ConstBufferSequence const& buffers);
+
+    /// Returns the number of bytes in queued frames
+    std::size_t
+    queue_size() const
+    {
+        return wq_ ? wq_->size : 0;
+    }
+
+    /** Start an asynchronous operation to wait until the queue is sent.
+
+        This function is used to asynchronously wait until every
+        message queued by @ref enqueue has been written to the next
+        layer. This function call always returns immediately. Only one
+        flush operation may be outstanding at a time.
+
+        @param handler The handler to be called when the queue is
+        empty. If sending failed, the error is passed to the handler
+        and the queued messages are discarded. Copies will be made of
+        the handler as required. The equivalent function signature of
+        the handler must be:
+        @code void handler(
+            error_code const& error // result of operation
+        ); @endcode
+    */
+    template<class WriteHandler>
+#if GENERATING_DOCS
+    void_or_deduced
+#else
+    typename async_completion<
+        WriteHandler, void(error_code)>::result_type
+#endif
+    async_flush(WriteHandler&& handler);
+
 private:
     template<class Handler> class accept_op;
     template<class Handler> class close_op;
@@ -1667,12 +2374,73 @@ private:
     template<class Handler> class response_op;
     template<class Buffers, class Handler> class write_op;
     template<class Buffers, class Handler> class write_frame_op;
+    template<class Handler> class write_prepared_op;
+    template<class Handler> class flush_op;
+    class queue_op;
+    class submit_op;
+    class idle_op;
     template<class DynamicBuffer, class Handler> class read_op;
     template<class DynamicBuffer, class Handler> class read_frame_op;
+    template<class DynamicBuffer, class Handler> class read_batch_op;
+    template<class OtherLayer, class Handler> class relay_op;
 
     void
     reset();
 
+    void
+    open(detail::role_type role);
+
+    void
+    idle_start(std::true_type);
+
+    void
+    idle_start(std::false_type)
+    {
+    }
+
+    void
+    strand_init(std::true_type)
+    {
+        strand_.reset(new boost::asio::io_service::strand(
+            get_io_service()));
+    }
+
+    void
+    strand_init(std::false_type)
+    {
+    }
+
+    void
+    idle_stop();
+
+    template<class DynamicBuffer>
+    void
+    read_inflate(DynamicBuffer& dynabuf,
+        close_code::value& code, error_code& ec);
+
+    template<class = void>
+    bool
+    read_data_fh(detail::frame_header& fh,
+        close_code::value& code, error_code& ec);
+
+    template<class = void>
+    void
+    read_close(close_code::value code, error_code& ec);
+
+    template<class DynamicBuffer>
+    bool
+    read_buffered(std::vector<message_info>& messages,
+        DynamicBuffer& dynabuf);
+
+    prepared_message::const_buffers_type
+    prepare_frame(prepared_message const& msg,
+        detail::fh_streambuf& fh_buf, detail::pooled_buffer& buf);
+
+    template<class ConstBufferSequence>
+    bool
+    frame_message(ConstBufferSequence const& buffers,
+        wq_t::entry& e, error_code& ec);
+
     http::request<http::empty_body>
     build_request(boost::string_ref const& host,
         boost::string_ref const& resource,
@@ -1682,6 +2450,9 @@ private:
     http::response<http::string_body>
     build_response(http::request<Body, Fields> const& req);
 
+    std::size_t
+    accept_buffered(char* res, bool& fallback);
+
     template<class Body, class Fields>
     void
     do_response(http::response<Body, Fields> const& resp,
@@ -1695,7 +2466,9 @@ private:
 #include <beast/websocket/impl/close.ipp>
 #include <beast/websocket/impl/handshake.ipp>
 #include <beast/websocket/impl/ping.ipp>
+#include <beast/websocket/impl/queue.ipp>
 #include <beast/websocket/impl/read.ipp>
+#include <beast/websocket/impl/relay.ipp>
 #include <beast/websocket/impl/stream.ipp>
 #include <beast/websocket/impl/write.ipp>
 
@@ -7,7 +7,9 @@
 
 #include <beast/core/detail/sha1.hpp>
 #include <beast/unit_test/suite.hpp>
+#include <algorithm>
 #include <array>
+#include <string>
 
 namespace beast {
 namespace detail {
@@ -57,6 +59,44 @@ public:
         BEAST_EXPECT(result == digest);
     }
 
+    // Digest the message in pieces of every size
+    void
+    checkSplit(std::string const& message, std::string const& answer)
+    {
+        auto const digest = unhex(answer);
+        for(std::size_t n = 1; n <= message.size(); ++n)
+        {
+            sha1_context ctx;
+            std::string result;
+            result.resize(sha1_context::digest_size);
+            init(ctx);
+            for(std::size_t i = 0; i < message.size(); i += n)
+                update(ctx, message.data() + i,
+                    (std::min)(n, message.size() - i));
+            finish(ctx, &result[0]);
+            BEAST_EXPECTS(result == digest, std::to_string(n));
+        }
+    }
+
+    // The kernel chosen at run time matches the portable one
+    void
+    testTransform()
+    {
+        std::string s;
+        for(std::size_t i = 0; i < 16 * sha1::BLOCK_BYTES; ++i)
+            s.push_back(static_cast<char>(i * 7 + (i >> 3)));
+        auto const p = reinterpret_cast<
+            std::uint8_t const*>(s.data());
+        for(std::size_t n = 0; n <= 16; ++n)
+        {
+            std::uint32_t d1[5] = { 1, 2, 3, 4, 5 };
+            std::uint32_t d2[5] = { 1, 2, 3, 4, 5 };
+            sha1::transform_scalar(d1, p, n);
+            sha1::transform_blocks(d2, p, n);
+            BEAST_EXPECT(std::equal(d1, d1 + 5, d2));
+        }
+    }
+
     void
     run()
     {
@@ -70,6 +110,11 @@ public:
             "84983e44" "1c3bd26e" "baae4aa1" "f95129e5" "e54670f1");
         check("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
             "a49b2446" "a02c645b" "f419f995" "b6709125" "3a04a259");
+        check(std::string(1000000, 'a'),
+            "34aa973c" "d4c4daa4" "f61eeb2b" "dbad2731" "6534016f");
+        checkSplit("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+            "a49b2446" "a02c645b" "f419f995" "b6709125" "3a04a259");
+        testTransform();
     }
 };
 
@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// The example file server, and its range support, are POSIX only
+#ifndef _WIN32
+
+// Test that header file is self-contained.
+#include "../../examples/range_body.hpp"
+
+#include <beast/unit_test/suite.hpp>
+#include <string>
+#include <vector>
+
+namespace beast {
+namespace http {
+
+class range_body_test : public unit_test::suite
+{
+public:
+    // Returns the ranges as "first-last,..." or the result
+    static
+    std::string
+    parse(boost::string_ref value, std::uint64_t size)
+    {
+        std::vector<byte_range> v;
+        switch(parse_range(value, size, v))
+        {
+        case range_result::ignore:
+            return "ignore";
+        case range_result::unsatisfiable:
+            return "unsatisfiable";
+        case range_result::partial:
+            break;
+        }
+        std::string s;
+        for(auto const& r : v)
+        {
+            if(! s.empty())
+                s.push_back(',');
+            s += std::to_string(r.first) + "-" +
+                std::to_string(r.last);
+        }
+        return s;
+    }
+
+    void
+    testParse()
+    {
+        BEAST_EXPECT(parse("", 100) == "ignore");
+        BEAST_EXPECT(parse("lines=0-9", 100) == "ignore");
+        BEAST_EXPECT(parse("bytes=", 100) == "ignore");
+        BEAST_EXPECT(parse("bytes=9-0", 100) == "ignore");
+        BEAST_EXPECT(parse("bytes=x", 100) == "ignore");
+        BEAST_EXPECT(parse("bytes=100-", 100) == "unsatisfiable");
+        BEAST_EXPECT(parse("bytes=-0", 100) == "unsatisfiable");
+        BEAST_EXPECT(parse("bytes=0-9", 100) == "0-9");
+        BEAST_EXPECT(parse("bytes=90-", 100) == "90-99");
+        BEAST_EXPECT(parse("bytes=90-200", 100) == "90-99");
+        BEAST_EXPECT(parse("bytes=-10", 100) == "90-99");
+        BEAST_EXPECT(parse("bytes=-200", 100) == "0-99");
+        BEAST_EXPECT(parse("bytes=0-9, 100-, 20-29", 100) == "0-9,20-29");
+    }
+
+    // Overlapping, adjacent and repeated ranges are merged,
+    // so a response never repeats any part of the file.
+    void
+    testCoalesce()
+    {
+        BEAST_EXPECT(parse("bytes=50-59,0-9", 100) == "0-9,50-59");
+        BEAST_EXPECT(parse("bytes=0-9,5-14", 100) == "0-14");
+        BEAST_EXPECT(parse("bytes=0-4,5-9", 100) == "0-9");
+        BEAST_EXPECT(parse("bytes=0-9,2-3", 100) == "0-9");
+        BEAST_EXPECT(parse("bytes=-10,90-", 100) == "90-99");
+        BEAST_EXPECT(parse("bytes=20-29,0-9,10-19", 100) == "0-29");
+        std::string s = "bytes=0-";
+        for(int i = 1; i < 16; ++i)
+            s += ",0-";
+        BEAST_EXPECT(parse(s, 100) == "0-99");
+        // Too many ranges are ignored
+        BEAST_EXPECT(parse(s + ",0-", 100) == "ignore");
+    }
+
+    void run() override
+    {
+        testParse();
+        testCoalesce();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(range_body,http,beast);
+
+} // http
+} // beast
+
+#endif
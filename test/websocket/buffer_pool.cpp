@@ -0,0 +1,88 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/detail/buffer_pool.hpp>
+
+#include <beast/unit_test/suite.hpp>
+#include <cstring>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+class buffer_pool_test : public beast::unit_test::suite
+{
+public:
+    void
+    testClasses()
+    {
+        buffer_pool pool;
+        // Sizes are rounded up to a class
+        auto p = pool.allocate(1);
+        BEAST_EXPECT(pool.in_use() == 512);
+        std::memset(p, 0, 512);
+        pool.deallocate(p);
+        BEAST_EXPECT(pool.in_use() == 0);
+        BEAST_EXPECT(pool.idle() == 512);
+        // Idle buffers are reused
+        auto p1 = pool.allocate(500);
+        BEAST_EXPECT(p1 == p);
+        BEAST_EXPECT(pool.idle() == 0);
+        auto p2 = pool.allocate(4097);
+        BEAST_EXPECT(pool.in_use() == 512 + 8192);
+        std::memset(p2, 0, 8192);
+        pool.deallocate(p1);
+        pool.deallocate(p2);
+        BEAST_EXPECT(pool.idle() == 512 + 8192);
+        // Large buffers are not retained
+        auto p3 = pool.allocate(1024 * 1024);
+        BEAST_EXPECT(pool.in_use() == 1024 * 1024);
+        pool.deallocate(p3);
+        BEAST_EXPECT(pool.in_use() == 0);
+        BEAST_EXPECT(pool.idle() == 512 + 8192);
+    }
+
+    void
+    testLimit()
+    {
+        buffer_pool pool(8192);
+        std::uint8_t* v[4];
+        for(auto& p : v)
+            p = pool.allocate(4096);
+        for(auto p : v)
+            pool.deallocate(p);
+        BEAST_EXPECT(pool.in_use() == 0);
+        BEAST_EXPECT(pool.idle() == 8192);
+    }
+
+    void
+    testPooledBuffer()
+    {
+        auto& pool = buffer_pool::instance();
+        auto const used = pool.in_use();
+        {
+            auto b = make_pooled_buffer(4096);
+            BEAST_EXPECT(pool.in_use() == used + 4096);
+            b[4095] = 0;
+        }
+        BEAST_EXPECT(pool.in_use() == used);
+    }
+
+    void run() override
+    {
+        testClasses();
+        testLimit();
+        testPooledBuffer();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(buffer_pool,websocket,beast);
+
+} // detail
+} // websocket
+} // beast
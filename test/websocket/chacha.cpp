@@ -0,0 +1,69 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/detail/chacha.hpp>
+
+#include <beast/unit_test/suite.hpp>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+class chacha_test : public beast::unit_test::suite
+{
+public:
+    void
+    testBlock()
+    {
+        // rfc7539 section 2.3.2
+        std::array<std::uint32_t, 8> const key{{
+            0x03020100, 0x07060504, 0x0b0a0908, 0x0f0e0d0c,
+            0x13121110, 0x17161514, 0x1b1a1918, 0x1f1e1d1c}};
+        std::array<std::uint32_t, 3> const nonce{{
+            0x09000000, 0x4a000000, 0x00000000}};
+        std::uint32_t const x[16] = {
+            0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3,
+            0xc7f4d1c7, 0x0368c033, 0x9aaa2204, 0x4e6cd4c3,
+            0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9,
+            0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2};
+        chacha20 g;
+        g.seed(key, nonce, 1);
+        for(auto v : x)
+            if(! BEAST_EXPECT(g() == v))
+                break;
+    }
+
+    void
+    testCounter()
+    {
+        // The second block follows the first
+        std::array<std::uint32_t, 8> const key{{1, 2, 3, 4, 5, 6, 7, 8}};
+        chacha20 g1;
+        g1.seed(key);
+        for(int i = 0; i < 16; ++i)
+            g1();
+        chacha20 g2;
+        g2.seed(key, {{}}, 1);
+        for(int i = 0; i < 16; ++i)
+            if(! BEAST_EXPECT(g1() == g2()))
+                break;
+    }
+
+    void
+    run() override
+    {
+        testBlock();
+        testCounter();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(chacha,websocket,beast);
+
+} // detail
+} // websocket
+} // beast
@@ -0,0 +1,266 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "websocket_async_echo_server.hpp"
+
+#include <beast/websocket/stream.hpp>
+#include <beast/core/streambuf.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iomanip>
+#include <list>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace beast {
+namespace websocket {
+
+/*  Round trips through the asynchronous echo server on loopback.
+
+    Each client stream keeps one message in flight: it writes a
+    message, reads the echo, and records the round trip time. CPU
+    time is that of the whole process, so it includes the work done
+    by the server for each message.
+*/
+class echo_bench_test : public beast::unit_test::suite
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+    using endpoint_type = boost::asio::ip::tcp::endpoint;
+    using address_type = boost::asio::ip::address;
+    using socket_type = boost::asio::ip::tcp::socket;
+
+    // The number of client streams
+    static std::size_t constexpr clients = 4;
+
+    // The payload bytes each case sends, which
+    // bounds the time taken by the large sizes.
+    static std::size_t constexpr budget = 64 * 1024 * 1024;
+
+    // The largest message size
+    static std::size_t constexpr max_size = 16 * 1024 * 1024;
+
+    struct config
+    {
+        bool binary;
+        bool deflate;
+        bool autofrag;
+    };
+
+    class client
+    {
+        stream<socket_type> ws_;
+        std::string const& msg_;
+        std::size_t remain_;
+        clock_type::time_point t0_;
+        opcode op_;
+        streambuf db_;
+
+    public:
+        std::vector<clock_type::duration> rtt;
+        error_code ec;
+
+        client(boost::asio::io_service& ios,
+                std::string const& msg, std::size_t count)
+            : ws_(ios)
+            , msg_(msg)
+            , remain_(count)
+        {
+            rtt.reserve(count);
+        }
+
+        stream<socket_type>&
+        ws()
+        {
+            return ws_;
+        }
+
+        void
+        start()
+        {
+            t0_ = clock_type::now();
+            ws_.async_write(boost::asio::buffer(msg_),
+                [this](error_code const& ec)
+                {
+                    on_write(ec);
+                });
+        }
+
+    private:
+        void
+        on_write(error_code const& ec)
+        {
+            if(ec)
+            {
+                this->ec = ec;
+                return;
+            }
+            ws_.async_read(op_, db_,
+                [this](error_code const& ec)
+                {
+                    on_read(ec);
+                });
+        }
+
+        void
+        on_read(error_code const& ec)
+        {
+            if(ec)
+            {
+                this->ec = ec;
+                return;
+            }
+            rtt.push_back(clock_type::now() - t0_);
+            db_.consume(db_.size());
+            if(--remain_ > 0)
+                start();
+        }
+    };
+
+    // Words separated by spaces, so that the payload
+    // is valid text and compresses about as well as prose.
+    static
+    std::string
+    make_payload(std::size_t size)
+    {
+        static char const* const words[] = {
+            "the ", "quick ", "brown ", "fox ", "jumps ", "over ",
+            "a ", "lazy ", "dog ", "while ", "seven ", "zebras ",
+            "quietly ", "vex ", "juggling ", "wizards "};
+        std::string s;
+        s.reserve(size);
+        std::uint32_t x = 1;
+        while(s.size() < size)
+        {
+            x = x * 1664525 + 1013904223;
+            s.append(words[x >> 28]);
+        }
+        s.resize(size);
+        return s;
+    }
+
+    static
+    std::string
+    format_size(std::size_t n)
+    {
+        std::stringstream ss;
+        if(n >= 1024 * 1024)
+            ss << n / (1024 * 1024) << "MB";
+        else if(n >= 1024)
+            ss << n / 1024 << "KB";
+        else
+            ss << n << "B";
+        return ss.str();
+    }
+
+    void
+    testEcho(config const& cfg, std::size_t size)
+    {
+        using namespace std::chrono;
+        auto const count = (std::max<std::size_t>)(2,
+            (std::min<std::size_t>)(20000, budget / size / clients));
+
+        permessage_deflate pmd;
+        pmd.client_enable = cfg.deflate;
+        pmd.server_enable = cfg.deflate;
+
+        error_code ec;
+        ::websocket::async_echo_server server{nullptr,
+            (std::max<std::size_t>)(1, std::thread::hardware_concurrency())};
+        server.set_option(pmd);
+        server.set_option(auto_fragment{cfg.autofrag});
+        server.set_option(read_message_max{max_size});
+        server.open(endpoint_type{
+            address_type::from_string("127.0.0.1"), 0}, ec);
+        if(! BEAST_EXPECTS(! ec, ec.message()))
+            return;
+        auto const ep = server.local_endpoint();
+
+        auto const msg = make_payload(size);
+        boost::asio::io_service ios;
+        std::list<client> list;
+        for(std::size_t i = 0; i < clients; ++i)
+        {
+            list.emplace_back(ios, msg, count);
+            auto& ws = list.back().ws();
+            ws.set_option(pmd);
+            ws.set_option(auto_fragment{cfg.autofrag});
+            ws.set_option(read_message_max{max_size});
+            ws.set_option(message_type{cfg.binary ?
+                opcode::binary : opcode::text});
+            ws.next_layer().connect(ep);
+            ws.next_layer().set_option(
+                boost::asio::ip::tcp::no_delay{true});
+            ws.handshake("localhost", "/");
+        }
+
+        auto const c0 = std::clock();
+        auto const t0 = clock_type::now();
+        for(auto& c : list)
+            c.start();
+        ios.run();
+        auto const elapsed = duration_cast<
+            duration<double>>(clock_type::now() - t0).count();
+        auto const cpu =
+            static_cast<double>(std::clock() - c0) / CLOCKS_PER_SEC;
+
+        std::vector<clock_type::duration> rtt;
+        for(auto& c : list)
+        {
+            if(! BEAST_EXPECTS(! c.ec, c.ec.message()))
+                continue;
+            rtt.insert(rtt.end(), c.rtt.begin(), c.rtt.end());
+            c.ws().close({}, ec);
+        }
+        if(! BEAST_EXPECT(! rtt.empty()))
+            return;
+        std::sort(rtt.begin(), rtt.end());
+        auto const pct =
+            [&](double p)
+            {
+                auto const i = static_cast<std::size_t>(
+                    p * (rtt.size() - 1));
+                return duration_cast<microseconds>(rtt[i]).count();
+            };
+        auto const n = static_cast<double>(rtt.size());
+        log << std::fixed << std::setprecision(1) <<
+            std::setw(5) << format_size(size) <<
+            (cfg.binary ? " binary" : " text  ") <<
+            (cfg.deflate ? " deflate" : "        ") <<
+            (cfg.autofrag ? " autofrag" : "         ") << ": " <<
+            n / elapsed << " msg/s, " <<
+            n * size / elapsed / (1024 * 1024) << " MB/s, " <<
+            cpu * 1000000 / n << " us cpu/msg, rtt p50 " <<
+            pct(0.5) << "us p99 " <<
+            pct(0.99) << "us p999 " <<
+            pct(0.999) << "us" << std::endl;
+    }
+
+    void run() override
+    {
+        log << clients << " client streams" << std::endl;
+        std::size_t const sizes[] = {
+            16, 1024, 64 * 1024, 1024 * 1024, max_size};
+        for(auto const deflate : {false, true})
+            for(auto const autofrag : {false, true})
+                for(auto const binary : {true, false})
+                    for(auto const size : sizes)
+                        testEcho({binary, deflate, autofrag}, size);
+        pass();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(echo_bench,websocket,beast);
+
+} // websocket
+} // beast
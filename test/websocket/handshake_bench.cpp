@@ -0,0 +1,131 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <beast/websocket/stream.hpp>
+#include <beast/websocket/detail/hybi13.hpp>
+#include <beast/core/detail/sha1.hpp>
+#include <beast/test/string_ostream.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <boost/asio/io_service.hpp>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace beast {
+namespace websocket {
+
+class handshake_bench_test : public beast::unit_test::suite
+{
+public:
+    using clock_type = std::chrono::high_resolution_clock;
+
+    struct identity
+    {
+        template<class Body, class Fields>
+        void
+        operator()(http::message<true, Body, Fields>&)
+        {
+        }
+
+        template<class Body, class Fields>
+        void
+        operator()(http::message<false, Body, Fields>&)
+        {
+        }
+    };
+
+    boost::asio::io_service ios_;
+
+    std::string const req_ =
+        "GET /chat HTTP/1.1\r\n"
+        "Host: server.example.com\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Origin: http://example.com\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n";
+
+    template<class Function>
+    void
+    timedTest(std::string const& name,
+        std::size_t repeat, Function const& f)
+    {
+        using namespace std::chrono;
+        auto const t0 = clock_type::now();
+        for(std::size_t i = 0; i < repeat; ++i)
+            f();
+        auto const elapsed = duration_cast<
+            microseconds>(clock_type::now() - t0).count();
+        log <<
+            name << ": " <<
+            (elapsed > 0 ? (repeat * 1000000) / elapsed : 0) <<
+            " per second" << std::endl;
+    }
+
+    // Accepts on one thread, measuring handshakes per core
+    void
+    testAccept()
+    {
+        std::size_t const repeat = 100000;
+        timedTest("accept, fixed response", repeat,
+            [&]
+            {
+                stream<test::string_ostream> ws(ios_);
+                ws.accept(boost::asio::buffer(req_));
+            });
+        timedTest("accept, parsed request", repeat,
+            [&]
+            {
+                stream<test::string_ostream> ws(ios_);
+                ws.set_option(decorate(identity{}));
+                ws.accept(boost::asio::buffer(req_));
+            });
+    }
+
+    void
+    testKey()
+    {
+        using beast::detail::sha1::transform_blocks;
+        using beast::detail::sha1::transform_scalar;
+        std::size_t const repeat = 4000000;
+        char buf[detail::sec_ws_accept_size];
+        timedTest("Sec-WebSocket-Accept", repeat,
+            [&]
+            {
+                detail::make_sec_ws_accept(
+                    buf, "dGhlIHNhbXBsZSBub25jZQ==");
+            });
+        // Two blocks, the size of a key and the guid
+        std::uint8_t block[128] = {};
+        std::uint32_t digest[5] = {};
+        timedTest("sha1 scalar", repeat,
+            [&]
+            {
+                transform_scalar(digest, block, 2);
+            });
+        timedTest("sha1 fastest", repeat,
+            [&]
+            {
+                transform_blocks(digest, block, 2);
+            });
+        BEAST_EXPECT(digest[0] != 0);
+    }
+
+    void
+    run() override
+    {
+        testKey();
+        testAccept();
+        pass();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(handshake_bench,websocket,beast);
+
+} // websocket
+} // beast
@@ -9,6 +9,8 @@
 #include <beast/websocket/detail/mask.hpp>
 
 #include <beast/unit_test/suite.hpp>
+#include <random>
+#include <vector>
 
 namespace beast {
 namespace websocket {
@@ -40,10 +42,96 @@ public:
         }
     };
 
+    // Mask a buffer in several calls, at every alignment, and
+    // compare the data and the key against mask_inplace_fast.
+    template<class KeyType, class Function>
+    void
+    checkKernel(Function const& f)
+    {
+        std::mt19937 g;
+        std::vector<std::uint8_t> v0;
+        std::vector<std::uint8_t> v1;
+        for(std::size_t offset = 0; offset < 64; ++offset)
+        {
+            for(std::size_t size : {0, 1, 3, 15, 63, 64,
+                65, 127, 200, 511, 1000, 4096 + 13})
+            {
+                v0.resize(offset + size);
+                for(auto& c : v0)
+                    c = static_cast<std::uint8_t>(g());
+                v1 = v0;
+                KeyType k0;
+                prepare_key(k0, static_cast<std::uint32_t>(g()));
+                auto k1 = k0;
+                std::size_t pos = offset;
+                while(pos < v0.size())
+                {
+                    auto const n = (std::min<std::size_t>)(
+                        v0.size() - pos, 1 + g() % 300);
+                    mask_inplace_fast(boost::asio::mutable_buffer{
+                        &v0[pos], n}, k0);
+                    f(boost::asio::mutable_buffer{&v1[pos], n}, k1);
+                    pos += n;
+                }
+                if(! BEAST_EXPECT(v0 == v1 && k0 == k1))
+                    return;
+            }
+        }
+    }
+
+    template<class KeyType>
+    void
+    testKernels()
+    {
+        checkKernel<KeyType>(
+            [](boost::asio::mutable_buffer const& b, KeyType& key)
+            {
+                mask_inplace(b, key);
+            });
+#if BEAST_SIMD_X86
+        auto const& cpu = beast::detail::get_cpu_info();
+        checkKernel<KeyType>(&mask_inplace_sse2<KeyType>);
+        if(cpu.avx2)
+            checkKernel<KeyType>(&mask_inplace_avx2<KeyType>);
+        else
+            log << "avx2 not supported" << std::endl;
+        if(cpu.avx512bw)
+            checkKernel<KeyType>(&mask_inplace_avx512<KeyType>);
+        else
+            log << "avx512 not supported" << std::endl;
+#endif
+    }
+
+    void
+    testMask()
+    {
+        // Each byte is XORed with the key byte at its position
+        std::uint8_t b[11] = {};
+        std::uint32_t key;
+        prepare_key(key, 0x04030201);
+        mask_inplace(boost::asio::buffer(b), key);
+        std::uint8_t const x[11] = {1,2,3,4,1,2,3,4,1,2,3};
+        BEAST_EXPECT(std::equal(b, b + 11, x));
+        BEAST_EXPECT(key == 0x03020104);
+    }
+
     void run() override
     {
         maskgen_t<test_generator> mg;
         BEAST_EXPECT(mg() != 0);
+
+        // Streams on a thread share one generator
+        maskgen g1;
+        maskgen g2;
+        auto const k1 = g1();
+        auto const k2 = g2();
+        BEAST_EXPECT(k1 != 0);
+        BEAST_EXPECT(k2 != 0);
+        BEAST_EXPECT(k1 != k2);
+
+        testMask();
+        testKernels<std::uint32_t>();
+        testKernels<std::uint64_t>();
     }
 };
 
@@ -52,4 +140,3 @@ BEAST_DEFINE_TESTSUITE(mask,websocket,beast);
 } // detail
 } // websocket
 } // beast
-
@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <beast/websocket/detail/mask.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+class mask_bench_test : public beast::unit_test::suite
+{
+public:
+    template<class KeyType, class Function>
+    void
+    timedTest(std::string const& name,
+        std::size_t size, Function const& f)
+    {
+        using clock_type = std::chrono::high_resolution_clock;
+        using namespace std::chrono;
+        // About 1GB per trial
+        auto const repeat = (1024 * 1024 * 1024) / size;
+        std::vector<std::uint8_t> v(size + 1);
+        KeyType key;
+        prepare_key(key, 0x12345678);
+        // Offset by one to include the unaligned prologue
+        boost::asio::mutable_buffer const b{&v[1], size};
+        auto const t0 = clock_type::now();
+        for(std::size_t i = 0; i < repeat; ++i)
+            f(b, key);
+        auto const elapsed = duration_cast<
+            microseconds>(clock_type::now() - t0).count();
+        log <<
+            name << ", " << size << " bytes: " <<
+            (elapsed > 0 ? (repeat * size) / elapsed : 0) <<
+            " MB/s" << std::endl;
+    }
+
+    void
+    testSpeed(std::size_t size)
+    {
+        timedTest<prepared_key>("scalar", size,
+            [](boost::asio::mutable_buffer const& b, prepared_key& key)
+            {
+                mask_inplace_fast(b, key);
+            });
+#if BEAST_SIMD_X86
+        auto const& cpu = beast::detail::get_cpu_info();
+        timedTest<prepared_key>("sse2", size,
+            &mask_inplace_sse2<prepared_key>);
+        if(cpu.avx2)
+            timedTest<prepared_key>("avx2", size,
+                &mask_inplace_avx2<prepared_key>);
+        if(cpu.avx512bw)
+            timedTest<prepared_key>("avx512", size,
+                &mask_inplace_avx512<prepared_key>);
+#endif
+    }
+
+    void run() override
+    {
+        testSpeed(64);
+        testSpeed(4096);
+        testSpeed(1024 * 1024);
+        pass();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(mask_bench,websocket,beast);
+
+} // detail
+} // websocket
+} // beast
@@ -0,0 +1,127 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/detail/mask_utf8.hpp>
+
+#include <beast/core/streambuf.hpp>
+#include <beast/core/to_string.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <random>
+#include <string>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+class mask_utf8_test : public beast::unit_test::suite
+{
+public:
+    static
+    std::string
+    make_text(std::size_t size)
+    {
+        std::string s;
+        while(s.size() < size)
+            s.append("{\"text\":\"Gr\xc3\xbc\xc3\x9f\xe6\x97\xa5\xf0\x9f\x98\x80\"},");
+        return s;
+    }
+
+    // Unmask with mask_utf8_inplace, comparing the result and the
+    // key against mask_inplace followed by utf8_checker::write.
+    void
+    check(std::string const& text, std::size_t split)
+    {
+        std::mt19937 g;
+        auto const k = static_cast<std::uint32_t>(g());
+        std::string masked = text;
+        {
+            prepared_key key;
+            prepare_key(key, k);
+            mask_inplace(boost::asio::buffer(&masked[0],
+                masked.size()), key);
+        }
+        utf8_checker u0;
+        utf8_checker u1;
+        prepared_key k0;
+        prepared_key k1;
+        prepare_key(k0, k);
+        prepare_key(k1, k);
+        std::string s0 = masked;
+        std::string s1 = masked;
+        bool r0 = true;
+        bool r1 = true;
+        for(std::size_t pos = 0; pos < text.size(); pos += split)
+        {
+            auto const n = (std::min)(split, text.size() - pos);
+            boost::asio::mutable_buffers_1 b0{&s0[pos], n};
+            boost::asio::mutable_buffers_1 b1{&s1[pos], n};
+            mask_inplace(b0, k0);
+            r0 = r0 && u0.write(b0);
+            r1 = r1 && mask_utf8_inplace(b1, k1, u1);
+        }
+        BEAST_EXPECT(r0 == r1);
+        if(r0)
+        {
+            BEAST_EXPECT(s0 == text);
+            BEAST_EXPECT(s1 == text);
+            BEAST_EXPECT(k0 == k1);
+            BEAST_EXPECT(u0.finish() == u1.finish());
+        }
+    }
+
+    void
+    testMaskUtf8()
+    {
+        for(auto size : {0, 1, 100, 2047, 2048, 2049, 10000, 70000})
+        {
+            auto const text = make_text(size);
+            for(auto split : {1, 7, 64, 1000, 4096, 100000})
+                check(text, split);
+            // Invalid text
+            auto bad = text;
+            if(! bad.empty())
+            {
+                bad[bad.size() / 2] = '\xff';
+                check(bad, 1000);
+            }
+        }
+    }
+
+    void
+    testBufferSequence()
+    {
+        auto const text = make_text(5000);
+        std::string masked = text;
+        prepared_key key;
+        prepare_key(key, 0x12345678);
+        mask_inplace(boost::asio::buffer(
+            &masked[0], masked.size()), key);
+        // Spread over several buffers
+        streambuf sb(1000);
+        auto const b = sb.prepare(masked.size());
+        boost::asio::buffer_copy(b, boost::asio::buffer(masked));
+        utf8_checker utf8;
+        prepare_key(key, 0x12345678);
+        BEAST_EXPECT(mask_utf8_inplace(b, key, utf8));
+        BEAST_EXPECT(utf8.finish());
+        sb.commit(masked.size());
+        BEAST_EXPECT(to_string(sb.data()) == text);
+    }
+
+    void run() override
+    {
+        testMaskUtf8();
+        testBufferSequence();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(mask_utf8,websocket,beast);
+
+} // detail
+} // websocket
+} // beast
@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "websocket_sync_echo_server.hpp"
+
+#include <beast/websocket/stream.hpp>
+#include <beast/websocket/detail/buffer_pool.hpp>
+#include <beast/core/streambuf.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <list>
+#include <string>
+#include <thread>
+
+namespace beast {
+namespace websocket {
+
+class memory_bench_test : public beast::unit_test::suite
+{
+public:
+    using endpoint_type = boost::asio::ip::tcp::endpoint;
+    using address_type = boost::asio::ip::address;
+    using socket_type = boost::asio::ip::tcp::socket;
+
+    // Open connections which each exchange one message and then
+    // go idle, and report the memory each one holds while idle.
+    void
+    testIdle(permessage_deflate const& pmd)
+    {
+        std::size_t const count = 100;
+        auto& pool = detail::buffer_pool::instance();
+        error_code ec;
+        ::websocket::sync_echo_server server{nullptr};
+        server.set_option(pmd);
+        server.open(endpoint_type{
+            address_type::from_string("127.0.0.1"), 0}, ec);
+        if(! BEAST_EXPECTS(! ec, ec.message()))
+            return;
+        auto const ep = server.local_endpoint();
+        boost::asio::io_service ios;
+        std::string const s(10000, '*');
+        std::list<stream<socket_type>> list;
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            list.emplace_back(ios);
+            auto& ws = list.back();
+            ws.set_option(pmd);
+            ws.next_layer().connect(ep);
+            ws.next_layer().set_option(
+                boost::asio::ip::tcp::no_delay{true});
+            ws.handshake("localhost", "/");
+            ws.write(boost::asio::buffer(s));
+            opcode op;
+            streambuf sb;
+            ws.read(op, sb);
+            BEAST_EXPECT(sb.size() == s.size());
+        }
+        // Let the server finish its last write
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        log <<
+            "permessage-deflate " <<
+                (! pmd.client_enable ? "off" :
+                    pmd.client_no_context_takeover ?
+                        "without context takeover" : "on") <<
+            ", " << count << " idle connections:\n" <<
+            "    sizeof(stream)          " <<
+                sizeof(stream<socket_type>) << "\n" <<
+            "    buffer bytes per stream " <<
+                pool.in_use() / (2 * count) << "\n" <<
+            "    idle bytes in the pool  " << pool.idle() << std::endl;
+        for(auto& ws : list)
+            ws.close({}, ec);
+    }
+
+    void run() override
+    {
+        permessage_deflate pmd;
+        pmd.client_enable = false;
+        pmd.server_enable = false;
+        testIdle(pmd);
+        pmd.client_enable = true;
+        pmd.server_enable = true;
+        testIdle(pmd);
+        pmd.client_no_context_takeover = true;
+        pmd.server_no_context_takeover = true;
+        testIdle(pmd);
+        pass();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(memory_bench,websocket,beast);
+
+} // websocket
+} // beast
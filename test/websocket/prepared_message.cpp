@@ -0,0 +1,231 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/prepared_message.hpp>
+
+#include "websocket_sync_echo_server.hpp"
+
+#include <beast/websocket/stream.hpp>
+#include <beast/core/streambuf.hpp>
+#include <beast/core/to_string.hpp>
+#include <beast/zlib/inflate_stream.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <boost/asio.hpp>
+#include <string>
+#include <thread>
+
+namespace beast {
+namespace websocket {
+
+class prepared_message_test : public beast::unit_test::suite
+{
+public:
+    using endpoint_type = boost::asio::ip::tcp::endpoint;
+    using address_type = boost::asio::ip::address;
+    using socket_type = boost::asio::ip::tcp::socket;
+
+    static
+    std::string
+    text()
+    {
+        std::string s;
+        while(s.size() < 10000)
+            s.append("The quick brown fox jumps over the lazy dog. ");
+        return s;
+    }
+
+    static
+    std::string
+    random()
+    {
+        std::string s(10000, 0);
+        std::uint32_t x = 1;
+        for(auto& c : s)
+        {
+            x = x * 1664525 + 1013904223;
+            c = static_cast<char>(x >> 24);
+        }
+        return s;
+    }
+
+    void
+    testConstruct()
+    {
+        using boost::asio::buffer;
+        using boost::asio::buffer_cast;
+        using boost::asio::buffer_size;
+        {
+            prepared_message m(opcode::binary, buffer("Hello", 5));
+            BEAST_EXPECT(m.type() == opcode::binary);
+            BEAST_EXPECT(m.size() == 5);
+            BEAST_EXPECT(! m.compressed());
+            auto const bs = m.frame(false);
+            BEAST_EXPECT(to_string(bs) == "\x82\x05" "Hello");
+        }
+        {
+            auto const s = text();
+            prepared_message m(opcode::text, buffer(s));
+            BEAST_EXPECT(! m.compressed());
+            auto const bs = m.frame(false);
+            BEAST_EXPECT(buffer_size(bs[0]) == 4);
+            BEAST_EXPECT(to_string(
+                boost::asio::const_buffers_1(bs[1])) == s);
+        }
+        {
+            // Compressed once, inflates to the payload
+            auto const s = text();
+            permessage_deflate pmd;
+            pmd.server_enable = true;
+            pmd.server_max_window_bits = 10;
+            prepared_message m(opcode::text, buffer(s), pmd);
+            BEAST_EXPECT(m.compressed());
+            BEAST_EXPECT(m.window_bits() == 10);
+            auto const bs = m.frame(true);
+            BEAST_EXPECT(buffer_cast<std::uint8_t const*>(
+                bs[0])[0] == 0xc1);
+            BEAST_EXPECT(buffer_size(bs[1]) < s.size());
+            std::string in = to_string(
+                boost::asio::const_buffers_1(bs[1]));
+            in.append("\x00\x00\xff\xff", 4);
+            std::string out(s.size(), 0);
+            zlib::inflate_stream zi;
+            zi.reset(15);
+            zlib::z_params zs;
+            zs.next_in = in.data();
+            zs.avail_in = in.size();
+            zs.next_out = &out[0];
+            zs.avail_out = out.size();
+            error_code ec;
+            zi.write(zs, zlib::Flush::sync, ec);
+            BEAST_EXPECTS(! ec, ec.message());
+            BEAST_EXPECT(zs.total_out == s.size());
+            BEAST_EXPECT(out == s);
+        }
+        {
+            // Incompressible payloads are kept only as they are
+            auto const s = random();
+            permessage_deflate pmd;
+            pmd.server_enable = true;
+            prepared_message m(opcode::binary, buffer(s), pmd);
+            BEAST_EXPECT(! m.compressed());
+        }
+        try
+        {
+            prepared_message m(opcode::ping, buffer("", 0));
+            fail();
+        }
+        catch(std::invalid_argument const&)
+        {
+            pass();
+        }
+    }
+
+    // A server sends the same prepared message to a client
+    void
+    testServer(permessage_deflate const& pmd)
+    {
+        auto const s = text();
+        prepared_message const m(opcode::text,
+            boost::asio::buffer(s), pmd);
+        boost::asio::io_service ios;
+        boost::asio::ip::tcp::acceptor acceptor(ios,
+            endpoint_type{address_type::from_string("127.0.0.1"), 0});
+        std::thread t(
+            [&]
+            {
+                boost::asio::io_service ios2;
+                stream<socket_type> ws(ios2);
+                ws.set_option(pmd);
+                ws.next_layer().connect(acceptor.local_endpoint());
+                ws.handshake("localhost", "/");
+                for(int i = 0; i < 3; ++i)
+                {
+                    opcode op;
+                    streambuf sb;
+                    ws.read(op, sb);
+                    BEAST_EXPECT(op == opcode::text);
+                    BEAST_EXPECT(to_string(sb.data()) == s);
+                }
+                error_code ec;
+                ws.close({}, ec);
+            });
+        stream<socket_type> ws(ios);
+        ws.set_option(pmd);
+        acceptor.accept(ws.next_layer());
+        ws.accept();
+        ws.write_prepared(m);
+        // Prepared and ordinary messages may be mixed
+        ws.write(boost::asio::buffer(s));
+        ws.write_prepared(m);
+        error_code ec;
+        opcode op;
+        streambuf sb;
+        ws.read(op, sb, ec);
+        BEAST_EXPECT(ec == error::closed);
+        t.join();
+    }
+
+    // A client masks a copy of the prepared payload
+    void
+    testClient(permessage_deflate const& pmd)
+    {
+        auto const s = text();
+        prepared_message const m(opcode::text,
+            boost::asio::buffer(s), pmd);
+        error_code ec;
+        ::websocket::sync_echo_server server{nullptr};
+        server.set_option(pmd);
+        server.open(endpoint_type{
+            address_type::from_string("127.0.0.1"), 0}, ec);
+        if(! BEAST_EXPECTS(! ec, ec.message()))
+            return;
+        boost::asio::io_service ios;
+        stream<socket_type> ws(ios);
+        ws.set_option(pmd);
+        ws.next_layer().connect(server.local_endpoint());
+        ws.handshake("localhost", "/");
+        for(int i = 0; i < 2; ++i)
+        {
+            ws.write_prepared(m);
+            opcode op;
+            streambuf sb;
+            ws.read(op, sb);
+            BEAST_EXPECT(op == opcode::text);
+            BEAST_EXPECT(to_string(sb.data()) == s);
+        }
+        ws.close({}, ec);
+    }
+
+    void run() override
+    {
+        testConstruct();
+
+        permessage_deflate pmd;
+        pmd.client_enable = false;
+        pmd.server_enable = false;
+        testServer(pmd);
+        testClient(pmd);
+
+        pmd.client_enable = true;
+        pmd.server_enable = true;
+        pmd.server_no_context_takeover = true;
+        pmd.client_no_context_takeover = true;
+        testServer(pmd);
+        testClient(pmd);
+
+        pmd.server_no_context_takeover = false;
+        pmd.client_no_context_takeover = false;
+        testServer(pmd);
+        testClient(pmd);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(prepared_message,websocket,beast);
+
+} // websocket
+} // beast
@@ -15,17 +15,50 @@
 #include <beast/core/to_string.hpp>
 #include <beast/test/fail_stream.hpp>
 #include <beast/test/string_istream.hpp>
+#include <beast/test/string_ostream.hpp>
 #include <beast/test/yield_to.hpp>
 #include <beast/unit_test/suite.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/spawn.hpp>
 #include <boost/optional.hpp>
+#include <array>
+#include <memory>
+#include <functional>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
+#include <vector>
 
 namespace beast {
 namespace websocket {
 
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+// Local sockets are only used by tests, which end
+// them without a TCP style shutdown.
+
+inline
+void
+teardown(teardown_tag,
+    boost::asio::local::stream_protocol::socket& socket,
+        error_code& ec)
+{
+    socket.close(ec);
+}
+
+template<class TeardownHandler>
+inline
+void
+async_teardown(teardown_tag,
+    boost::asio::local::stream_protocol::socket& socket,
+        TeardownHandler&& handler)
+{
+    error_code ec;
+    socket.close(ec);
+    socket.get_io_service().post(bind_handler(
+        std::forward<TeardownHandler>(handler), ec));
+}
+#endif
+
 class stream_test
     : public beast::unit_test::suite
     , public test::enable_yield_to
@@ -154,6 +187,105 @@ public:
         }
     }
 
+    void testCompressible()
+    {
+        using boost::asio::buffer;
+        using detail::pmd_compressible;
+        std::string s;
+        // Short payloads are not sampled
+        s.assign(100, '\0');
+        for(std::size_t i = 0; i < s.size(); ++i)
+            s[i] = static_cast<char>(i * 167);
+        BEAST_EXPECT(pmd_compressible(buffer(s)));
+        // Text compresses
+        s.clear();
+        while(s.size() < 4096)
+            s.append("The quick brown fox jumps over the lazy dog. ");
+        BEAST_EXPECT(pmd_compressible(buffer(s)));
+        // Uniformly distributed octets do not
+        s.resize(4096);
+        std::uint32_t x = 1;
+        for(auto& c : s)
+        {
+            x = x * 1664525 + 1013904223;
+            c = static_cast<char>(x >> 24);
+        }
+        BEAST_EXPECT(! pmd_compressible(buffer(s)));
+        // The sample may span several buffers
+        std::array<boost::asio::const_buffer, 2> bs{{
+            buffer(s.data(), 100), buffer(s.data() + 100, 2000)}};
+        BEAST_EXPECT(! pmd_compressible(bs));
+    }
+
+    void testNegotiate()
+    {
+        using detail::pmd_offer;
+        auto const read =
+            [](boost::string_ref const& ext)
+            {
+                http::fields f;
+                f.insert("Sec-WebSocket-Extensions", ext);
+                pmd_offer offer;
+                detail::pmd_read(offer, f);
+                return offer;
+            };
+        permessage_deflate o;
+        o.client_enable = true;
+        o.server_enable = true;
+        o.server_max_window_bits = 10;
+        o.client_max_window_bits = 9;
+        {
+            // Both windows are limited by the server's policy
+            http::fields f;
+            pmd_offer config;
+            detail::pmd_negotiate(f, config, read(
+                "permessage-deflate; client_max_window_bits"), o);
+            BEAST_EXPECT(config.accept);
+            BEAST_EXPECT(config.server_max_window_bits == 10);
+            BEAST_EXPECT(config.client_max_window_bits == 9);
+            auto const res = read(f["Sec-WebSocket-Extensions"]);
+            BEAST_EXPECT(res.server_max_window_bits == 10);
+            BEAST_EXPECT(res.client_max_window_bits == 9);
+        }
+        {
+            // A request for a window of 8 bits is honored
+            http::fields f;
+            pmd_offer config;
+            detail::pmd_negotiate(f, config, read(
+                "permessage-deflate; server_max_window_bits=8; "
+                "client_max_window_bits=8"), o);
+            BEAST_EXPECT(config.accept);
+            auto const res = read(f["Sec-WebSocket-Extensions"]);
+            BEAST_EXPECT(res.server_max_window_bits == 8);
+            BEAST_EXPECT(res.client_max_window_bits == 8);
+        }
+        {
+            // A client which can't be limited is refused
+            http::fields f;
+            pmd_offer config;
+            detail::pmd_negotiate(f, config,
+                read("permessage-deflate"), o);
+            BEAST_EXPECT(! config.accept);
+        }
+        // The client checks the response against its offer
+        BEAST_EXPECT(detail::pmd_check(read(
+            "permessage-deflate; server_max_window_bits=10"), o));
+        BEAST_EXPECT(detail::pmd_check(read(
+            "permessage-deflate; server_max_window_bits=8; "
+            "client_max_window_bits=8"), o));
+        BEAST_EXPECT(! detail::pmd_check(read(
+            "permessage-deflate; server_max_window_bits=11"), o));
+        BEAST_EXPECT(! detail::pmd_check(read(
+            "permessage-deflate"), o));
+        BEAST_EXPECT(! detail::pmd_check(read(
+            "permessage-deflate; server_max_window_bits=10; "
+            "client_max_window_bits=10"), o));
+        o.client_enable = false;
+        BEAST_EXPECT(! detail::pmd_check(read(
+            "permessage-deflate"), o));
+        BEAST_EXPECT(detail::pmd_check(read(""), o));
+    }
+
     void testAccept()
     {
         {
@@ -223,6 +355,54 @@ public:
         }
     }
 
+    void testAcceptBuffered()
+    {
+        std::string const s =
+            "GET / HTTP/1.1\r\n"
+            "Host: localhost:80\r\n"
+            "Upgrade: WebSocket\r\n"
+            "Connection: keep-alive, upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "\r\n";
+        {
+            // fixed response matches the parsed one
+            stream<test::string_ostream> ws1(ios_);
+            ws1.accept(boost::asio::buffer(s));
+            stream<test::string_ostream> ws2(ios_);
+            ws2.set_option(decorate(identity{}));
+            ws2.accept(boost::asio::buffer(s));
+            BEAST_EXPECT(ws1.next_layer().str ==
+                ws2.next_layer().str);
+            BEAST_EXPECT(ws1.next_layer().str.find(
+                "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") !=
+                    std::string::npos);
+        }
+        {
+            // bytes after the request are kept
+            stream<test::string_istream> ws(ios_,
+                s + std::string("\x81\x82\0\0\0\0hi", 8));
+            ws.accept();
+            streambuf sb;
+            opcode op;
+            ws.read(op, sb);
+            BEAST_EXPECT(op == opcode::text);
+            BEAST_EXPECT(to_string(sb.data()) == "hi");
+        }
+        {
+            // extension offers go to the parser
+            stream<test::string_ostream> ws(ios_);
+            permessage_deflate pmd;
+            pmd.server_enable = true;
+            ws.set_option(pmd);
+            ws.accept(boost::asio::buffer(s.substr(0, s.size() - 2) +
+                "Sec-WebSocket-Extensions: permessage-deflate\r\n\r\n"));
+            BEAST_EXPECT(ws.next_layer().str.find(
+                "Sec-WebSocket-Extensions: permessage-deflate") !=
+                    std::string::npos);
+        }
+    }
+
     void testBadHandshakes()
     {
         auto const check =
@@ -807,6 +987,743 @@ public:
         }
     }
 
+    void
+    testQueue(endpoint_type const& ep)
+    {
+        boost::asio::io_service ios;
+        stream<socket_type> ws(ios);
+        ws.set_option(write_queue_limit{4000});
+        ws.next_layer().connect(ep);
+        ws.handshake("localhost", "/");
+        {
+            // Refused while another write sends a message
+            ws.async_write(boost::asio::buffer("first", 5),
+                [&](error_code ec)
+                {
+                    BEAST_EXPECTS(! ec, ec.message());
+                });
+            BEAST_EXPECT(! ws.enqueue(boost::asio::buffer("x", 1)));
+            ios.run();
+            ios.reset();
+            opcode op;
+            streambuf db;
+            ws.read(op, db);
+            BEAST_EXPECT(to_string(db.data()) == "first");
+        }
+        auto const message =
+            [](int i)
+            {
+                return "message " + std::to_string(i) +
+                    std::string(i % 50, '*');
+            };
+        int const count = 500;
+        int queued = 0;
+        int refused = 0;
+        std::function<void()> produce =
+            [&]
+            {
+                while(queued < count)
+                {
+                    auto const s = message(queued);
+                    if(! ws.enqueue(boost::asio::buffer(s)))
+                    {
+                        // The queue is full, wait for it to drain
+                        ++refused;
+                        BEAST_EXPECT(ws.queue_size() > 0);
+                        ws.async_flush(
+                            [&](error_code ec)
+                            {
+                                BEAST_EXPECTS(! ec, ec.message());
+                                BEAST_EXPECT(ws.queue_size() == 0);
+                                produce();
+                            });
+                        return;
+                    }
+                    ++queued;
+                }
+            };
+        produce();
+        ios.run();
+        BEAST_EXPECT(queued == count);
+        BEAST_EXPECT(refused > 0);
+        // The messages are echoed in order
+        for(int i = 0; i < count; ++i)
+        {
+            opcode op;
+            streambuf db;
+            ws.read(op, db);
+            if(! BEAST_EXPECT(to_string(db.data()) == message(i)))
+                break;
+        }
+        ws.close({});
+    }
+
+    // Messages submitted from several threads are
+    // each sent once, in the order of their thread.
+    void
+    testSubmit(endpoint_type const& ep)
+    {
+        boost::asio::io_service ios;
+        stream<socket_type> ws(ios);
+        ws.set_option(write_queue_limit{4000});
+        ws.next_layer().connect(ep);
+        ws.handshake("localhost", "/");
+
+        // Submitted bytes are limited until they are sent
+        std::string const big(1000, '*');
+        int accepted = 0;
+        while(ws.submit(boost::asio::buffer(big)))
+            ++accepted;
+        BEAST_EXPECT(accepted == 4);
+        ios.run();
+        ios.reset();
+        for(int i = 0; i < accepted; ++i)
+        {
+            opcode op;
+            streambuf db;
+            ws.read(op, db);
+            BEAST_EXPECT(to_string(db.data()) == big);
+        }
+
+        auto const message =
+            [](int t, int i)
+            {
+                return std::to_string(t) + " " +
+                    std::to_string(i) + std::string(i % 20, '*');
+            };
+        int const threads = 4;
+        int const count = 200;
+        std::unique_ptr<boost::asio::io_service::work> work(
+            new boost::asio::io_service::work(ios));
+        // Two threads run the io_service, so the
+        // program's operations use the stream's strand
+        std::thread runner([&]{ ios.run(); });
+        std::thread runner2([&]{ ios.run(); });
+        std::vector<std::thread> producers;
+        for(int t = 0; t < threads; ++t)
+            producers.emplace_back(
+                [&, t]
+                {
+                    for(int i = 0; i < count;)
+                    {
+                        auto const s = message(t, i);
+                        if(ws.submit(boost::asio::buffer(s)))
+                            ++i;
+                        else
+                            std::this_thread::yield();
+                    }
+                });
+        for(auto& p : producers)
+            p.join();
+        ws.get_strand().post(
+            [&]
+            {
+                ws.async_flush(ws.get_strand().wrap(
+                    [&](error_code ec)
+                    {
+                        BEAST_EXPECTS(! ec, ec.message());
+                        work.reset();
+                    }));
+            });
+        runner.join();
+        runner2.join();
+        std::vector<int> next(threads, 0);
+        for(int i = 0; i < threads * count; ++i)
+        {
+            opcode op;
+            streambuf db;
+            ws.read(op, db);
+            auto const s = to_string(db.data());
+            auto const t = std::stoi(s);
+            if(! BEAST_EXPECT(t >= 0 && t < threads))
+                break;
+            if(! BEAST_EXPECT(s == message(t, next[t])))
+                break;
+            ++next[t];
+        }
+        ws.close({});
+    }
+
+    void
+    testControlLatency(endpoint_type const& ep)
+    {
+        boost::asio::io_service ios;
+        stream<socket_type> ws(ios);
+        ws.set_option(auto_fragment{false});
+        ws.set_option(message_type{opcode::binary});
+        ws.set_option(control_latency{
+            std::chrono::milliseconds(1)});
+        ws.next_layer().connect(ep);
+        ws.handshake("localhost", "/");
+        std::string const s(1024 * 1024, '*');
+        // The ping goes out between fragments
+        // instead of waiting for the whole message.
+        int n = 0;
+        int wrote = 0;
+        int pinged = 0;
+        ws.async_write(boost::asio::buffer(s),
+            [&](error_code ec)
+            {
+                BEAST_EXPECTS(! ec, ec.message());
+                wrote = ++n;
+            });
+        ws.async_ping({},
+            [&](error_code ec)
+            {
+                BEAST_EXPECTS(! ec, ec.message());
+                pinged = ++n;
+            });
+        ios.run();
+        BEAST_EXPECT(pinged == 1);
+        BEAST_EXPECT(wrote == 2);
+        opcode op;
+        streambuf db;
+        ws.read(op, db);
+        BEAST_EXPECT(to_string(db.data()) == s);
+        ws.close({});
+    }
+
+    void
+    testReadBatch(endpoint_type const& ep)
+    {
+        boost::asio::io_service ios;
+        stream<socket_type> ws(ios);
+        ws.next_layer().connect(ep);
+        ws.handshake("localhost", "/");
+        // One large message takes the regular read path
+        auto const message =
+            [](std::size_t i)
+            {
+                if(i == 100)
+                    return std::string(10000, '*');
+                return "message " + std::to_string(i);
+            };
+        std::size_t const count = 200;
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            // The pong arrives between messages
+            if(i == 50)
+                ws.ping({});
+            ws.write(boost::asio::buffer(message(i)));
+        }
+        std::vector<message_info> messages;
+        streambuf db;
+        std::size_t batches = 0;
+        std::function<void()> read =
+            [&]
+            {
+                ws.async_read_batch(messages, db,
+                    [&](error_code ec)
+                    {
+                        if(! BEAST_EXPECTS(! ec, ec.message()))
+                            return;
+                        ++batches;
+                        if(messages.size() < count)
+                            read();
+                    });
+            };
+        read();
+        ios.run();
+        BEAST_EXPECT(messages.size() == count);
+        BEAST_EXPECT(batches < count);
+        // Payloads are appended in order
+        for(std::size_t i = 0; i < messages.size(); ++i)
+        {
+            auto const s = message(i);
+            BEAST_EXPECT(messages[i].op == opcode::text);
+            if(! BEAST_EXPECT(messages[i].size == s.size()))
+                break;
+            BEAST_EXPECT(to_string(prepare_buffers(
+                s.size(), db.data())) == s);
+            db.consume(s.size());
+        }
+        // Synchronous batches see the same stream
+        messages.clear();
+        ws.write(boost::asio::buffer("done", 4));
+        ws.read_batch(messages, db);
+        BEAST_EXPECT(messages.size() == 1);
+        BEAST_EXPECT(to_string(db.data()) == "done");
+        ws.close({});
+    }
+
+    void
+    testWriteInplace(endpoint_type const& ep)
+    {
+        boost::asio::io_service ios;
+        stream<socket_type> ws(ios);
+        ws.set_option(auto_fragment{false});
+        ws.next_layer().connect(ep);
+        ws.handshake("localhost", "/");
+        std::string const s(100000, '*');
+        // The payload is masked where it lies
+        std::string m = s;
+        ws.write_inplace(boost::asio::buffer(&m[0], m.size()));
+        BEAST_EXPECT(m != s);
+        opcode op;
+        streambuf db;
+        ws.read(op, db);
+        BEAST_EXPECT(to_string(db.data()) == s);
+        db.consume(db.size());
+        m = s;
+        ws.set_option(auto_fragment{true});
+        ws.async_write_inplace(boost::asio::buffer(&m[0], m.size()),
+            [&](error_code ec)
+            {
+                BEAST_EXPECTS(! ec, ec.message());
+            });
+        ios.run();
+        ws.read(op, db);
+        BEAST_EXPECT(to_string(db.data()) == s);
+        ws.close({});
+    }
+
+    // Compressed messages are delivered in bounded pieces,
+    // and their size limit applies after decompression.
+    void
+    testInflateLimit()
+    {
+        permessage_deflate pmd;
+        pmd.client_enable = true;
+        pmd.server_enable = true;
+        error_code ec;
+        ::websocket::sync_echo_server server{nullptr};
+        server.set_option(pmd);
+        server.open(endpoint_type{
+            address_type::from_string("127.0.0.1"), 0}, ec);
+        BEAST_EXPECTS(! ec, ec.message());
+        auto const ep = server.local_endpoint();
+        std::string const s(200000, '*');
+        {
+            boost::asio::io_service ios;
+            stream<socket_type> ws(ios);
+            ws.set_option(pmd);
+            ws.set_option(read_inflate_limit{1000});
+            ws.next_layer().connect(ep);
+            ws.handshake("localhost", "/");
+            ws.write(boost::asio::buffer(s));
+            streambuf db;
+            frame_info fi;
+            std::size_t pieces = 0;
+            do
+            {
+                auto const prev = db.size();
+                ws.read_frame(fi, db);
+                BEAST_EXPECT(db.size() - prev <= 1000);
+                BEAST_EXPECT(fi.op == opcode::text);
+                ++pieces;
+            }
+            while(! fi.fin);
+            BEAST_EXPECT(pieces >= s.size() / 1000);
+            BEAST_EXPECT(to_string(db.data()) == s);
+            // An asynchronous read continues the same frame
+            db.consume(db.size());
+            ws.write(boost::asio::buffer(s));
+            ws.read_frame(fi, db);
+            BEAST_EXPECT(! fi.fin);
+            opcode op;
+            ws.async_read(op, db,
+                [&](error_code ec)
+                {
+                    BEAST_EXPECTS(! ec, ec.message());
+                });
+            ios.run();
+            BEAST_EXPECT(op == opcode::text);
+            BEAST_EXPECT(to_string(db.data()) == s);
+            ws.close({});
+        }
+        {
+            boost::asio::io_service ios;
+            stream<socket_type> ws(ios);
+            ws.set_option(pmd);
+            ws.set_option(read_message_max{10000});
+            ws.next_layer().connect(ep);
+            ws.handshake("localhost", "/");
+            ws.write(boost::asio::buffer(s));
+            opcode op;
+            streambuf db;
+            ws.read(op, db, ec);
+            BEAST_EXPECTS(ec == error::failed, ec.message());
+            BEAST_EXPECT(db.size() <= 10001);
+        }
+    }
+
+    // A server which limits its window compresses with
+    // the window it negotiated, not the one offered.
+    void
+    testWindowBits()
+    {
+        permessage_deflate pmd;
+        pmd.client_enable = true;
+        pmd.server_enable = true;
+        error_code ec;
+        ::websocket::sync_echo_server server{nullptr};
+        {
+            auto o = pmd;
+            o.server_max_window_bits = 9;
+            server.set_option(o);
+        }
+        server.open(endpoint_type{
+            address_type::from_string("127.0.0.1"), 0}, ec);
+        BEAST_EXPECTS(! ec, ec.message());
+        // Repeats lie further apart than the window
+        std::string block(2000, ' ');
+        std::uint32_t x = 1;
+        for(auto& c : block)
+        {
+            x = x * 1664525 + 1013904223;
+            c = 'a' + (x >> 24) % 26;
+        }
+        std::string s;
+        for(int i = 0; i < 50; ++i)
+            s += block;
+        boost::asio::io_service ios;
+        stream<socket_type> ws(ios);
+        ws.set_option(pmd);
+        ws.next_layer().connect(server.local_endpoint());
+        ws.handshake("localhost", "/");
+        ws.write(boost::asio::buffer(s));
+        opcode op;
+        streambuf db;
+        ws.read(op, db, ec);
+        BEAST_EXPECTS(! ec, ec.message());
+        BEAST_EXPECT(to_string(db.data()) == s);
+        ws.close({});
+    }
+
+    // Large messages compressed on the worker pool
+    // arrive intact, and in the order they were sent.
+    void
+    testOffload()
+    {
+        permessage_deflate pmd;
+        pmd.client_enable = true;
+        pmd.server_enable = true;
+        pmd.offload_threshold = 10000;
+        error_code ec;
+        ::websocket::sync_echo_server server{nullptr};
+        server.set_option(pmd);
+        server.open(endpoint_type{
+            address_type::from_string("127.0.0.1"), 0}, ec);
+        BEAST_EXPECTS(! ec, ec.message());
+        auto const ep = server.local_endpoint();
+        std::string s1(200000, '*');
+        for(std::size_t i = 0; i < s1.size(); i += 7)
+            s1[i] = 'a' + i % 26;
+        std::string const s2(100, '-');
+        for(auto const frag : {false, true})
+        {
+            boost::asio::io_service ios;
+            stream<socket_type> ws(ios);
+            ws.set_option(pmd);
+            ws.set_option(auto_fragment{frag});
+            ws.set_option(write_buffer_size{4096});
+            ws.next_layer().connect(ep);
+            ws.handshake("localhost", "/");
+            ws.async_write(boost::asio::buffer(s1),
+                [&](error_code ec)
+                {
+                    BEAST_EXPECTS(! ec, ec.message());
+                    ws.async_write(boost::asio::buffer(s2),
+                        [&](error_code ec)
+                        {
+                            BEAST_EXPECTS(! ec, ec.message());
+                        });
+                });
+            // Waits for the compressed message
+            ws.async_ping({},
+                [&](error_code ec)
+                {
+                    BEAST_EXPECTS(! ec, ec.message());
+                });
+            ios.run();
+            opcode op;
+            streambuf db;
+            ws.read(op, db);
+            BEAST_EXPECT(to_string(db.data()) == s1);
+            db.consume(db.size());
+            ws.read(op, db);
+            BEAST_EXPECT(to_string(db.data()) == s2);
+            ws.close({});
+        }
+    }
+
+    // Messages pass through a proxy which relays frames
+    // between its two streams, whether compressed frames
+    // are sent as they are or inflated on the way.
+    void
+    testRelay(permessage_deflate const& front_pmd,
+        permessage_deflate const& back_pmd, bool sync)
+    {
+        auto const any = endpoint_type{
+            address_type::from_string("127.0.0.1"), 0};
+        error_code ec;
+        ::websocket::sync_echo_server server{nullptr};
+        server.set_option(back_pmd);
+        server.open(any, ec);
+        BEAST_EXPECTS(! ec, ec.message());
+
+        boost::asio::io_service pios;
+        boost::asio::ip::tcp::acceptor acceptor{pios, any};
+        stream<socket_type> front(pios);
+        stream<socket_type> back(pios);
+        front.set_option(front_pmd);
+        front.set_option(read_buffer_size{1000});
+        back.set_option(back_pmd);
+        back.set_option(read_buffer_size{1000});
+        std::function<void(
+            stream<socket_type>&, stream<socket_type>&)> relay =
+            [&](stream<socket_type>& from, stream<socket_type>& to)
+            {
+                auto fi = std::make_shared<frame_info>();
+                from.async_relay_frame(*fi, to,
+                    [&, fi](error_code ec)
+                    {
+                        if(! ec)
+                            return relay(from, to);
+                        // Stop relaying the other way
+                        to.next_layer().shutdown(
+                            socket_type::shutdown_both, ec);
+                    });
+            };
+        std::thread proxy(
+            [&]
+            {
+                error_code ec;
+                acceptor.accept(front.next_layer());
+                front.accept();
+                back.next_layer().connect(server.local_endpoint());
+                back.handshake("localhost", "/");
+                if(! sync)
+                {
+                    relay(front, back);
+                    relay(back, front);
+                    pios.run();
+                    return;
+                }
+                std::thread t(
+                    [&]
+                    {
+                        error_code ec;
+                        frame_info fi;
+                        while(! ec)
+                            back.relay_frame(fi, front, ec);
+                    });
+                frame_info fi;
+                while(! ec)
+                    front.relay_frame(fi, back, ec);
+                back.next_layer().shutdown(
+                    socket_type::shutdown_both, ec);
+                t.join();
+            });
+
+        boost::asio::io_service ios;
+        stream<socket_type> ws(ios);
+        ws.set_option(front_pmd);
+        ws.set_option(write_buffer_size{4096});
+        ws.next_layer().connect(acceptor.local_endpoint());
+        ws.handshake("localhost", "/");
+        for(auto const frag : {false, true})
+        {
+            // Fragmented messages are relayed frame by frame
+            ws.set_option(auto_fragment{frag});
+            for(std::size_t const n :
+                {0, 10, 126, 5000, 70000, 300000})
+            {
+                std::string s(n, '*');
+                for(std::size_t i = 0; i < n; i += 3)
+                    s[i] = 'a' + i * 7 % 26;
+                ws.set_option(message_type{frag ?
+                    opcode::binary : opcode::text});
+                ws.write(boost::asio::buffer(s));
+                opcode op;
+                streambuf db;
+                ws.read(op, db);
+                BEAST_EXPECT(op == (frag ?
+                    opcode::binary : opcode::text));
+                if(! BEAST_EXPECT(to_string(db.data()) == s))
+                    break;
+            }
+        }
+        ws.close({});
+        try
+        {
+            opcode op;
+            streambuf db;
+            for(;;)
+                ws.read(op, db);
+        }
+        catch(system_error const&)
+        {
+        }
+        proxy.join();
+    }
+
+    // A server with an idle timeout pings a quiet
+    // client, and gives up on one that never answers.
+    void
+    testIdleTimeout(bool answer)
+    {
+        using clock_type = std::chrono::steady_clock;
+        boost::asio::io_service ios;
+        boost::asio::ip::tcp::acceptor acceptor(ios,
+            endpoint_type{address_type::from_string("127.0.0.1"), 0});
+        int pings = 0;
+        std::thread t(
+            [&]
+            {
+                boost::asio::io_service ios2;
+                stream<socket_type> ws(ios2);
+                ws.set_option(ping_callback{
+                    [&](bool is_pong, ping_data const&)
+                    {
+                        if(! is_pong)
+                            ++pings;
+                    }});
+                ws.next_layer().connect(acceptor.local_endpoint());
+                ws.handshake("localhost", "/");
+                if(! answer)
+                {
+                    // Pings are not answered unless reading
+                    std::this_thread::sleep_for(
+                        std::chrono::milliseconds(1000));
+                    return;
+                }
+                opcode op;
+                streambuf sb;
+                ws.read(op, sb);
+                BEAST_EXPECT(to_string(sb.data()) == "done");
+                error_code ec;
+                ws.close({}, ec);
+                ws.read(op, sb, ec);
+            });
+        stream<socket_type> ws(ios);
+        ws.set_option(idle_timeout{std::chrono::milliseconds(100)});
+        acceptor.accept(ws.next_layer());
+        ws.accept();
+        auto const start = clock_type::now();
+        error_code result;
+        auto elapsed = clock_type::duration::zero();
+        opcode op;
+        streambuf sb;
+        ws.async_read(op, sb,
+            [&](error_code ec)
+            {
+                result = ec;
+                elapsed = clock_type::now() - start;
+            });
+        boost::asio::basic_waitable_timer<clock_type> timer(ios);
+        if(answer)
+        {
+            // Outlive the timeout a few times over
+            timer.expires_from_now(std::chrono::milliseconds(400));
+            timer.async_wait(
+                [&](error_code ec)
+                {
+                    BEAST_EXPECTS(! ec, ec.message());
+                    ws.async_write(boost::asio::buffer("done", 4),
+                        [&](error_code ec)
+                        {
+                            BEAST_EXPECTS(! ec, ec.message());
+                        });
+                });
+        }
+        ios.run();
+        t.join();
+        if(answer)
+        {
+            BEAST_EXPECTS(result == error::closed, result.message());
+            BEAST_EXPECT(pings >= 2);
+        }
+        else
+        {
+            BEAST_EXPECT(result);
+            BEAST_EXPECT(result != error::closed);
+            BEAST_EXPECT(elapsed < std::chrono::milliseconds(400));
+        }
+    }
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    // The stream may be destroyed while the keepalive ping is
+    // still being written to a peer that stopped reading. A
+    // local socket pair is used because its send buffer stays
+    // full, where loopback TCP keeps making room.
+    void
+    testIdleDestroy()
+    {
+        using local_socket_type =
+            boost::asio::local::stream_protocol::socket;
+        boost::asio::io_service ios;
+        boost::asio::io_service ios2;
+        std::unique_ptr<stream<local_socket_type>> ws(
+            new stream<local_socket_type>(ios));
+        stream<local_socket_type> peer(ios2);
+        boost::asio::local::connect_pair(
+            ws->next_layer(), peer.next_layer());
+        std::thread t(
+            [&]
+            {
+                peer.handshake("localhost", "/");
+            });
+        ws->set_option(idle_timeout{std::chrono::milliseconds(100)});
+        ws->accept();
+        t.join();
+        // The peer never reads. Fill the send buffer,
+        // so that the keepalive ping stays pending.
+        ws->next_layer().non_blocking(true);
+        std::vector<char> v(65536);
+        for(auto const n : {v.size(), std::size_t{1}})
+        {
+            error_code ec;
+            while(! ec)
+                ws->next_layer().write_some(
+                    boost::asio::buffer(v.data(), n), ec);
+        }
+        ws->next_layer().non_blocking(false);
+        bool destroyed = false;
+        opcode op;
+        streambuf sb;
+        ws->async_read(op, sb,
+            [&](error_code ec)
+            {
+                BEAST_EXPECT(ec);
+                // The aborted ping write is still queued
+                ws.reset();
+                destroyed = true;
+            });
+        ios.run();
+        BEAST_EXPECT(destroyed);
+    }
+
+    // The stream may be destroyed after the keepalive ping
+    // was written, while the handler of the write is queued.
+    void
+    testIdlePingDestroy()
+    {
+        using local_socket_type =
+            boost::asio::local::stream_protocol::socket;
+        boost::asio::io_service ios;
+        boost::asio::io_service ios2;
+        std::unique_ptr<stream<local_socket_type>> ws(
+            new stream<local_socket_type>(ios));
+        stream<local_socket_type> peer(ios2);
+        boost::asio::local::connect_pair(
+            ws->next_layer(), peer.next_layer());
+        std::thread t(
+            [&]
+            {
+                peer.handshake("localhost", "/");
+            });
+        ws->set_option(idle_timeout{std::chrono::milliseconds(100)});
+        ws->accept();
+        t.join();
+        // The timer expires and the ping is written at once,
+        // which queues the handler of the write.
+        BEAST_EXPECT(ios.run_one() == 1);
+        ws.reset();
+        ios.run();
+    }
+#endif
+
     struct SyncClient
     {
         template<class NextLayer>
@@ -1247,7 +2164,10 @@ public:
             address_type::from_string("127.0.0.1"), 0};
 
         testOptions();
+        testCompressible();
+        testNegotiate();
         testAccept();
+        testAcceptBuffered();
         testBadHandshakes();
         testBadResponses();
 
@@ -1263,6 +2183,42 @@ public:
             testInvokable4(ep);
             //testInvokable5(ep);
             testAsyncWriteFrame(ep);
+            testQueue(ep);
+            testSubmit(ep);
+            testControlLatency(ep);
+            testReadBatch(ep);
+            testWriteInplace(ep);
+        }
+
+        testIdleTimeout(true);
+        testIdleTimeout(false);
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        testIdleDestroy();
+        testIdlePingDestroy();
+#endif
+        testInflateLimit();
+        testWindowBits();
+        testOffload();
+
+        {
+            permessage_deflate off;
+            permessage_deflate on;
+            on.client_enable = true;
+            on.server_enable = true;
+            auto narrow = on;
+            narrow.client_max_window_bits = 10;
+            narrow.server_max_window_bits = 10;
+            for(auto const sync : {false, true})
+            {
+                testRelay(off, off, sync);
+                // Compressed frames sent as they are
+                testRelay(on, on, sync);
+                // Compressed frames inflated
+                testRelay(on, off, sync);
+                testRelay(off, on, sync);
+                // Sent as they are one way only
+                testRelay(on, narrow, sync);
+            }
         }
 
         {
@@ -1326,6 +2282,24 @@ public:
         pmd.client_max_window_bits = 10;
         pmd.client_no_context_takeover = true;
         doClientTests(pmd);
+
+        pmd.client_enable = true;
+        pmd.server_enable = true;
+        pmd.client_max_window_bits = 10;
+        pmd.client_no_context_takeover = false;
+        pmd.msg_size_threshold = 16;
+        pmd.sample_entropy = true;
+        doClientTests(pmd);
+
+        // Windows smaller than the default on both sides
+        pmd.client_enable = true;
+        pmd.server_enable = true;
+        pmd.server_max_window_bits = 9;
+        pmd.client_max_window_bits = 9;
+        pmd.client_no_context_takeover = false;
+        pmd.msg_size_threshold = 0;
+        pmd.sample_entropy = false;
+        doClientTests(pmd);
     }
 };
 
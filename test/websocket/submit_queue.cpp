@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/detail/submit_queue.hpp>
+
+#include <beast/unit_test/suite.hpp>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+class submit_queue_test : public beast::unit_test::suite
+{
+public:
+    using node = submit_queue::node;
+
+    static
+    node*
+    make(std::uint32_t v)
+    {
+        auto const n = submit_queue::make(sizeof(v));
+        std::memcpy(n->data(), &v, sizeof(v));
+        return n;
+    }
+
+    static
+    std::uint32_t
+    value(node* n)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, n->data(), sizeof(v));
+        return v;
+    }
+
+    void
+    testQueue()
+    {
+        submit_queue q;
+        BEAST_EXPECT(q.pop_all() == nullptr);
+        // Only the first push finds the queue empty
+        BEAST_EXPECT(q.push(make(1)));
+        BEAST_EXPECT(! q.push(make(2)));
+        BEAST_EXPECT(! q.push(make(3)));
+        auto n = q.pop_all();
+        // Messages come out in the order they were pushed
+        std::uint32_t i = 1;
+        for(auto p = n; p; p = p->next)
+            BEAST_EXPECT(value(p) == i++);
+        BEAST_EXPECT(i == 4);
+        submit_queue::destroy_all(n);
+        BEAST_EXPECT(q.push(make(4)));
+        // Left over messages are freed by the destructor
+    }
+
+    void
+    testThreads()
+    {
+        std::uint32_t const threads = 4;
+        std::uint32_t const count = 10000;
+        submit_queue q;
+        std::vector<std::thread> v;
+        for(std::uint32_t t = 0; t < threads; ++t)
+            v.emplace_back(
+                [&, t]
+                {
+                    for(std::uint32_t i = 0; i < count; ++i)
+                        q.push(make(t * count + i));
+                });
+        // Consume while the producers run
+        std::vector<std::uint32_t> next(threads, 0);
+        std::uint32_t total = 0;
+        while(total < threads * count)
+        {
+            auto n = q.pop_all();
+            for(auto p = n; p; p = p->next)
+            {
+                auto const t = value(p) / count;
+                if(! BEAST_EXPECT(t < threads))
+                    break;
+                BEAST_EXPECT(value(p) % count == next[t]);
+                ++next[t];
+                ++total;
+            }
+            submit_queue::destroy_all(n);
+        }
+        for(auto& t : v)
+            t.join();
+        BEAST_EXPECT(q.pop_all() == nullptr);
+    }
+
+    void run() override
+    {
+        testQueue();
+        testThreads();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(submit_queue,websocket,beast);
+
+} // detail
+} // websocket
+} // beast
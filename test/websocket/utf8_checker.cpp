@@ -12,6 +12,8 @@
 #include <beast/core/streambuf.hpp>
 #include <beast/unit_test/suite.hpp>
 #include <array>
+#include <random>
+#include <vector>
 
 namespace beast {
 namespace websocket {
@@ -393,6 +395,154 @@ public:
         }
     }
 
+    void
+    testOverlong()
+    {
+        // Overlong two byte forms, long enough for the word loop
+        std::string const ascii(32, 'a');
+        for(auto const c : {"\xc0\x80", "\xc1\xbf"})
+        {
+            BEAST_EXPECT(! check_utf8(
+                (c + ascii).data(), ascii.size() + 2));
+            BEAST_EXPECT(! check_utf8(
+                (ascii + c).data(), ascii.size() + 2));
+        }
+    }
+
+    // Returns mostly valid text with occasional damage
+    template<class Generator>
+    static
+    std::vector<std::uint8_t>
+    make_text(Generator& g)
+    {
+        std::vector<std::uint8_t> v;
+        auto const put =
+            [&](std::uint32_t cp)
+            {
+                if(cp < 0x80)
+                {
+                    v.push_back(static_cast<std::uint8_t>(cp));
+                }
+                else if(cp < 0x800)
+                {
+                    v.push_back(static_cast<std::uint8_t>(0xc0 | (cp >> 6)));
+                    v.push_back(static_cast<std::uint8_t>(0x80 | (cp & 0x3f)));
+                }
+                else if(cp < 0x10000)
+                {
+                    v.push_back(static_cast<std::uint8_t>(0xe0 | (cp >> 12)));
+                    v.push_back(static_cast<std::uint8_t>(0x80 | ((cp >> 6) & 0x3f)));
+                    v.push_back(static_cast<std::uint8_t>(0x80 | (cp & 0x3f)));
+                }
+                else
+                {
+                    v.push_back(static_cast<std::uint8_t>(0xf0 | (cp >> 18)));
+                    v.push_back(static_cast<std::uint8_t>(0x80 | ((cp >> 12) & 0x3f)));
+                    v.push_back(static_cast<std::uint8_t>(0x80 | ((cp >> 6) & 0x3f)));
+                    v.push_back(static_cast<std::uint8_t>(0x80 | (cp & 0x3f)));
+                }
+            };
+        auto const size = g() % 400;
+        auto const ascii = g() % 4;
+        while(v.size() < size)
+        {
+            switch(ascii == 0 ? g() % 4 : g() % 16)
+            {
+            case 1: put(0x80 + g() % (0x800 - 0x80)); break;
+            case 2: put(0x800 + g() % (0x10000 - 0x800)); break;
+            case 3: put(0x10000 + g() % (0x110000 - 0x10000)); break;
+            default:
+                put(g() % 0x80);
+                break;
+            }
+        }
+        // Damage: surrogates and out of range values
+        // are produced by replacing arbitrary bytes.
+        switch(v.empty() ? 0 : g() % 4)
+        {
+        case 1:
+            v[g() % v.size()] = static_cast<std::uint8_t>(g());
+            break;
+        case 2:
+            v.resize(g() % v.size());
+            break;
+        default:
+            break;
+        }
+        return v;
+    }
+
+    static
+    bool
+    check_scalar(std::vector<std::uint8_t> const& v)
+    {
+        utf8_checker c;
+        return c.write_scalar(v.data(), v.size()) && c.finish();
+    }
+
+    void
+    testFuzz()
+    {
+        std::mt19937 g;
+        for(int i = 0; i < 50000; ++i)
+        {
+            auto const v = make_text(g);
+            auto const expected = check_scalar(v);
+            {
+                utf8_checker c;
+                if(! BEAST_EXPECT((c.write(
+                        v.data(), v.size()) && c.finish()) ==
+                            expected))
+                    return;
+            }
+            {
+                // Split at random points, each write
+                // must agree with the scalar checker.
+                utf8_checker c0;
+                utf8_checker c1;
+                std::size_t pos = 0;
+                bool r0 = true;
+                while(r0 && pos < v.size())
+                {
+                    auto const n = (std::min<std::size_t>)(
+                        v.size() - pos, g() % 150);
+                    r0 = c0.write_scalar(&v[pos], n);
+                    auto const r1 = c1.write(&v[pos], n);
+                    if(! BEAST_EXPECT(r0 == r1))
+                        return;
+                    pos += n;
+                }
+                if(r0)
+                    BEAST_EXPECT(c0.finish() == c1.finish());
+            }
+#if BEAST_SIMD_X86
+            auto const& cpu = beast::detail::get_cpu_info();
+            if(cpu.ssse3)
+                BEAST_EXPECT(check_kernel(
+                    &utf8_check_ssse3<>, v) == expected);
+            if(cpu.avx2)
+                BEAST_EXPECT(check_kernel(
+                    &utf8_check_avx2<>, v) == expected);
+#endif
+        }
+    }
+
+#if BEAST_SIMD_X86
+    static
+    bool
+    check_kernel(utf8_check_function f,
+        std::vector<std::uint8_t> const& v)
+    {
+        auto const m = v.size() & ~std::size_t{31};
+        if(! f(v.data(), m))
+            return false;
+        auto const n = utf8_simd_extent(v.data(), m);
+        utf8_checker c;
+        return c.write_scalar(
+            v.data() + n, v.size() - n) && c.finish();
+    }
+#endif
+
     void run() override
     {
         testOneByteSequence();
@@ -400,6 +550,8 @@ public:
         testThreeByteSequence();
         testFourByteSequence();
         testWithStreamBuffer();
+        testOverlong();
+        testFuzz();
     }
 };
 
@@ -276,6 +276,10 @@ private:
         {
             auto& d = *d_;
             d.server.opts_.set_options(d.ws);
+            // Send fragments without waiting for acknowledgements
+            error_code ec;
+            d.ws.next_layer().set_option(
+                boost::asio::ip::tcp::no_delay{true}, ec);
             run();
         }
 
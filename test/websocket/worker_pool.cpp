@@ -0,0 +1,86 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/detail/worker_pool.hpp>
+
+#include <beast/unit_test/suite.hpp>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+class worker_pool_test : public beast::unit_test::suite
+{
+public:
+    void
+    testPool()
+    {
+        std::atomic<int> n{0};
+        {
+            std::promise<void> done;
+            worker_pool pool{2};
+            BEAST_EXPECT(pool.size() == 2);
+            for(int i = 0; i < 100; ++i)
+                pool.post(
+                    [&]
+                    {
+                        if(++n == 100)
+                            done.set_value();
+                    });
+            done.get_future().wait();
+        }
+        BEAST_EXPECT(n == 100);
+
+        // Jobs still queued when the pool is
+        // destroyed are not run
+        bool ran = false;
+        {
+            worker_pool pool{1};
+            pool.post(
+                []
+                {
+                    std::this_thread::sleep_for(
+                        std::chrono::milliseconds(100));
+                });
+            pool.post([&]{ ran = true; });
+        }
+        BEAST_EXPECT(! ran);
+    }
+
+    void
+    testThreads()
+    {
+        // Jobs run away from the posting thread
+        auto const self = std::this_thread::get_id();
+        std::promise<std::thread::id> id;
+        {
+            worker_pool pool{1};
+            pool.post([&]{ id.set_value(std::this_thread::get_id()); });
+            BEAST_EXPECT(id.get_future().get() != self);
+        }
+
+        // The shared pool has at least one thread
+        BEAST_EXPECT(worker_pool::instance().size() >= 1);
+    }
+
+    void run() override
+    {
+        testPool();
+        testThreads();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(worker_pool,websocket,beast);
+
+} // detail
+} // websocket
+} // beast
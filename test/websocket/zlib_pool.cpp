@@ -0,0 +1,77 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/detail/zlib_pool.hpp>
+
+#include <beast/zlib/inflate_stream.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <thread>
+#include <vector>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+class zlib_pool_test : public beast::unit_test::suite
+{
+public:
+    using pool_type = zlib_pool<zlib::inflate_stream>;
+
+    void
+    testPool()
+    {
+        auto& pool = pool_type::instance();
+        // Other tests may have filled this thread's pool
+        while(pool.size())
+            pool.get();
+        auto p = pool.get();
+        BEAST_EXPECT(p != nullptr);
+        auto const raw = p.get();
+        pool.put(std::move(p));
+        BEAST_EXPECT(pool.size() == 1);
+        // The most recently returned stream is reused
+        p = pool.get();
+        BEAST_EXPECT(p.get() == raw);
+        pool.put(std::move(p));
+
+        // Idle streams are bounded
+        std::vector<std::unique_ptr<zlib::inflate_stream>> v;
+        for(std::size_t i = 0; i < 2 * pool_type::max_idle; ++i)
+            v.emplace_back(pool.get());
+        for(auto& e : v)
+            pool.put(std::move(e));
+        BEAST_EXPECT(pool.size() == pool_type::max_idle);
+    }
+
+    void
+    testThreads()
+    {
+        // Each thread has its own pool
+        auto const self = &pool_type::instance();
+        pool_type* other = nullptr;
+        std::thread t(
+            [&]
+            {
+                other = &pool_type::instance();
+            });
+        t.join();
+        BEAST_EXPECT(other != self);
+    }
+
+    void run() override
+    {
+        testPool();
+        testThreads();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(zlib_pool,websocket,beast);
+
+} // detail
+} // websocket
+} // beast